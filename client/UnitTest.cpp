@@ -1,5 +1,32 @@
 #include <UnitTest++/UnitTest++.h>
 #include "interface.h"
+#include "socket_writer.h"
+#include "socket_reader.h"
+#include "parser.h"
+#include "binary_input.h"
+#include "spsc_ring.h"
+#include "buffer_pool.h"
+#include "window.h"
+#include "shard.h"
+#include "result_sink.h"
+#include "result_file.h"
+#include "checkpoint.h"
+#include "result_cache.h"
+#include "client.h"
+#include "local_server.h"
+#include "daemon.h"
+#include "metrics.h"
+#include "trace.h"
+#include "local_sum.h"
+#include "sample_verifier.h"
+#include "workload.h"
+#include <thread>
+#include <random>
+#include <fstream>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 /**
  * @brief Тесты для проверки вывода справки
@@ -73,6 +100,63 @@ SUITE(ParamTest){
         int argc = sizeof(argv) / sizeof(argv[0]) - 1;
         CHECK(iface.Parser(argc, argv));
     }
+
+    /**
+     * @brief Тест размера окна конвейера по умолчанию
+     * @details Проверяет, что без параметра -w используется режим "запрос-ответ"
+     */
+    TEST(DefaultWindow){
+        UserInterface iface;
+        const char* argv[] = {"test", 
+                             "-i", "input.txt",
+                             "-r", "result.txt",  
+                             "-d", "data.txt",
+                             "-t", "8080",
+                             "-a", "127.0.0.1",
+                             nullptr};
+        int argc = sizeof(argv) / sizeof(argv[0]) - 1;
+        CHECK(iface.Parser(argc, argv));
+        CHECK_EQUAL(1u, iface.getParams().Window);
+    }
+
+    /**
+     * @brief Тест разбора размера окна конвейера
+     * @details Проверяет корректный разбор параметра -w (векторов в полёте)
+     */
+    TEST(WindowParam){
+        UserInterface iface;
+        const char* argv[] = {"test", 
+                             "-i", "input.txt",
+                             "-r", "result.txt",  
+                             "-d", "data.txt",
+                             "-t", "8080",
+                             "-a", "127.0.0.1",
+                             "-w", "64",
+                             nullptr};
+        int argc = sizeof(argv) / sizeof(argv[0]) - 1;
+        CHECK(iface.Parser(argc, argv));
+        CHECK_EQUAL(64u, iface.getParams().Window);
+    }
+
+    /**
+     * @brief Тест параметров режима службы
+     * @details В режиме службы входной файл и файл результатов задаются
+     * в заданиях, поэтому -i и -r не обязательны
+     */
+    TEST(DaemonWithoutFiles){
+        UserInterface iface;
+        const char* argv[] = {"test",
+                             "-d", "data.txt",
+                             "-t", "8080",
+                             "-a", "127.0.0.1",
+                             "-D",
+                             "-u", "/tmp/jobs.sock",
+                             nullptr};
+        int argc = sizeof(argv) / sizeof(argv[0]) - 1;
+        CHECK(iface.Parser(argc, argv));
+        CHECK(iface.getParams().Daemon);
+        CHECK_EQUAL(string("/tmp/jobs.sock"), iface.getParams().JobSocket);
+    }
 }
 
 /**
@@ -107,6 +191,22 @@ SUITE(ErrorTest){
         CHECK_THROW(iface.Parser(argc, argv), std::exception);
     }
 
+    /**
+     * @brief Тест отсутствия файла результатов
+     * @details Проверяет обработку ситуации, когда не указан файл результатов (-r)
+     */
+    TEST(MissingResultFile){
+        UserInterface iface;
+        const char* argv[] = {"test",
+                             "-i", "input.txt",
+                             "-d", "data.txt",
+                             "-t", "8080",
+                             "-a", "127.0.0.1",
+                             nullptr};
+        int argc = sizeof(argv) / sizeof(argv[0]) - 1;
+        CHECK_THROW(iface.Parser(argc, argv), std::exception);
+    }
+
     /**
      * @brief Тест отсутствия порта
      * @details Проверяет обработку ситуации, когда не указан порт (-t)
@@ -339,6 +439,1988 @@ SUITE(BoundaryTest){
     }
 }
 
+/**
+ * @brief Тесты буферизованной записи в сокет
+ * @details Данные пишутся в один конец пары сокетов и читаются из другого
+ */
+SUITE(SocketWriterTest){
+    /**
+     * @brief Тест накопления кадров в буфере
+     * @details Проверяет, что до вызова flush данные не отправляются,
+     * а после него приходят в формате протокола: размер и элементы
+     */
+    TEST(FramesAreBufferedUntilFlush){
+        int sv[2];
+        CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+        SocketWriter writer(sv[0]);
+        double data[] = {1.5, 2.5};
+        writer.writeFrame(2, data);
+        CHECK_EQUAL(sizeof(uint32_t) + sizeof(data), writer.pending());
+        writer.flush();
+        CHECK_EQUAL(0u, writer.pending());
+        char buf[64];
+        ssize_t n = recv(sv[1], buf, sizeof(buf), 0);
+        CHECK_EQUAL((ssize_t)(sizeof(uint32_t) + sizeof(data)), n);
+        uint32_t size;
+        memcpy(&size, buf, sizeof(size));
+        CHECK_EQUAL(2u, size);
+        CHECK(memcmp(buf + sizeof(size), data, sizeof(data)) == 0);
+        close(sv[0]);
+        close(sv[1]);
+    }
+
+    /**
+     * @brief Тест кадра, превышающего размер буфера
+     * @details Проверяет, что вектор больше буфера отправляется сразу и целиком
+     */
+    TEST(LargeFrameBypassesBuffer){
+        int sv[2];
+        CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+        SocketWriter writer(sv[0], 16);
+        double data[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+        writer.writeFrame(8, data);
+        CHECK_EQUAL(0u, writer.pending());
+        char buf[128];
+        ssize_t n = recv(sv[1], buf, sizeof(buf), MSG_WAITALL | MSG_DONTWAIT);
+        CHECK_EQUAL((ssize_t)(sizeof(uint32_t) + sizeof(data)), n);
+        CHECK(memcmp(buf + sizeof(uint32_t), data, sizeof(data)) == 0);
+        close(sv[0]);
+        close(sv[1]);
+    }
+}
+
+/**
+ * @brief Тесты буферизованного чтения из сокета
+ * @details Данные пишутся в один конец пары сокетов и читаются из другого
+ */
+SUITE(SocketReaderTest){
+    /**
+     * @brief Тест разделения склеенных сообщений рукопожатия
+     * @details Проверяет, что соль и подтверждение, пришедшие одним
+     * сегментом, читаются как два отдельных сообщения
+     */
+    TEST(CoalescedTokensAreSplit){
+        int sv[2];
+        CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+        const char data[] = "0123456789ABCDEFOK";
+        CHECK(send(sv[1], data, strlen(data), 0) == (ssize_t)strlen(data));
+        SocketReader reader(sv[0]);
+        CHECK_EQUAL(string("0123456789ABCDEF"), reader.readToken(16));
+        CHECK_EQUAL(string("OK"), reader.readToken(2));
+        close(sv[0]);
+        close(sv[1]);
+    }
+
+    /**
+     * @brief Тест чтения результатов, разрезанных на части
+     * @details Проверяет сборку результата из нескольких сегментов и
+     * разбор нескольких результатов из одной порции данных
+     */
+    TEST(PartialResultsAreReassembled){
+        int sv[2];
+        CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+        double sent[] = {227.2, 66.8, 52};
+        const char* bytes = reinterpret_cast<const char*>(sent);
+        CHECK(send(sv[1], bytes, 3, 0) == 3);
+        SocketReader reader(sv[0]);
+        double results[3];
+        CHECK(send(sv[1], bytes + 3, sizeof(sent) - 3, 0) == (ssize_t)(sizeof(sent) - 3));
+        size_t count = 0;
+        while (count < 3)
+            count += reader.readResults(results + count, 3 - count);
+        CHECK_EQUAL(227.2, results[0]);
+        CHECK_EQUAL(66.8, results[1]);
+        CHECK_EQUAL(52.0, results[2]);
+        CHECK_EQUAL(0u, reader.buffered());
+        close(sv[0]);
+        close(sv[1]);
+    }
+
+    /**
+     * @brief Тест закрытия соединения сервером
+     * @details Проверяет, что преждевременный конец потока вызывает исключение
+     */
+    TEST(ClosedConnectionThrows){
+        int sv[2];
+        CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+        close(sv[1]);
+        SocketReader reader(sv[0]);
+        double result;
+        CHECK_THROW(reader.readResults(&result, 1), std::system_error);
+        close(sv[0]);
+    }
+}
+
+/**
+ * @brief Запись текста во временный файл
+ * @param[in] text Содержимое файла
+ * @return Путь к созданному файлу
+ */
+static string writeTempFile(const string& text){
+    char path[] = "/tmp/steroid_testXXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd != -1);
+    CHECK(write(fd, text.data(), text.size()) == (ssize_t)text.size());
+    close(fd);
+    return path;
+}
+
+/**
+ * @brief Чтение файла целиком
+ * @param[in] path Путь к файлу
+ * @return Содержимое файла
+ */
+static string readFile(const string& path){
+    ifstream file(path, ios::binary);
+    return string(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+/**
+ * @brief Тесты разбора файла с векторами
+ * @details Проверяет, что VectorParser выдаёт те же векторы, что и чтение через ifstream
+ */
+SUITE(ParserTest){
+    /**
+     * @brief Тест разбора файла из репозитория
+     * @details Сравнивает результат разбора input.bin с чтением через ifstream
+     */
+    TEST(MatchesStreamParsing){
+        ifstream file("input.bin");
+        VectorParser parser("input.bin");
+        uint32_t num_vect;
+        file >> num_vect;
+        CHECK_EQUAL(num_vect, parser.readCount());
+        for (uint32_t i = 0; i < num_vect; i++){
+            uint32_t size_vect;
+            file >> size_vect;
+            CHECK_EQUAL(size_vect, parser.readSize());
+            vector<double> parsed(size_vect);
+            parser.readElements(parsed.data(), size_vect);
+            for (uint32_t j = 0; j < size_vect; j++){
+                double v;
+                file >> v;
+                CHECK_EQUAL(v, parsed[j]);
+            }
+        }
+    }
+
+    /**
+     * @brief Тест разбора мелкими частями в несколько потоков
+     * @details Части по одному байту проверяют, что границы не разрезают числа
+     */
+    TEST(ChunkBoundaries){
+        string path = writeTempFile("2\n3\n12.5 -77.25 +1e3\n1\n\t0.125\r\n");
+        VectorParser parser(path, 3, 1);
+        CHECK_EQUAL(2u, parser.readCount());
+        CHECK_EQUAL(3u, parser.readSize());
+        double v[3];
+        parser.readElements(v, 3);
+        CHECK_EQUAL(12.5, v[0]);
+        CHECK_EQUAL(-77.25, v[1]);
+        CHECK_EQUAL(1000.0, v[2]);
+        CHECK_EQUAL(1u, parser.readSize());
+        parser.readElements(v, 1);
+        CHECK_EQUAL(0.125, v[0]);
+        unlink(path.c_str());
+    }
+
+    /**
+     * @brief Тест некорректного файла
+     * @details Проверяет исключения для нечислового размера, обрыва файла,
+     * размеров, записанных не как целое (5.0, 1e1), и записей чисел,
+     * которые отвергает operator>> (+-5, inf, nan)
+     */
+    TEST(MalformedInputThrows){
+        string path = writeTempFile("2\n1.5\n");
+        VectorParser parser(path);
+        CHECK_EQUAL(2u, parser.readCount());
+        CHECK_THROW(parser.readSize(), std::system_error);
+        unlink(path.c_str());
+
+        path = writeTempFile("1\n3\n1 2\n");
+        VectorParser truncated(path);
+        truncated.readCount();
+        CHECK_EQUAL(3u, truncated.readSize());
+        double v[3];
+        CHECK_THROW(truncated.readElements(v, 3), std::system_error);
+        unlink(path.c_str());
+
+        // Размер, записанный не как целое, отвергается, как operator>> в uint32_t
+        for (const char* bad : {"5.0", "5e0", "1e1", "-0"}){
+            path = writeTempFile(string("1\n") + bad + " 1 2 3 4 5 6 7 8 9 10\n");
+            VectorParser invalid(path);
+            CHECK_EQUAL(1u, invalid.readCount());
+            CHECK_THROW(invalid.readSize(), std::system_error);
+            unlink(path.c_str());
+        }
+        // Индексы отмеченных чисел сдвигаются при объединении частей
+        path = writeTempFile("2\n1 7\n5e0 1 2 3 4 5\n");
+        VectorParser split(path, 3, 1);
+        CHECK_EQUAL(2u, split.readCount());
+        CHECK_EQUAL(1u, split.readSize());
+        split.readElements(v, 1);
+        CHECK_THROW(split.readSize(), std::system_error);
+        unlink(path.c_str());
+        path = writeTempFile("1e0\n1 5.0\n");
+        VectorParser badCount(path);
+        CHECK_THROW(badCount.readCount(), std::system_error);
+        unlink(path.c_str());
+        path = writeTempFile("+1\n1 5.0\n");
+        VectorParser plus(path);
+        CHECK_EQUAL(1u, plus.readCount());
+        CHECK_EQUAL(1u, plus.readSize());
+        unlink(path.c_str());
+
+        // Записи, которые не принимает operator>>, не принимает и разборщик
+        for (const char* bad : {"+-5", "+-inf", "inf", "-inf", "nan", "+nan"}){
+            path = writeTempFile(string("1\n2\n1 ") + bad + "\n");
+            VectorParser invalid(path);
+            CHECK_THROW((invalid.readCount(), invalid.readSize(), invalid.readElements(v, 2)), std::system_error);
+            unlink(path.c_str());
+        }
+    }
+
+    /**
+     * @brief Тест отсутствующего файла
+     */
+    TEST(MissingFileThrows){
+        CHECK_THROW(VectorParser("/nonexistent/input.txt"), std::system_error);
+    }
+}
+
+/**
+ * @brief Тесты двоичного входного формата
+ * @details Проверяет преобразование текстового файла и разбиение на кадры протокола
+ */
+SUITE(BinaryInputTest){
+    /**
+     * @brief Тест кадров преобразованного файла
+     * @details Кадры input.bin должны идти подряд сразу после заголовка
+     * и содержать размер и элементы вектора в формате протокола
+     */
+    TEST(ConvertedFileHasWireFrames){
+        string path = writeTempFile("");
+        convertToBinary("input.bin", path);
+        BinaryInput input(path);
+        CHECK_EQUAL(4u, input.count());
+        uint32_t sizes[] = {5, 3, 2, 5};
+        size_t expected = sizeof(uint32_t);
+        size_t offset, len;
+        for (uint32_t size : sizes){
+            CHECK(input.nextFrame(offset, len));
+            CHECK_EQUAL(expected, offset);
+            CHECK_EQUAL(sizeof(uint32_t) + size * sizeof(double), len);
+            expected += len;
+        }
+        CHECK(!input.nextFrame(offset, len));
+
+        ifstream file(path, ios::binary);
+        file.seekg(sizeof(uint32_t) * 2);
+        double first;
+        file.read(reinterpret_cast<char*>(&first), sizeof(first));
+        CHECK_EQUAL(12.5, first);
+        unlink(path.c_str());
+    }
+
+    /**
+     * @brief Тест усечённого двоичного файла
+     * @details Кадр, выходящий за конец файла, должен вызывать исключение
+     */
+    TEST(TruncatedFrameThrows){
+        string data(sizeof(uint32_t) * 2, '\0');
+        data[0] = 1;
+        data[sizeof(uint32_t)] = 3;
+        string path = writeTempFile(data);
+        BinaryInput input(path);
+        size_t offset, len;
+        CHECK_THROW(input.nextFrame(offset, len), std::system_error);
+        unlink(path.c_str());
+    }
+}
+
+/**
+ * @brief Тесты очереди между потоками разбора и отправки
+ */
+SUITE(SpscRingTest){
+    /**
+     * @brief Тест передачи элементов между потоками
+     * @details Производитель передаёт больше элементов, чем вмещает очередь;
+     * потребитель должен получить их все и в том же порядке
+     */
+    TEST(PreservesOrderUnderBackpressure){
+        SpscRing<vector<double>> ring(4);
+        thread producer([&]{
+            for (int i = 0; i < 1000; i++){
+                vector<double> v(i % 7, i);
+                ring.push(v);
+            }
+            ring.close();
+        });
+        vector<double> v;
+        int expected = 0;
+        while (ring.pop(v)){
+            CHECK_EQUAL((size_t)(expected % 7), v.size());
+            if (!v.empty())
+                CHECK_EQUAL((double)expected, v[0]);
+            expected++;
+        }
+        producer.join();
+        CHECK_EQUAL(1000, expected);
+    }
+
+    /**
+     * @brief Тест закрытия очереди потребителем
+     * @details Производитель, ожидающий свободную ячейку, должен быть разбужен
+     */
+    TEST(CloseWakesBlockedProducer){
+        SpscRing<int> ring(1);
+        int first = 1;
+        CHECK(ring.push(first));
+        bool pushed = true;
+        thread producer([&]{
+            int second = 2;
+            pushed = ring.push(second);
+        });
+        ring.close();
+        producer.join();
+        CHECK(!pushed);
+    }
+}
+
+/**
+ * @brief Тесты пула буферов векторов
+ */
+SUITE(BufferPoolTest){
+    /**
+     * @brief Тест повторного использования буфера
+     * @details Возвращённый буфер выдаётся снова без перевыделения памяти,
+     * память выровнена по строке кэша
+     */
+    TEST(BuffersAreReusedAndAligned){
+        BufferPool pool(1, 16);
+        VectorBuffer* buffer = pool.acquire();
+        CHECK(buffer != nullptr);
+        CHECK_EQUAL(0u, reinterpret_cast<uintptr_t>(buffer->data()) % BUFFER_ALIGNMENT);
+        buffer->reserve(1000);
+        double* data = buffer->data();
+        pool.release(buffer);
+        VectorBuffer* again = pool.acquire();
+        CHECK(again == buffer);
+        again->reserve(500);
+        CHECK(again->data() == data);
+        pool.release(again);
+    }
+
+    /**
+     * @brief Тест закрытия пула
+     * @details Поток, ожидающий свободный буфер, получает nullptr
+     */
+    TEST(CloseWakesWaiter){
+        BufferPool pool(1);
+        VectorBuffer* buffer = pool.acquire();
+        VectorBuffer* waited = buffer;
+        thread waiter([&]{ waited = pool.acquire(); });
+        pool.close();
+        waiter.join();
+        CHECK(waited == nullptr);
+    }
+}
+
+/**
+ * @brief Тесты управления окном векторов в полёте
+ */
+SUITE(WindowControllerTest){
+    /**
+     * @struct Link
+     * @brief Модель сессии с сервером
+     * @details Сервер обрабатывает векторы по одному; клиент отправляет
+     * векторы, пока их в полёте меньше размера окна. Время в миллисекундах
+     */
+    struct Link {
+        double now = 0;         ///< Модельное время
+        double serverFree = 0;  ///< Время освобождения сервера
+        deque<double> arrivals; ///< Время прихода результатов векторов в полёте
+
+        /**
+         * @brief Получение заданного количества результатов
+         * @param[in,out] window Управление окном
+         * @param[in] rtt Задержка сети туда и обратно
+         * @param[in] service Время обработки вектора сервером
+         * @param[in] results Количество результатов
+         * @param[in] flushDelay Время от занятия места в окне до сброса кадров в сокет
+         * @return Скорость получения результатов в векторах за миллисекунду
+         */
+        double run(WindowController& window, double rtt, double service, uint32_t results, double flushDelay = 0){
+            auto at = [](double ms){
+                return chrono::steady_clock::time_point(chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double, milli>(ms)));
+            };
+            double start = now;
+            for (uint32_t received = 0; received < results; received++){
+                if (arrivals.size() < window.limit()){
+                    while (arrivals.size() < window.limit()){
+                        window.onSend(at(now));
+                        serverFree = max(now + flushDelay + rtt / 2, serverFree) + service;
+                        arrivals.push_back(serverFree + rtt / 2);
+                    }
+                    window.onFlush(at(now + flushDelay));
+                }
+                now = arrivals.front();
+                arrivals.pop_front();
+                window.onReceive(1, at(now));
+            }
+            return results / (now - start);
+        }
+    };
+
+    /**
+     * @brief Тест постоянного окна
+     * @details Без подстройки размер окна равен заданному при любых замерах
+     */
+    TEST(FixedLimit){
+        WindowController window(8);
+        Link link;
+        link.run(window, 10, 0.5, 1000);
+        CHECK_EQUAL(8u, window.limit());
+    }
+
+    /**
+     * @brief Тест разгона до произведения скорости на задержку
+     * @details Узкое место - 2 вектора за миллисекунду при задержке около
+     * 10 мс: окно начинается с WINDOW_INITIAL, вырастает до нескольких
+     * десятков векторов и не упирается в верхнюю границу
+     */
+    TEST(GrowsToBandwidthDelayProduct){
+        WindowController window(1024, true);
+        CHECK_EQUAL((uint32_t)WINDOW_INITIAL, window.limit());
+        Link link;
+        double rate = link.run(window, 10, 0.5, 20000);
+        CHECK(rate > 1.8);
+        CHECK(window.limit() >= 21u);
+        CHECK(window.limit() <= 84u);
+    }
+
+    /**
+     * @brief Тест реакции на рост задержки
+     * @details После резкого роста задержки окно сначала уменьшается, а
+     * после замера новой наименьшей задержки вырастает до нового
+     * произведения скорости на задержку
+     */
+    TEST(BacksOffWhenLatencyRises){
+        WindowController window(4096, true);
+        Link link;
+        link.run(window, 10, 0.5, 20000);
+        uint32_t before = window.limit();
+        uint32_t lowest = before;
+        for (int i = 0; i < 20; i++){
+            link.run(window, 200, 0.5, 10);
+            lowest = min(lowest, window.limit());
+        }
+        CHECK(lowest < before);
+        double rate = link.run(window, 200, 0.5, 20000);
+        CHECK(rate > 1.8);
+        CHECK(window.limit() >= 400u);
+    }
+
+    /**
+     * @brief Тест отсчёта задержки от сброса кадров
+     * @details Кадры уходят в сокет с запаздыванием после занятия места
+     * в окне (ожидание записи у клиента); задержка сети не растёт, и окно
+     * не уменьшается
+     */
+    TEST(LatencyCountsFromFlush){
+        WindowController window(4096, true);
+        Link link;
+        link.run(window, 10, 0.5, 20000);
+        uint32_t before = window.limit();
+        uint32_t lowest = before;
+        for (int i = 0; i < 20; i++){
+            link.run(window, 10, 0.5, 10, 200);
+            lowest = min(lowest, window.limit());
+        }
+        CHECK_EQUAL(before, lowest);
+    }
+}
+
+/**
+ * @brief Тесты гистограммы времён
+ */
+SUITE(LatencyHistogramTest){
+    /**
+     * @brief Тест границ корзин
+     * @details Малые значения хранятся точно, каждое значение попадает в
+     * корзину, нижняя граница которой не больше значения и отличается от
+     * него не более чем на 1/HISTOGRAM_SUB_COUNT
+     */
+    TEST(BucketBounds){
+        for (uint64_t v = 0; v < HISTOGRAM_SUB_COUNT; v++)
+            CHECK_EQUAL(v, LatencyHistogram::lowest(LatencyHistogram::bucket(v)));
+        for (uint64_t v : {32ull, 33ull, 63ull, 64ull, 1000ull, 123456789ull, 1ull << 40, ~0ull}){
+            size_t index = LatencyHistogram::bucket(v);
+            CHECK(index < HISTOGRAM_BUCKETS);
+            uint64_t low = LatencyHistogram::lowest(index);
+            CHECK(low <= v);
+            CHECK(v - low <= low / HISTOGRAM_SUB_COUNT);
+            if (index + 1 < HISTOGRAM_BUCKETS)
+                CHECK(v < LatencyHistogram::lowest(index + 1));
+        }
+    }
+
+    /**
+     * @brief Тест перцентилей
+     * @details Для значений 1..10000 перцентили совпадают с точными
+     * с погрешностью корзины, наибольшее значение точное
+     */
+    TEST(PercentilesWithinBucketError){
+        auto histogram = make_unique<LatencyHistogram>();
+        CHECK_EQUAL(0u, histogram->percentile(50));
+        for (uint64_t v = 1; v <= 10000; v++)
+            histogram->record(v);
+        CHECK_EQUAL(10000u, histogram->count());
+        CHECK_EQUAL(50005000u, histogram->sum());
+        CHECK_EQUAL(10000u, histogram->max());
+        for (double q : {50.0, 90.0, 99.0, 99.9}){
+            double exact = q * 100;
+            double estimate = histogram->percentile(q);
+            CHECK(estimate >= exact);
+            CHECK(estimate <= exact * (1 + 1.0 / HISTOGRAM_SUB_COUNT));
+        }
+        CHECK_EQUAL(10000u, histogram->percentile(100));
+    }
+}
+
+/**
+ * @brief Тесты трассировки векторов
+ */
+SUITE(TraceTest){
+    /**
+     * @brief Тест переполнения кольца потока
+     * @details После записи больше TRACE_RING_EVENTS событий в кольце
+     * остаются последние TRACE_RING_EVENTS, по порядку записи
+     */
+    TEST(RingKeepsLatestEvents){
+        auto ring = make_unique<TraceRing>(1, "test");
+        uint32_t total = TRACE_RING_EVENTS + 100;
+        for (uint32_t i = 0; i < total; i++)
+            ring->push({i, 1, i, 1, TraceKind::Send});
+        CHECK_EQUAL(uint64_t(total), ring->written());
+        uint64_t begin = ring->written() - TRACE_RING_EVENTS;
+        CHECK_EQUAL(100u, ring->at(begin).index);
+        CHECK_EQUAL(total - 1, ring->at(ring->written() - 1).index);
+        CHECK(ring->at(begin + 5).start == begin + 5);
+    }
+
+    /**
+     * @brief Тест выключенной трассировки
+     * @details Пока трассировка не включена, интервалы ничего не записывают
+     */
+    TEST(SpanWithoutTracerIsNoop){
+        CHECK(Tracer::active() == nullptr);
+        TraceSpan span(TraceKind::Parse, 7);
+        span.range(7, 3);
+    }
+
+    /**
+     * @brief Тест повторного использования колец
+     * @details Потоки запускаются по очереди, как задания службы; колец
+     * выделяется не больше TRACE_RING_LIMIT, и трасса остаётся корректной
+     */
+    TEST(RingsOfFinishedThreadsAreReused){
+        Tracer::enable();
+        for (int i = 0; i < TRACE_RING_LIMIT * 3; i++)
+            thread([i]{
+                Tracer::threadName("job " + to_string(i));
+                TraceSpan span(TraceKind::Send, i);
+            }).join();
+        CHECK(Tracer::active()->ringCount() <= TRACE_RING_LIMIT);
+        string path = writeTempFile("");
+        Tracer::active()->save(path);
+        string trace = readFile(path);
+        CHECK(trace.find("\"job " + to_string(TRACE_RING_LIMIT * 3 - 1) + "\"") != string::npos);
+        CHECK(trace.find("\"job 0\"") == string::npos);
+        Tracer::disable();
+        unlink(path.c_str());
+    }
+}
+
+/**
+ * @brief Тесты локального суммирования
+ */
+SUITE(LocalSumTest){
+    /**
+     * @brief Тест ядер на невыровненных данных
+     * @details Все ядра, доступные процессору, для длин, не кратных ширине
+     * регистров, дают сумму NeumaierSum: компенсированные - с точностью до
+     * последних разрядов, быстрые - в пределах оценки n * eps * sum|x|
+     */
+    TEST(KernelsAgreeWithReference){
+        mt19937_64 random(7);
+        uniform_real_distribution<double> value(-1e3, 1e3);
+        vector<char> bytes(sizeof(uint32_t) + 1000 * sizeof(double));
+        for (size_t n : {0, 1, 3, 7, 8, 15, 17, 31, 33, 64, 100, 1000}){
+            NeumaierSum reference;
+            double magnitude = 0;
+            for (size_t i = 0; i < n; i++){
+                double x = value(random);
+                memcpy(bytes.data() + sizeof(uint32_t) + i * sizeof(double), &x, sizeof(x));
+                reference.add(x);
+                magnitude += fabs(x);
+            }
+            const char* x = bytes.data() + sizeof(uint32_t); ///< Как элементы кадра двоичного файла
+            for (int isa = 0; isa <= int(LocalSum::best()); isa++){
+                double precise = LocalSum::sum(x, n, SumMode::Compensated, SumIsa(isa));
+                double fast = LocalSum::sum(x, n, SumMode::Fast, SumIsa(isa));
+                CHECK_CLOSE(reference.value(), precise, 1e-15 * max(1.0, magnitude));
+                CHECK_CLOSE(reference.value(), fast, n * 1.2e-16 * max(1.0, magnitude));
+            }
+        }
+    }
+
+    /**
+     * @brief Тест компенсированного режима на сокращении
+     * @details Единица между 1e16 и -1e16 теряется при обычном сложении,
+     * компенсированные ядра сохраняют её при любой длине, в том числе
+     * при передаче вектора частями
+     */
+    TEST(CompensatedKeepsLostDigits){
+        vector<double> v;
+        for (int i = 0; i < 100; i++)
+            v.insert(v.end(), {1e16, 1.0, -1e16});
+        for (int isa = 0; isa <= int(LocalSum::best()); isa++)
+            CHECK_EQUAL(100.0, LocalSum::sum(v.data(), v.size(), SumMode::Compensated, SumIsa(isa)));
+        LocalSum parts;
+        parts.add(v.data(), 100);
+        parts.add(v.data() + 100, v.size() - 100);
+        CHECK_EQUAL(100.0, parts.value());
+    }
+}
+
+/**
+ * @brief Тесты выборочной проверки результатов
+ */
+SUITE(SampleVerifierTest){
+    /**
+     * @brief Тест доли выборки
+     * @details Доля векторов выборки близка к заданной, 0 и 1 - ни одного и все
+     */
+    TEST(SampleFraction){
+        SampleVerifier none(0, 1e-9, SumMode::Fast), tenth(0.1, 1e-9, SumMode::Fast), all(1, 1e-9, SumMode::Fast);
+        uint32_t sampled = 0;
+        for (uint32_t i = 0; i < 100000; i++){
+            CHECK(!none.sampled(i));
+            CHECK(all.sampled(i));
+            sampled += tenth.sampled(i);
+        }
+        CHECK(sampled > 9000 && sampled < 11000);
+    }
+
+    /**
+     * @brief Тест сравнения с локальным результатом
+     * @details Верный результат (и результат вектора из частей) проходит,
+     * неверный считается расхождением, повторный и неожиданный не проверяются
+     */
+    TEST(ChecksExpectedResults){
+        SampleVerifier verifier(1, 1e-9, SumMode::Compensated);
+        double v[] = {1.5, 2.5, 3};
+        verifier.expect(1, v, 3);
+        verifier.expect(2, v, 3);
+        verifier.expect(3, v, 1);
+        verifier.expect(3, v + 1, 2, false);
+        verifier.check(1, 7);
+        verifier.check(2, 7.5);
+        verifier.check(2, 7);
+        verifier.check(3, 7 + 1e-12);
+        verifier.check(4, 100);
+        CHECK_EQUAL(3u, verifier.checkedCount());
+        CHECK_EQUAL(1u, verifier.mismatches());
+    }
+}
+
+/**
+ * @brief Тесты генератора синтетических заданий
+ */
+SUITE(WorkloadTest){
+    /**
+     * @brief Тест разбора распределений
+     * @details Размеры не выходят за границы описания, неверные описания отклоняются
+     */
+    TEST(ParsesDistributions){
+        Random random(7);
+        for (const char* spec : {"fixed:5", "uniform:3:9", "zipf:1.2:50", "zipf:1:50", "pareto:1.5:4:1000"}){
+            SizeDistribution d = SizeDistribution::parse(spec);
+            for (int i = 0; i < 10000; i++){
+                uint32_t size = d(random);
+                CHECK(size >= d.min && size <= d.max);
+            }
+        }
+        ValueDistribution ints = ValueDistribution::parse("int:-3:3");
+        for (int i = 0; i < 1000; i++){
+            double v = ints(random);
+            CHECK(v >= -3 && v <= 3 && v == floor(v));
+        }
+        for (const char* spec : {"fixed", "fixed:0", "uniform:9:3", "zipf:-1:10", "pareto:2:1", "gauss:1:2", "uniform:1:x"})
+            CHECK_THROW(SizeDistribution::parse(spec), system_error);
+        CHECK_THROW(ValueDistribution::parse("uniform:5:1"), system_error);
+        CHECK_THROW(ValueDistribution::parse("int:0.5:2"), system_error);
+    }
+
+    /**
+     * @brief Тест независимости от количества потоков
+     * @details Один и четыре потока генерации дают одинаковые файлы
+     * в текстовом и двоичном форматах
+     */
+    TEST(SameFilesForAnyThreadCount){
+        Workload workload(3000, SizeDistribution::parse("pareto:1.2:1:5000"), ValueDistribution::parse("normal:0:100"), 0.3, 42);
+        for (bool binary : {false, true}){
+            string in1 = writeTempFile(""), ex1 = writeTempFile(""), in4 = writeTempFile(""), ex4 = writeTempFile("");
+            uint64_t bytes = workload.generate(in1, ex1, binary, binary, 1);
+            CHECK_EQUAL(bytes, workload.generate(in4, ex4, binary, binary, 4));
+            string data = readFile(in1);
+            CHECK_EQUAL(bytes, data.size());
+            CHECK(data == readFile(in4));
+            CHECK(readFile(ex1) == readFile(ex4));
+            for (const string& path : {in1, ex1, in4, ex4})
+                unlink(path.c_str());
+        }
+    }
+
+    /**
+     * @brief Тест ожидаемых результатов и повторов
+     * @details Локальное вычисление по сгенерированному файлу даёт ровно
+     * ожидаемые результаты (целые элементы суммируются точно), повтор
+     * совпадает с исходным вектором, а доля повторов близка к заданной
+     */
+    TEST(ExpectedResultsAndDuplicates){
+        Workload workload(2000, SizeDistribution::parse("zipf:1.1:300"), ValueDistribution::parse("int:-1000:1000"), 0.5, 3);
+        Params p;
+        p.inFileName = writeTempFile("");
+        p.inFileResult = writeTempFile("");
+        string expected = writeTempFile("");
+        workload.generate(p.inFileName, expected, false, false, 3);
+        p.Offline = true;
+        CHECK_EQUAL(0, Connection::offline(&p));
+        CHECK(readFile(expected) == readFile(p.inFileResult));
+
+        uint32_t repeated = 0;
+        vector<double> a, b;
+        for (uint32_t i = 0; i < workload.count(); i++){
+            uint32_t size;
+            uint32_t src = workload.source(i, size);
+            CHECK(src <= i);
+            if (src != i){
+                repeated++;
+                workload.elements(i, a);
+                workload.elements(src, b);
+                CHECK(a == b);
+                CHECK_EQUAL(size, a.size());
+            }
+        }
+        CHECK(repeated > 900 && repeated < 1100);
+        for (const string& path : {p.inFileName, p.inFileResult, expected})
+            unlink(path.c_str());
+    }
+}
+
+/**
+ * @brief Тесты распределения пакетов по нескольким соединениям
+ */
+SUITE(ShardTest){
+    /**
+     * @brief Тест перехвата пакетов
+     * @details Освободившееся соединение забирает последний пакет чужой
+     * очереди, владелец продолжает брать пакеты из начала своей
+     */
+    TEST(IdleWorkerStealsFromBack){
+        ShardQueues queues(2, 4);
+        Batch* batches[4];
+        for (uint32_t i = 0; i < 4; i++){
+            batches[i] = queues.acquire();
+            batches[i]->first = i;
+            queues.push(batches[i]);
+        }
+        queues.finish();
+        CHECK(queues.pop(1) == batches[1]);
+        CHECK(queues.pop(1) == batches[3]);
+        CHECK(queues.pop(1) == batches[2]);
+        CHECK(queues.pop(0) == batches[0]);
+        CHECK(queues.pop(0) == nullptr);
+    }
+
+    /**
+     * @brief Тест очереди копий пакетов
+     * @details Копия берётся раньше обычных пакетов, но не соединением,
+     * которое задерживает исходный пакет; при удержании соединения не
+     * завершаются после finish
+     */
+    TEST(HedgeGoesToAnotherWorker){
+        ShardQueues queues(2, 2);
+        Batch* normal = queues.acquire();
+        queues.push(normal);
+        Batch* copy = queues.tryAcquire();
+        queues.pushHedge(copy, 0);
+        CHECK(queues.tryAcquire() == nullptr);
+        queues.hold(true);
+        queues.finish();
+        CHECK(!queues.exhausted());
+        CHECK(queues.pop(0) == normal);
+        CHECK(queues.tryPop(0) == nullptr);
+        CHECK(queues.pop(1) == copy);
+        CHECK(!queues.exhausted());
+        queues.hold(false);
+        CHECK(queues.exhausted());
+        CHECK(queues.pop(1) == nullptr);
+    }
+
+    /**
+     * @brief Тест отбрасывания повторных результатов
+     * @details Ответ на копию пакета, пришедший после исходного, не
+     * записывается второй раз
+     */
+    TEST(DuplicateResultsAreDropped){
+        string path = writeTempFile("");
+        ResultSink sink(path);
+        OrderedResults results(&sink);
+        results.put(1, 2);
+        results.put(0, 1);
+        results.put(1, 2);
+        results.put(0, 1);
+        CHECK_EQUAL(2u, results.written());
+        sink.close();
+        CHECK_EQUAL(string("1\n2\n"), readFile(path));
+        unlink(path.c_str());
+    }
+
+    /**
+     * @brief Тест восстановления порядка результатов
+     * @details Результаты, пришедшие не по порядку, записываются в порядке индексов
+     */
+    TEST(ResultsAreWrittenInInputOrder){
+        string path = writeTempFile("");
+        ResultSink sink(path);
+        OrderedResults results(&sink);
+        results.put(2, 52);
+        results.put(0, 227.2);
+        CHECK_EQUAL(1u, results.written());
+        results.put(1, 66.8);
+        CHECK_EQUAL(3u, results.written());
+        sink.close();
+        CHECK_EQUAL(string("227.2\n66.8\n52\n"), readFile(path));
+        unlink(path.c_str());
+    }
+
+    /**
+     * @brief Тест объединения частей разбитого вектора
+     * @details Результат записывается только после получения всех частей,
+     * младшие разряды не теряются при сложении с большими частями
+     */
+    TEST(PartialSumsAreCombined){
+        string path = writeTempFile("");
+        ResultSink sink(path);
+        OrderedResults results(&sink);
+        results.putPart(0, 1e16, 3);
+        results.putPart(0, 1, 3);
+        CHECK_EQUAL(0u, results.written());
+        results.putPart(0, -1e16, 3);
+        CHECK_EQUAL(1u, results.written());
+        sink.close();
+        CHECK_EQUAL(string("1\n"), readFile(path));
+        unlink(path.c_str());
+    }
+}
+
+/**
+ * @brief Тесты записи результатов
+ */
+SUITE(ResultSinkTest){
+    /**
+     * @brief Тест текстового формата
+     * @details Значения записываются кратчайшим представлением, которое
+     * читается обратно в то же значение
+     */
+    TEST(TextIsShortestRoundTrip){
+        string path = writeTempFile("");
+        ResultSink sink(path);
+        double values[] = {0.1, -555.915, 1e300, 0, 3};
+        for (double v : values)
+            sink.put(v);
+        sink.close();
+        CHECK_EQUAL(5u, sink.written());
+        CHECK_EQUAL(string("0.1\n-555.915\n1e+300\n0\n3\n"), readFile(path));
+        unlink(path.c_str());
+    }
+
+    /**
+     * @brief Тест двоичного формата
+     * @details Значения double записываются подряд без разделителей,
+     * в том числе при переполнении буфера
+     */
+    TEST(BinaryIsRawDoubles){
+        string path = writeTempFile("");
+        ResultSink sink(path, true);
+        uint32_t count = RESULT_BUFFER_SIZE / sizeof(double) * 2 + 3;
+        for (uint32_t i = 0; i < count; i++)
+            sink.put(i * 0.5);
+        sink.close();
+        string data = readFile(path);
+        CHECK_EQUAL(count * sizeof(double), data.size());
+        double last;
+        memcpy(&last, data.data() + data.size() - sizeof(last), sizeof(last));
+        CHECK_EQUAL((count - 1) * 0.5, last);
+        unlink(path.c_str());
+    }
+
+    /**
+     * @brief Тест ошибки открытия файла
+     */
+    TEST(UnwritablePathThrows){
+        CHECK_THROW(ResultSink("/nonexistent/result.txt"), std::system_error);
+    }
+
+    /**
+     * @brief Тест продолжения прерванной записи
+     * @details Записанное после сохранённого начала отбрасывается,
+     * новые результаты дописываются за ним
+     */
+    TEST(ResumeKeepsPrefix){
+        string path = writeTempFile("");
+        uint64_t keep;
+        {
+            ResultSink sink(path);
+            sink.put(1.5);
+            sink.put(2);
+            sink.sync();
+            keep = sink.size();
+            sink.put(99);
+            sink.close();
+        }
+        ResultSink sink(path, false, false, 0, keep, 2);
+        sink.put(3);
+        sink.close();
+        CHECK_EQUAL(3u, sink.written());
+        CHECK_EQUAL(string("1.5\n2\n3\n"), readFile(path));
+        CHECK_THROW(ResultSink(path, false, false, 0, 100, 2), std::system_error);
+        unlink(path.c_str());
+    }
+}
+
+/**
+ * @brief Тесты контрольной точки
+ */
+SUITE(CheckpointTest){
+    /**
+     * @brief Тест сохранения и чтения
+     * @details Точка другого задания или формата не читается,
+     * после удаления точки нет
+     */
+    TEST(SaveAndLoad){
+        string path = writeTempFile("");
+        string input = writeTempFile("1\n1 1\n");
+        uint32_t done = 0;
+        uint64_t bytes = 0;
+        Checkpoint checkpoint(path, input, 10, false);
+        CHECK(!checkpoint.load(done, bytes));
+        checkpoint.save(4, 17);
+        CHECK(checkpoint.load(done, bytes));
+        CHECK_EQUAL(4u, done);
+        CHECK_EQUAL(17u, bytes);
+        CHECK(!Checkpoint(path, input, 11, false).load(done, bytes));
+        CHECK(!Checkpoint(path, input, 10, true).load(done, bytes));
+        checkpoint.remove();
+        CHECK(!checkpoint.load(done, bytes));
+        unlink(input.c_str());
+    }
+
+    /**
+     * @brief Тест точки другого входного файла
+     * @details Точка не читается для файла другого размера или с другим
+     * временем изменения, даже при том же количестве векторов
+     */
+    TEST(OtherInputIsRejected){
+        string path = writeTempFile("");
+        string input = writeTempFile("1\n1 1\n");
+        string other = writeTempFile("1\n1 12\n");
+        uint32_t done = 0;
+        uint64_t bytes = 0;
+        Checkpoint(path, input, 1, false).save(1, 2);
+        CHECK(Checkpoint(path, input, 1, false).load(done, bytes));
+        CHECK(!Checkpoint(path, other, 1, false).load(done, bytes));
+        timespec times[2] = {{0, UTIME_OMIT}, {1, 0}};
+        CHECK_EQUAL(0, utimensat(AT_FDCWD, input.c_str(), times, 0));
+        CHECK(!Checkpoint(path, input, 1, false).load(done, bytes));
+        CHECK_THROW(Checkpoint(path, "/nonexistent/input", 1, false), std::system_error);
+        for (const string& file : {path, input, other})
+            unlink(file.c_str());
+    }
+}
+
+/**
+ * @brief Тесты хеша XXH64
+ */
+SUITE(XxHashTest){
+    /**
+     * @brief Тест совпадения с эталонной реализацией
+     * @details Проверяются длины короче полосы, кратная полосе и с остатком
+     */
+    TEST(ReferenceValues){
+        unsigned char bytes[100];
+        for (int i = 0; i < 100; i++)
+            bytes[i] = i;
+        CHECK_EQUAL(0xef46db3751d8e999ULL, xxh64("", 0));
+        CHECK_EQUAL(0x44bc2cf5ad770999ULL, xxh64("abc", 3));
+        CHECK_EQUAL(0xf5da40f1b11741e9ULL, xxh64(bytes, 40));
+        CHECK_EQUAL(0x6ac1e58032166597ULL, xxh64(bytes, 100));
+    }
+}
+
+/**
+ * @brief Тесты кэша результатов
+ */
+SUITE(ResultCacheTest){
+    /**
+     * @brief Ключ кадра заданной длины для тестов
+     * @param[in] hash Хеш кадра
+     * @param[in] length Длина кадра в байтах
+     * @return Ключ
+     */
+    static ResultCache::Key key(uint64_t hash, uint64_t length = 12){
+        return {hash, length};
+    }
+
+    /**
+     * @brief Тест вытеснения давно использованных записей
+     * @details Запись, к которой обращались, остаётся, вытесняется
+     * самая давно использованная
+     */
+    TEST(EvictsLeastRecentlyUsed){
+        string path = writeTempFile("");
+        ResultCache cache(path, 2);
+        double r = 0;
+        cache.insert(key(1), 1.5);
+        cache.insert(key(2), 2.5);
+        CHECK(cache.lookup(key(1), r));
+        CHECK_EQUAL(1.5, r);
+        cache.insert(key(3), 3.5);
+        CHECK(!cache.lookup(key(2), r));
+        CHECK(cache.lookup(key(3), r));
+        CHECK_EQUAL(3.5, r);
+        CHECK_EQUAL(2u, cache.size());
+        CHECK_EQUAL(2u, cache.hits());
+        CHECK_EQUAL(1u, cache.misses());
+        CHECK_EQUAL(1u, cache.evictions());
+        unlink(path.c_str());
+    }
+
+    /**
+     * @brief Тест коллизии хешей
+     * @details Кадр с тем же хешем, но другой длины не получает чужой
+     * результат; его результат заменяет запись
+     */
+    TEST(LengthMismatchMisses){
+        string path = writeTempFile("");
+        ResultCache cache(path);
+        double r = 0;
+        cache.insert(key(7, 12), 1.5);
+        CHECK(!cache.lookup(key(7, 20), r));
+        cache.insert(key(7, 20), 2.5);
+        CHECK(!cache.lookup(key(7, 12), r));
+        CHECK(cache.lookup(key(7, 20), r));
+        CHECK_EQUAL(2.5, r);
+        CHECK_EQUAL(1u, cache.size());
+        unlink(path.c_str());
+    }
+
+    /**
+     * @brief Тест сохранения и чтения файла кэша
+     * @details При чтении в кэш меньшего размера остаются недавно
+     * использованные записи; длина кадра сохраняется вместе с хешем;
+     * файл другого формата не читается, файл прежнего формата читается
+     * как пустой кэш
+     */
+    TEST(SaveAndLoad){
+        string path = writeTempFile("");
+        {
+            ResultCache cache(path);
+            for (uint64_t k = 1; k <= 3; k++)
+                cache.insert(key(k), k * 0.25);
+            cache.save();
+        }
+        double r = 0;
+        ResultCache all(path);
+        CHECK_EQUAL(3u, all.size());
+        CHECK(all.lookup(key(2), r));
+        CHECK_EQUAL(0.5, r);
+        CHECK(!all.lookup(key(2, 20), r));
+        ResultCache recent(path, 1);
+        CHECK_EQUAL(1u, recent.size());
+        CHECK(recent.lookup(key(3), r));
+        CHECK(!recent.lookup(key(1), r));
+        string other = writeTempFile("not a cache");
+        CHECK_THROW(ResultCache bad(other), std::system_error);
+        uint32_t old[4] = {CACHE_MAGIC_OLD, 0, 0, 0};
+        string oldPath = writeTempFile(string(reinterpret_cast<const char*>(old), sizeof(old)));
+        CHECK_EQUAL(0u, ResultCache(oldPath).size());
+        unlink(path.c_str());
+        unlink(other.c_str());
+        unlink(oldPath.c_str());
+    }
+}
+
+/**
+ * @brief Тесты индексированного файла результатов
+ */
+SUITE(IndexedResultFileTest){
+    /**
+     * @brief Тест записи вне порядка из нескольких потоков и экспорта
+     * @details Результаты, записанные в свои ячейки разными потоками,
+     * экспортируются в текстовый файл в порядке индексов
+     */
+    TEST(OutOfOrderWritesAreExportedInOrder){
+        string path = writeTempFile("");
+        string text = writeTempFile("");
+        {
+            IndexedResultFile file(path, 1000);
+            OrderedResults results(nullptr, &file);
+            thread odd([&]{
+                for (uint32_t i = 1; i < 1000; i += 2)
+                    results.put(i, i * 0.5);
+            });
+            for (uint32_t i = 0; i < 1000; i += 2)
+                results.put(i, i * 0.5);
+            odd.join();
+            CHECK_EQUAL(1000u, results.written());
+            results.close();
+        }
+        exportResults(path, text);
+        string expected;
+        for (uint32_t i = 0; i < 1000; i++)
+            expected += (i % 2 ? to_string(i / 2) + ".5" : to_string(i / 2)) + "\n";
+        CHECK_EQUAL(expected, readFile(text));
+        unlink(path.c_str());
+        unlink(text.c_str());
+    }
+
+    /**
+     * @brief Тест повторного открытия незаполненного файла
+     * @details Заполненные ячейки сохраняются, повторная запись ячейки
+     * отбрасывается, экспорт неполного файла завершается ошибкой
+     */
+    TEST(IncompleteFileIsNotExported){
+        string path = writeTempFile("");
+        {
+            IndexedResultFile file(path, 3);
+            file.put(2, 52);
+            file.put(2, 60);
+            CHECK_EQUAL(1u, file.written());
+            file.close();
+        }
+        IndexedResultFile file(path);
+        CHECK_EQUAL(3u, file.count());
+        CHECK_EQUAL(1u, file.written());
+        double result;
+        CHECK(!file.get(0, result));
+        CHECK(file.get(2, result));
+        CHECK_EQUAL(52.0, result);
+        CHECK_THROW(exportResults(path, "/dev/null"), std::system_error);
+        unlink(path.c_str());
+    }
+
+    /**
+     * @brief Тест открытия файла другого формата
+     */
+    TEST(ForeignFileThrows){
+        string path = writeTempFile("227.2\n66.8\n");
+        CHECK_THROW(IndexedResultFile file(path), std::system_error);
+        unlink(path.c_str());
+    }
+}
+
+/**
+ * @class FakeServer
+ * @brief Сервер для тестов клиента на локальном адресе
+ * @details Принимает любые учётные данные и отвечает на каждый вектор
+ * суммой его элементов; каждое подключение обслуживается своим потоком
+ * и может разрываться сервером после заданного количества ответов.
+ * Первое подключение может зависать: после заданного количества ответов
+ * оно читает данные клиента, но больше не отвечает. Ответы могут
+ * задерживаться, как у медленного сервера
+ */
+class FakeServer {
+private:
+    int listener;           ///< Слушающий сокет
+    thread acceptor;        ///< Поток приёма подключений
+    vector<thread> threads; ///< Потоки обслуживания подключений
+
+    /**
+     * @brief Обслуживание подключения до его закрытия клиентом
+     * @param[in] s Дескриптор подключения
+     * @param[in] dropAfter Количество ответов до разрыва подключения (0 - без разрыва)
+     * @param[in] stallAfter Количество ответов до зависания подключения (0 - без зависания)
+     * @param[in] delay Пауза перед каждым ответом в миллисекундах
+     */
+    static void serve(int s, uint32_t dropAfter, uint32_t stallAfter, uint32_t delay){
+        char login[64];
+        char hash[32];
+        if (recv(s, login, sizeof(login), 0) <= 0
+            || send(s, "0123456789ABCDEF", SALT_LENGTH, 0) != SALT_LENGTH
+            || recv(s, hash, sizeof(hash), MSG_WAITALL) != sizeof(hash)
+            || send(s, AUTH_OK, strlen(AUTH_OK), 0) != (ssize_t)strlen(AUTH_OK)) {
+            close(s);
+            return;
+        }
+        SocketReader reader(s);
+        try {
+            for (;;) {
+                uint32_t count, size;
+                reader.readExact(&count, sizeof(count));
+                for (uint32_t i = 0; i < count; i++){
+                    reader.readExact(&size, sizeof(size));
+                    vector<double> v(size);
+                    reader.readExact(v.data(), size * sizeof(double));
+                    double sum = 0;
+                    for (double x : v)
+                        sum += x;
+                    this_thread::sleep_for(chrono::milliseconds(delay));
+                    send(s, &sum, sizeof(sum), MSG_NOSIGNAL);
+                    if (--dropAfter == 0)
+                        throw system_error(ECONNRESET, generic_category());
+                    if (--stallAfter == 0) {
+                        char buf[4096];
+                        while (recv(s, buf, sizeof(buf), 0) > 0)
+                            ;
+                        throw system_error(ECONNRESET, generic_category());
+                    }
+                }
+            }
+        } catch (const system_error&) {
+        }
+        close(s);
+    }
+
+public:
+    int port; ///< Порт сервера
+
+    /**
+     * @brief Конструктор: запуск сервера на свободном порту
+     * @param[in] dropAfter Количество ответов до разрыва каждого подключения (0 - без разрыва)
+     * @param[in] stallAfter Количество ответов до зависания первого подключения (0 - без зависания)
+     * @param[in] delay Пауза перед каждым ответом в миллисекундах
+     */
+    explicit FakeServer(uint32_t dropAfter = 0, uint32_t stallAfter = 0, uint32_t delay = 0){
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        bind(listener, (sockaddr*) &addr, len);
+        listen(listener, 16);
+        getsockname(listener, (sockaddr*) &addr, &len);
+        port = ntohs(addr.sin_port);
+        acceptor = thread([this, dropAfter, stallAfter, delay]{
+            int s;
+            while ((s = accept(listener, nullptr, nullptr)) != -1)
+                threads.emplace_back(serve, s, dropAfter, threads.empty() ? stallAfter : 0, delay);
+        });
+    }
+
+    ~FakeServer(){
+        shutdown(listener, SHUT_RDWR);
+        acceptor.join();
+        close(listener);
+        for (thread& t : threads)
+            t.join();
+    }
+};
+
+/**
+ * @brief Тесты асинхронного клиента
+ */
+SUITE(ClientTest){
+    /**
+     * @brief Параметры подключения к тестовому серверу
+     * @param[in] server Тестовый сервер
+     * @param[in] connections Количество сессий
+     * @param[in] window Количество векторов в полёте на сессию
+     * @return Параметры клиента
+     */
+    static Params clientParams(const FakeServer& server, uint32_t connections, uint32_t window){
+        Params p;
+        p.inFileData = "data.txt";
+        p.Address = "127.0.0.1";
+        p.Port = server.port;
+        p.Connections = connections;
+        p.Window = window;
+        return p;
+    }
+
+    /**
+     * @brief Тест запросов из нескольких потоков
+     * @details Каждый результат приходит в future своего вектора,
+     * хотя векторы разных потоков идут по общим сессиям вперемешку
+     */
+    TEST(SubmitFromThreads){
+        FakeServer server;
+        Params p = clientParams(server, 2, 4);
+        Client client(&p);
+        vector<thread> threads;
+        vector<int> wrong(4, 0);
+        for (int t = 0; t < 4; t++)
+            threads.emplace_back([&, t]{
+                vector<future<double>> results;
+                for (int i = 0; i < 50; i++){
+                    vector<double> v(i + 1, t + 1);
+                    results.push_back(client.submit(v));
+                }
+                for (int i = 0; i < 50; i++)
+                    wrong[t] += results[i].get() != (i + 1) * (t + 1);
+            });
+        for (thread& t : threads)
+            t.join();
+        for (int t = 0; t < 4; t++)
+            CHECK_EQUAL(0, wrong[t]);
+    }
+
+    /**
+     * @brief Тест набора векторов одним заданием
+     * @details Набор больше окна: отправка ждёт ответов, не теряя порядок
+     */
+    TEST(BatchKeepsOrder){
+        FakeServer server;
+        Params p = clientParams(server, 1, 3);
+        Client client(&p);
+        vector<vector<double>> vectors;
+        vector<span<const double>> batch;
+        for (int i = 0; i < 10; i++)
+            vectors.emplace_back(i, 0.5);
+        for (vector<double>& v : vectors)
+            batch.emplace_back(v);
+        vector<future<double>> results = client.submitBatch(batch);
+        CHECK_EQUAL(10u, results.size());
+        for (int i = 0; i < 10; i++)
+            CHECK_EQUAL(i * 0.5, results[i].get());
+    }
+
+    /**
+     * @brief Тест вектора, не помещающегося в кадр
+     * @details Вектор длиннее UINT32_MAX элементов получает EMSGSIZE без
+     * отправки, соседние векторы набора обрабатываются сервером
+     */
+    TEST(OversizedVectorRejected){
+        FakeServer server;
+        Params p = clientParams(server, 1, 2);
+        Client client(&p);
+        vector<double> small(3, 1.0);
+        // Элементы не читаются: вектор отклоняется по размеру
+        span<const double> huge(small.data(), size_t(UINT32_MAX) + 1);
+        vector<span<const double>> batch{small, huge, small};
+        vector<future<double>> results = client.submitBatch(batch);
+        CHECK_EQUAL(3.0, results[0].get());
+        try {
+            results[1].get();
+            CHECK(false);
+        } catch (const system_error& e) {
+            CHECK_EQUAL(EMSGSIZE, e.code().value());
+        }
+        CHECK_EQUAL(3.0, results[2].get());
+        CHECK_THROW(client.submit(huge).get(), std::system_error);
+        CHECK_EQUAL(3.0, client.submit(small).get());
+    }
+
+    /**
+     * @brief Тест отправки после файлового задания
+     * @details Сервер закрывает подключение после ответов на задание;
+     * следующий вектор отправляется по новой сессии, а не по закрытой
+     */
+    TEST(SubmitAfterRun){
+        FakeServer server(2);
+        Params p = clientParams(server, 1, 2);
+        p.inFileName = writeTempFile("2\n1 1\n2 1 1\n");
+        p.inFileResult = writeTempFile("");
+        Client client(&p);
+        CHECK_EQUAL(0, client.run(&p));
+        CHECK_EQUAL(string("1\n2\n"), readFile(p.inFileResult));
+        // Закрытие подключения сервером доходит до клиента не сразу
+        this_thread::sleep_for(chrono::milliseconds(50));
+        vector<double> v(3, 1.0);
+        CHECK_EQUAL(3.0, client.submit(v).get());
+        unlink(p.inFileName.c_str());
+        unlink(p.inFileResult.c_str());
+    }
+
+    /**
+     * @brief Тест ошибки подключения
+     * @details Сессии открываются в фоне, поэтому конструктор не выбрасывает
+     * исключение, а отказ в подключении приходит в future запроса
+     */
+    TEST(ConnectErrorInFuture){
+        Params p;
+        {
+            FakeServer server;
+            p = clientParams(server, 1, 4);
+        }
+        Client client(&p);
+        vector<double> v(3, 1.0);
+        future<double> result = client.submit(v);
+        CHECK_THROW(result.get(), std::system_error);
+    }
+
+    /**
+     * @brief Тест продолжения файлового задания после разрыва соединения
+     * @details Сервер разрывает каждое подключение после трёх ответов;
+     * задание продолжается с первого вектора без результата, и файл
+     * результатов совпадает с результатом задания без разрывов
+     */
+    TEST(RunResumesAfterDisconnect){
+        FakeServer server(3);
+        Params p = clientParams(server, 1, 2);
+        p.inFileName = writeTempFile("8\n1 1\n1 2\n1 3\n1 4\n1 5\n1 6\n1 7\n2 4 4\n");
+        p.inFileResult = writeTempFile("");
+        p.Retries = 3;
+        {
+            Client client(&p);
+            CHECK_EQUAL(0, client.run(&p));
+        }
+        CHECK_EQUAL(string("1\n2\n3\n4\n5\n6\n7\n8\n"), readFile(p.inFileResult));
+        CHECK(access((p.inFileResult + CHECKPOINT_SUFFIX).c_str(), F_OK) != 0);
+        p.Retries = 1;
+        {
+            Client client(&p);
+            CHECK_THROW(client.run(&p), std::system_error);
+        }
+        unlink(p.inFileName.c_str());
+        unlink(p.inFileResult.c_str());
+        unlink((p.inFileResult + CHECKPOINT_SUFFIX).c_str());
+    }
+
+    /**
+     * @brief Тест разбора вектора длиннее STREAM_CHUNK
+     * @details Вектор из 2 * STREAM_CHUNK + 1 элементов приходит тремя
+     * буферами: размер кадра несёт каждый, признак начала - только первый;
+     * двух буферов пула хватает, и их вместимость не растёт с размером вектора
+     */
+    TEST(ParseSplitsLongVector){
+        const uint32_t size = STREAM_CHUNK * 2 + 1;
+        string text = "2\n" + to_string(size);
+        for (uint32_t i = 0; i < size; i++)
+            text += i % 2 ? " 2" : " -1";
+        text += "\n1 7\n";
+        string path = writeTempFile(text);
+        VectorParser parser(path);
+        CHECK_EQUAL(2u, parser.readCount());
+        BufferPool pool(2);
+        SpscRing<VectorBuffer*> ring(2);
+        thread producer([&]{
+            Connection::parseVectors(parser, 0, 2, pool, ring, nullptr);
+            ring.close();
+        });
+        vector<uint32_t> pieces, frames;
+        vector<bool> starts;
+        double sum = 0;
+        size_t reserved = 0;
+        VectorBuffer* buffer;
+        while (ring.pop(buffer)){
+            pieces.push_back(buffer->size);
+            frames.push_back(buffer->frameSize);
+            starts.push_back(buffer->frameStart);
+            if (buffer->frameSize == size)
+                for (uint32_t i = 0; i < buffer->size; i++)
+                    sum += buffer->data()[i];
+            reserved = max(reserved, buffer->reserved());
+            pool.release(buffer);
+        }
+        producer.join();
+        CHECK(pieces == vector<uint32_t>({STREAM_CHUNK, STREAM_CHUNK, 1, 1}));
+        CHECK(frames == vector<uint32_t>({size, size, size, 1}));
+        CHECK(starts == vector<bool>({true, false, false, true}));
+        CHECK_EQUAL(STREAM_CHUNK - 1.0, sum);
+        CHECK(reserved <= STREAM_CHUNK);
+        unlink(path.c_str());
+    }
+
+    /**
+     * @brief Тест задания с вектором длиннее STREAM_CHUNK
+     * @details Размер уходит на сервер только перед первой частью вектора,
+     * поэтому сервер получает цельный кадр, а следующий вектор не сдвигается
+     */
+    TEST(RunStreamsLongVector){
+        FakeServer server;
+        Params p = clientParams(server, 1, 2);
+        const uint32_t size = STREAM_CHUNK * 2 + 1;
+        string text = "3\n1 5\n" + to_string(size);
+        for (uint32_t i = 0; i < size; i++)
+            text += " 0.5";
+        text += "\n2 1 2\n";
+        p.inFileName = writeTempFile(text);
+        p.inFileResult = writeTempFile("");
+        {
+            Client client(&p);
+            CHECK_EQUAL(0, client.run(&p));
+        }
+        CHECK_EQUAL("5\n" + to_string(size / 2) + ".5\n3\n", readFile(p.inFileResult));
+        unlink(p.inFileName.c_str());
+        unlink(p.inFileResult.c_str());
+    }
+
+    /**
+     * @brief Тест задания через цикл событий
+     * @details Четыре сессии ведёт один поток epoll: сначала он сам проходит
+     * подключение, логин, соль, хеш и OK, затем принимает уже открытые
+     * сессии клиента. Длинный вектор не помещается в буферы сокета и
+     * проверяет частичную запись и разбор результатов по частям
+     */
+    TEST(RunEpollSharded){
+        FakeServer server;
+        Params p = clientParams(server, 4, 4);
+        p.Epoll = true;
+        string input = "301\n";
+        string expected;
+        for (int i = 0; i < 300; i++){
+            int size = i % 17 + 1;
+            input += to_string(size);
+            for (int j = 0; j < size; j++)
+                input += " " + to_string(i);
+            input += "\n";
+            expected += to_string(size * i) + "\n";
+        }
+        input += "200001";
+        for (int j = 0; j < 200001; j++)
+            input += " 3";
+        input += "\n";
+        expected += "600003\n";
+        p.inFileName = writeTempFile(input);
+        p.inFileResult = writeTempFile("");
+        CHECK_EQUAL(0, Connection::conn(&p));
+        CHECK_EQUAL(expected, readFile(p.inFileResult));
+        unlink(p.inFileResult.c_str());
+        {
+            Client client(&p);
+            CHECK_EQUAL(0, client.run(&p));
+        }
+        CHECK_EQUAL(expected, readFile(p.inFileResult));
+        unlink(p.inFileName.c_str());
+        unlink(p.inFileResult.c_str());
+    }
+
+    /**
+     * @brief Тест разрыва соединения в цикле событий
+     * @details Сервер разрывает каждое подключение после трёх ответов; без
+     * повторных подключений задание завершается system_error, а не зависает
+     */
+    TEST(RunEpollFailsOnDisconnect){
+        FakeServer server(3);
+        Params p = clientParams(server, 2, 2);
+        p.Epoll = true;
+        string input = "40\n";
+        for (int i = 0; i < 40; i++)
+            input += "2 1 " + to_string(i) + "\n";
+        p.inFileName = writeTempFile(input);
+        p.inFileResult = writeTempFile("");
+        CHECK_THROW(Connection::conn(&p), std::system_error);
+        unlink(p.inFileName.c_str());
+        unlink(p.inFileResult.c_str());
+        unlink((p.inFileResult + CHECKPOINT_SUFFIX).c_str());
+    }
+
+    /**
+     * @brief Тест задания с кэшем результатов
+     * @details Второй запуск берёт все результаты из кэша и ничего не
+     * отправляет: сервер разрывает подключение после первого ответа,
+     * а повторные подключения запрещены
+     */
+    TEST(RunUsesCache){
+        FakeServer server(1);
+        Params p = clientParams(server, 1, 2);
+        p.inFileName = writeTempFile("3\n1 1\n2 1 1\n1 3\n");
+        p.inFileResult = writeTempFile("");
+        p.CacheFile = writeTempFile("");
+        p.Retries = 3;
+        {
+            Client client(&p);
+            CHECK_EQUAL(0, client.run(&p));
+        }
+        p.Retries = 0;
+        unlink(p.inFileResult.c_str());
+        {
+            Client client(&p);
+            CHECK_EQUAL(0, client.run(&p));
+        }
+        CHECK_EQUAL(string("1\n2\n3\n"), readFile(p.inFileResult));
+        unlink(p.inFileName.c_str());
+        unlink(p.inFileResult.c_str());
+        unlink(p.CacheFile.c_str());
+    }
+
+    /**
+     * @brief Тест повторов внутри задания
+     * @details С кэшем вектор, повторяющий уже отправленный, серверу не
+     * отправляется и получает результат первого такого вектора
+     */
+    TEST(RunSendsRepeatsOnce){
+        LocalServer server("user", "P@ssW0rd");
+        Params p;
+        p.inFileData = writeTempFile("user\nP@ssW0rd\n");
+        p.Address = "127.0.0.1";
+        p.Port = server.port();
+        p.Connections = 1;
+        p.Window = 2;
+        p.inFileName = writeTempFile("6\n2 1 2\n1 5\n2 1 2\n2 1 2\n1 5\n1 7\n");
+        p.inFileResult = writeTempFile("");
+        p.CacheFile = writeTempFile("");
+        CHECK_EQUAL(0, Connection::conn(&p));
+        CHECK_EQUAL(string("3\n5\n3\n3\n5\n7\n"), readFile(p.inFileResult));
+        CHECK_EQUAL(3u, server.served());
+        for (const string& path : {p.inFileData, p.inFileName, p.inFileResult, p.CacheFile})
+            unlink(path.c_str());
+    }
+
+    /**
+     * @brief Тест кэша, общего для заданий клиента
+     * @details Второе задание берёт результаты из кэша, заполненного первым,
+     * без обращения к серверу; файл кэша не переписывается после каждого
+     * задания и сохраняется при уничтожении клиента
+     */
+    TEST(RunSharesCacheBetweenJobs){
+        LocalServer server("user", "P@ssW0rd");
+        Params p;
+        p.inFileData = writeTempFile("user\nP@ssW0rd\n");
+        p.Address = "127.0.0.1";
+        p.Port = server.port();
+        p.Connections = 1;
+        p.inFileName = writeTempFile("2\n2 1 2\n1 5\n");
+        p.inFileResult = writeTempFile("");
+        p.CacheFile = writeTempFile("");
+        {
+            Client client(&p);
+            CHECK_EQUAL(0, client.run(&p));
+            CHECK_EQUAL(0, client.run(&p));
+            CHECK_EQUAL(string("3\n5\n"), readFile(p.inFileResult));
+            CHECK_EQUAL(2u, server.served());
+            CHECK_EQUAL(string(""), readFile(p.CacheFile));
+        }
+        CHECK_EQUAL(2u, ResultCache(p.CacheFile).size());
+        for (const string& path : {p.inFileData, p.inFileName, p.inFileResult, p.CacheFile})
+            unlink(path.c_str());
+    }
+
+    /**
+     * @brief Тест выборочной проверки результатов сервера
+     * @details Тестовый сервер складывает без компенсации и теряет единицу
+     * второго вектора; проверка всех результатов замечает расхождение и
+     * завершает задание ошибкой EBADMSG, записав результаты сервера
+     */
+    TEST(RunVerifiesSample){
+        FakeServer server;
+        Params p = clientParams(server, 1, 2);
+        p.inFileName = writeTempFile("2\n1 5\n3 1e16 1 -1e16\n");
+        p.inFileResult = writeTempFile("");
+        p.VerifySample = 1;
+        {
+            Client client(&p);
+            try {
+                client.run(&p);
+                CHECK(false);
+            } catch (const system_error& e) {
+                CHECK_EQUAL(EBADMSG, e.code().value());
+            }
+        }
+        CHECK_EQUAL(string("5\n0\n"), readFile(p.inFileResult));
+        unlink(p.inFileName.c_str());
+        unlink(p.inFileResult.c_str());
+    }
+
+    /**
+     * @brief Тест задания без сервера
+     * @details Результаты вычисляются локально компенсированным
+     * суммированием и записываются в тот же формат, что от сервера
+     */
+    TEST(RunOffline){
+        Params p;
+        p.inFileName = writeTempFile("3\n1 5\n3 1e16 1 -1e16\n2 0.25 0.5\n");
+        p.inFileResult = writeTempFile("");
+        p.Offline = true;
+        CHECK_EQUAL(0, Connection::offline(&p));
+        CHECK_EQUAL(string("5\n1\n0.75\n"), readFile(p.inFileResult));
+        unlink(p.inFileName.c_str());
+        unlink(p.inFileResult.c_str());
+    }
+
+    /**
+     * @brief Тест дублирования запросов при зависшей сессии
+     * @details Первое подключение перестаёт отвечать; пакеты, застрявшие
+     * в нём, повторяются по второй сессии, и задание завершается без
+     * тайм-аута и без повторных подключений
+     */
+    TEST(RunHedgesAroundStalledSession){
+        FakeServer server(0, 5);
+        Params p = clientParams(server, 2, 4);
+        string input = "400\n";
+        string expected;
+        for (int i = 0; i < 400; i++){
+            input += "1 " + to_string(i) + "\n";
+            expected += to_string(i) + "\n";
+        }
+        p.inFileName = writeTempFile(input);
+        p.inFileResult = writeTempFile("");
+        p.HedgePercentile = 50;
+        p.Timeout = 10000;
+        {
+            Client client(&p);
+            CHECK_EQUAL(0, client.run(&p));
+        }
+        CHECK_EQUAL(expected, readFile(p.inFileResult));
+        unlink(p.inFileName.c_str());
+        unlink(p.inFileResult.c_str());
+    }
+
+    /**
+     * @brief Тест тайм-аута зависшей сессии
+     * @details Без повторных подключений задание завершается ошибкой
+     * ETIMEDOUT; с повторным подключением продолжается по новой сессии
+     */
+    TEST(RunTimesOutOnStalledSession){
+        Params p;
+        string input = writeTempFile("4\n1 1\n1 2\n1 3\n1 4\n");
+        {
+            FakeServer server(0, 2);
+            p = clientParams(server, 1, 2);
+            p.inFileName = input;
+            p.inFileResult = writeTempFile("");
+            p.Timeout = 200;
+            Client client(&p);
+            try {
+                client.run(&p);
+                CHECK(false);
+            } catch (const system_error& e) {
+                CHECK_EQUAL(ETIMEDOUT, e.code().value());
+            }
+        }
+        {
+            FakeServer server(0, 2);
+            p.Port = server.port;
+            p.Retries = 1;
+            Client client(&p);
+            CHECK_EQUAL(0, client.run(&p));
+        }
+        CHECK_EQUAL(string("1\n2\n3\n4\n"), readFile(p.inFileResult));
+        unlink(p.inFileName.c_str());
+        unlink(p.inFileResult.c_str());
+        unlink((p.inFileResult + CHECKPOINT_SUFFIX).c_str());
+    }
+
+    /**
+     * @brief Тест срока ответа на каждый вектор
+     * @details Сервер отвечает на каждый вектор через 150 мс: паузы между
+     * ответами меньше тайм-аута 250 мс, но второй вектор ждёт ответа 300 мс
+     * после отправки. Задание (в потоках и в цикле событий) и набор
+     * векторов завершаются ошибкой ETIMEDOUT
+     */
+    TEST(TimeoutCountsFromSend){
+        FakeServer server(0, 0, 150);
+        Params p = clientParams(server, 1, 4);
+        p.inFileName = writeTempFile("4\n1 1\n1 2\n1 3\n1 4\n");
+        p.inFileResult = writeTempFile("");
+        p.Timeout = 250;
+        for (bool epoll : {false, true}) {
+            p.Epoll = epoll;
+            Client client(&p);
+            try {
+                client.run(&p);
+                CHECK(false);
+            } catch (const system_error& e) {
+                CHECK_EQUAL(ETIMEDOUT, e.code().value());
+            }
+        }
+        p.Epoll = false;
+        Client client(&p);
+        vector<double> v(1, 1.0);
+        vector<span<const double>> batch(4, span<const double>(v));
+        vector<future<double>> results = client.submitBatch(batch);
+        CHECK_EQUAL(1.0, results[0].get());
+        try {
+            results[1].get();
+            CHECK(false);
+        } catch (const system_error& e) {
+            CHECK_EQUAL(ETIMEDOUT, e.code().value());
+        }
+        unlink(p.inFileName.c_str());
+        unlink(p.inFileResult.c_str());
+        unlink((p.inFileResult + CHECKPOINT_SUFFIX).c_str());
+    }
+}
+
+/**
+ * @brief Тесты локального сервера векторов
+ */
+SUITE(LocalServerTest){
+    /**
+     * @brief Тест обработки задания
+     * @details Сессия с верными учётными данными открывается, на задание
+     * из нескольких векторов приходят суммы их элементов
+     */
+    TEST(AuthenticatesAndSums){
+        LocalServer server("user", "P@ssW0rd");
+        Params p;
+        p.Address = "127.0.0.1";
+        p.Port = server.port();
+        Session session(&p, "user", "P@ssW0rd");
+        double first[] = {1.5, 2.5, -1};
+        double second[] = {1e3};
+        uint32_t count = 3;
+        session.writer.write(&count, sizeof(count));
+        session.writer.writeFrame(3, first);
+        session.writer.writeFrame(1, second);
+        session.writer.writeFrame(0, nullptr);
+        session.writer.flush();
+        double results[3];
+        session.reader.readExact(results, sizeof(results));
+        CHECK_EQUAL(3.0, results[0]);
+        CHECK_EQUAL(1e3, results[1]);
+        CHECK_EQUAL(0.0, results[2]);
+        CHECK_EQUAL(3u, server.served());
+    }
+
+    /**
+     * @brief Тест ответа, за которым уже пришёл заголовок следующего пакета
+     * @details Клиент с окном в один вектор присылает следующий кадр только
+     * после ответа, поэтому ответ уходит, не дожидаясь кадра
+     */
+    TEST(AnswersBeforeNextFrame){
+        LocalServer server("user", "P@ssW0rd");
+        Params p;
+        p.Address = "127.0.0.1";
+        p.Port = server.port();
+        Session session(&p, "user", "P@ssW0rd");
+        double element = 2;
+        uint32_t count = 1;
+        session.writer.write(&count, sizeof(count));
+        session.writer.writeFrame(1, &element);
+        session.writer.write(&count, sizeof(count));
+        session.writer.flush();
+        session.reader.setDeadline(chrono::steady_clock::now() + chrono::seconds(2));
+        double result;
+        session.reader.readExact(&result, sizeof(result));
+        CHECK_EQUAL(2.0, result);
+    }
+
+    /**
+     * @brief Тест неверного пароля
+     * @details Сервер отказывает в аутентификации, сессия не открывается
+     */
+    TEST(WrongPasswordIsRejected){
+        LocalServer server("user", "P@ssW0rd");
+        Params p;
+        p.Address = "127.0.0.1";
+        p.Port = server.port();
+        try {
+            Session session(&p, "user", "wrong");
+            CHECK(false);
+        } catch (const system_error& e) {
+            CHECK_EQUAL(EACCES, e.code().value());
+        }
+    }
+}
+
+/**
+ * @brief Тесты режима службы
+ */
+SUITE(DaemonTest){
+    /**
+     * @brief Параметры службы для локального сервера
+     * @param[in] server Локальный сервер
+     * @return Параметры с временным файлом учётных данных
+     */
+    static Params daemonParams(LocalServer& server){
+        Params p;
+        p.inFileData = writeTempFile("user\nP@ssW0rd\n");
+        p.Address = "127.0.0.1";
+        p.Port = server.port();
+        p.Connections = 1;
+        p.Window = 4;
+        return p;
+    }
+
+    /**
+     * @brief Тест нескольких заданий по одной сессии
+     * @details Два задания выполняются по сессии, открытой при запуске
+     * службы: сервер принимает одно подключение, на каждое задание
+     * приходит ответ OK с путём файла результатов
+     */
+    TEST(JobsReuseSessions){
+        LocalServer server("user", "P@ssW0rd");
+        Params p = daemonParams(server);
+        string firstIn = writeTempFile("2\n2 1 2\n1 4\n");
+        string secondIn = writeTempFile("1\n3 1 1 1\n");
+        string firstOut = writeTempFile("");
+        string secondOut = writeTempFile("");
+        {
+            Daemon daemon(&p);
+            CHECK_EQUAL("OK " + firstOut + "\n", daemon.runLine(firstIn + " " + firstOut));
+            CHECK_EQUAL("OK " + secondOut + "\n", daemon.runLine(secondIn + " " + secondOut));
+            CHECK_EQUAL(size_t(1), server.connections());
+        }
+        CHECK_EQUAL(string("3\n4\n"), readFile(firstOut));
+        CHECK_EQUAL(string("3\n"), readFile(secondOut));
+        CHECK_EQUAL(3u, server.served());
+        for (const string& path : {p.inFileData, firstIn, secondIn, firstOut, secondOut})
+            unlink(path.c_str());
+    }
+
+    /**
+     * @brief Тест ответов на ошибочные задания
+     * @details Несуществующий входной файл и строка неверного формата
+     * дают ответ ERR с путём файла результатов (пустым, если его нет),
+     * после чего следующее задание выполняется
+     */
+    TEST(ErrorsAreReported){
+        LocalServer server("user", "P@ssW0rd");
+        Params p = daemonParams(server);
+        string input = writeTempFile("1\n2 2 3\n");
+        string output = writeTempFile("");
+        Daemon daemon(&p);
+        string reply = daemon.runLine("/nonexistent/input " + output);
+        CHECK_EQUAL("ERR " + output + " ", reply.substr(0, output.size() + 5));
+        reply = daemon.runLine("onlyone");
+        CHECK_EQUAL(string("ERR  "), reply.substr(0, 5));
+        reply = daemon.runLine("a b c");
+        CHECK_EQUAL(string("ERR b "), reply.substr(0, 6));
+        CHECK_EQUAL(string(""), daemon.runLine("  "));
+        CHECK_EQUAL("OK " + output + "\n", daemon.runLine(input + " " + output));
+        CHECK_EQUAL(string("5\n"), readFile(output));
+        for (const string& path : {p.inFileData, input, output})
+            unlink(path.c_str());
+    }
+
+    /**
+     * @brief Тест приёма заданий из потока
+     * @details Задания, пришедшие одной порцией, в том числе последнее
+     * без перевода строки, выполняются по порядку, ответы пишутся в поток
+     */
+    TEST(ServeReadsLines){
+        LocalServer server("user", "P@ssW0rd");
+        Params p = daemonParams(server);
+        string input = writeTempFile("1\n2 2 3\n");
+        string first = writeTempFile("");
+        string second = writeTempFile("");
+        int in[2], out[2];
+        CHECK_EQUAL(0, pipe(in));
+        CHECK_EQUAL(0, pipe(out));
+        string jobs = input + " " + first + "\n\n" + input + " " + second;
+        CHECK_EQUAL(ssize_t(jobs.size()), write(in[1], jobs.data(), jobs.size()));
+        close(in[1]);
+        {
+            Daemon daemon(&p);
+            daemon.serve(in[0], out[1]);
+        }
+        close(in[0]);
+        close(out[1]);
+        char buf[4096];
+        ssize_t n = read(out[0], buf, sizeof(buf));
+        close(out[0]);
+        CHECK_EQUAL("OK " + first + "\nOK " + second + "\n", string(buf, n > 0 ? n : 0));
+        CHECK_EQUAL(size_t(1), server.connections());
+        for (const string& path : {p.inFileData, input, first, second})
+            unlink(path.c_str());
+    }
+}
+
 /**
  * @brief Главная функция тестов
  * @details Запускает все тесты и возвращает код результата выполнения
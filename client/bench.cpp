@@ -0,0 +1,189 @@
+#include "client.h"
+#include "local_server.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <csignal>
+#include <unistd.h>
+
+#define BENCH_LOGIN "bench"                ///< Логин для локального сервера
+#define BENCH_PASSWORD "bench"             ///< Пароль для локального сервера
+#define BENCH_MAX_ELEMENTS (1 << 24)       ///< Наибольшее количество элементов во входном файле задания
+#define BENCH_LATENCY_SAMPLES 10000        ///< Наибольшее количество векторов для замера задержки
+#define BENCH_HANDSHAKES 50                ///< Количество замеров рукопожатия
+
+using Clock = chrono::steady_clock;
+
+/**
+ * @brief Перцентиль замеров
+ * @param[in,out] samples Замеры (переупорядочиваются)
+ * @param[in] percentile Перцентиль (0-100)
+ * @return Значение перцентиля
+ */
+static double percentile(vector<double>& samples, double percentile)
+{
+    size_t rank = min(samples.size() - 1, size_t(percentile / 100 * samples.size()));
+    nth_element(samples.begin(), samples.begin() + rank, samples.end());
+    return samples[rank];
+}
+
+/**
+ * @brief Создание временного файла
+ * @param[in] content Содержимое файла
+ * @return Путь к файлу
+ * @throw system_error при ошибках записи
+ */
+static string tempFile(const string& content)
+{
+    char path[] = "/tmp/benchXXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1)
+        throw system_error(errno, generic_category());
+    bool ok = write(fd, content.data(), content.size()) == (ssize_t) content.size();
+    close(fd);
+    if (!ok)
+        throw system_error(EIO, generic_category());
+    return path;
+}
+
+/**
+ * @brief Создание двоичного входного файла задания
+ * @param[in] count Количество векторов
+ * @param[in] size Размер каждого вектора
+ * @return Путь к файлу в формате протокола
+ * @details Элементы - псевдослучайные числа с постоянным начальным
+ * значением, поэтому задания одинаковы от запуска к запуску
+ */
+static string jobFile(uint32_t count, uint32_t size)
+{
+    mt19937_64 random(count * 31 + size);
+    uniform_real_distribution<double> value(-1000, 1000);
+    string data(reinterpret_cast<const char*>(&count), sizeof(count));
+    vector<double> elements(size);
+    for (uint32_t i = 0; i < count; i++) {
+        for (double& x : elements)
+            x = value(random);
+        data.append(reinterpret_cast<const char*>(&size), sizeof(size));
+        data.append(reinterpret_cast<const char*>(elements.data()), size * sizeof(double));
+    }
+    return tempFile(data);
+}
+
+/**
+ * @brief Замер рукопожатий
+ * @param[in] p Параметры подключения к локальному серверу
+ * @details Время от подключения до подтверждения аутентификации
+ */
+static void benchHandshake(const Params& p)
+{
+    vector<double> samples;
+    for (int i = 0; i < BENCH_HANDSHAKES; i++) {
+        Clock::time_point start = Clock::now();
+        Session session(&p, BENCH_LOGIN, BENCH_PASSWORD);
+        chrono::duration<double, micro> elapsed = Clock::now() - start;
+        samples.push_back(elapsed.count());
+    }
+    printf("Рукопожатие, мкс: p50 %.1f, p99 %.1f, наибольшее %.1f\n\n",
+           percentile(samples, 50), percentile(samples, 99), *max_element(samples.begin(), samples.end()));
+}
+
+/**
+ * @brief Замер одной точки набора
+ * @param[in] base Параметры подключения к локальному серверу
+ * @param[in] count Количество векторов
+ * @param[in] size Размер каждого вектора
+ * @details Файловое задание выполняется, как из командной строки (с
+ * открытием сессий), и даёт скорость. Задержка вектора - время от
+ * submit до готовности результата при Window векторах в полёте на сессию
+ */
+static void benchPoint(const Params& base, uint32_t count, uint32_t size)
+{
+    Params p = base;
+    p.inFileName = jobFile(count, size);
+    p.inFileResult = tempFile("");
+    p.Binary = true;
+    double bytes = sizeof(uint32_t) + double(count) * (sizeof(uint32_t) + size * sizeof(double)); ///< Объём задания
+
+    // Сводка клиента о задании не смешивается с таблицей
+    streambuf* console = cout.rdbuf(nullptr);
+    Clock::time_point start = Clock::now();
+    try {
+        Client client(&p);
+        client.run(&p);
+    } catch (...) {
+        cout.rdbuf(console);
+        throw;
+    }
+    chrono::duration<double> elapsed = Clock::now() - start;
+    cout.rdbuf(console);
+    unlink(p.inFileName.c_str());
+    unlink(p.inFileResult.c_str());
+
+    vector<double> vect(size, 1.0);
+    vector<double> samples;
+    {
+        Client client(&p);
+        client.submit(vect).get();
+        uint32_t total = min<uint32_t>(count, BENCH_LATENCY_SAMPLES);
+        size_t depth = size_t(p.Window) * p.Connections; ///< Векторов в полёте
+        deque<pair<future<double>, Clock::time_point>> flight;
+        for (uint32_t sent = 0; samples.size() < total;) {
+            while (sent < total && flight.size() < depth) {
+                flight.emplace_back(client.submit(vect), Clock::now());
+                sent++;
+            }
+            flight.front().first.get();
+            chrono::duration<double, micro> latency = Clock::now() - flight.front().second;
+            samples.push_back(latency.count());
+            flight.pop_front();
+        }
+    }
+    printf("%10u %8u %12.0f %10.1f %10.1f %10.1f %10.1f\n", count, size, count / elapsed.count(),
+           bytes / elapsed.count() / 1e6, percentile(samples, 50), percentile(samples, 99), percentile(samples, 99.9));
+}
+
+/**
+ * @brief Замер производительности клиента на локальном сервере
+ * @param[in] argc Количество аргументов командной строки
+ * @param[in] argv Массив аргументов: количество соединений и окно (необязательно)
+ * @return 0 при успешном выполнении, 1 при ошибке
+ * @details Клиент работает с локальным сервером через loopback на наборе
+ * заданий разного количества и размера векторов. Для каждого задания
+ * выводятся векторы в секунду, мегабайты в секунду и перцентили
+ * задержки вектора
+ */
+int main(int argc, const char** argv)
+{
+    if (argc > 3) {
+        cout << "Usage: " << argv[0] << " [connections] [window]" << endl;
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    try {
+        LocalServer server(BENCH_LOGIN, BENCH_PASSWORD);
+        Params p;
+        p.inFileData = tempFile(BENCH_LOGIN "\n" BENCH_PASSWORD "\n");
+        p.Address = "127.0.0.1";
+        p.Port = server.port();
+        p.Connections = argc > 1 ? max(1, atoi(argv[1])) : 1;
+        p.Window = argc > 2 ? max(1, atoi(argv[2])) : 64;
+        printf("Соединений %u, окно %u\n", p.Connections, p.Window);
+        benchHandshake(p);
+
+        printf("  векторов   размер   векторов/с       МБ/с    p50 мкс    p99 мкс  p99.9 мкс\n");
+        for (uint32_t count : {1000u, 10000u, 100000u})
+            for (uint32_t size : {1u, 64u, 1024u})
+                if (uint64_t(count) * size <= BENCH_MAX_ELEMENTS)
+                    benchPoint(p, count, size);
+        unlink(p.inFileData.c_str());
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
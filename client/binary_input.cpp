@@ -0,0 +1,111 @@
+#include "binary_input.h"
+#include "parser.h"
+#include <cstring>
+#include <vector>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @brief Конструктор
+ * @param[in] path Путь к двоичному файлу
+ * @throw system_error если файл не удаётся открыть или в нём нет заголовка
+ */
+BinaryInput::BinaryInput(const string& path)
+{
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        throw system_error(errno, generic_category());
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        int err = errno;
+        close(fd);
+        throw system_error(err, generic_category());
+    }
+    length = st.st_size;
+    if (length < sizeof(num_vect)) {
+        close(fd);
+        throw system_error(EINVAL, generic_category());
+    }
+    void* map = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        int err = errno;
+        close(fd);
+        throw system_error(err, generic_category());
+    }
+    data = static_cast<const char*>(map);
+    memcpy(&num_vect, data, sizeof(num_vect));
+    remaining = num_vect;
+    pos = sizeof(num_vect);
+}
+
+/**
+ * @brief Деструктор: освобождает отображение и закрывает файл
+ */
+BinaryInput::~BinaryInput()
+{
+    if (data != nullptr)
+        munmap(const_cast<char*>(data), length);
+    if (fd != -1)
+        close(fd);
+}
+
+/**
+ * @brief Переход к следующему кадру
+ * @param[out] offset Смещение кадра (его заголовка с размером) в файле
+ * @param[out] len Длина кадра вместе с заголовком в байтах
+ * @return false если все кадры пройдены
+ * @throw system_error(EINVAL) если кадр выходит за конец файла
+ */
+bool BinaryInput::nextFrame(size_t& offset, size_t& len)
+{
+    if (remaining == 0)
+        return false;
+    uint32_t size_vect; ///< Размер вектора из заголовка кадра
+    if (length - pos < sizeof(size_vect))
+        throw system_error(EINVAL, generic_category());
+    memcpy(&size_vect, data + pos, sizeof(size_vect));
+    size_t frame = sizeof(size_vect) + size_t(size_vect) * sizeof(double);
+    if (length - pos < frame)
+        throw system_error(EINVAL, generic_category());
+    offset = pos;
+    len = frame;
+    pos += frame;
+    remaining--;
+    return true;
+}
+
+/**
+ * @brief Преобразование текстового файла с векторами в двоичный формат
+ * @param[in] textPath Путь к текстовому файлу
+ * @param[in] binPath Путь к создаваемому двоичному файлу
+ * @throw system_error при ошибках чтения, формата или записи
+ */
+void convertToBinary(const string& textPath, const string& binPath)
+{
+    VectorParser parser(textPath);
+    ofstream out(binPath, ios::binary | ios::trunc);
+    if (!out.is_open())
+        throw system_error(errno, generic_category());
+
+    uint32_t num_vect = parser.readCount(); ///< Количество векторов
+    out.write(reinterpret_cast<const char*>(&num_vect), sizeof(num_vect));
+
+    // Элементы переносятся частями, чтобы не держать в памяти большие векторы
+    vector<double> chunk(SENDFILE_CHUNK / sizeof(double)); ///< Буфер элементов
+    for (uint32_t i = 0; i < num_vect; i++) {
+        uint32_t size_vect = parser.readSize(); ///< Размер текущего вектора
+        out.write(reinterpret_cast<const char*>(&size_vect), sizeof(size_vect));
+        for (uint32_t done = 0; done < size_vect;) {
+            size_t n = min<size_t>(chunk.size(), size_vect - done);
+            parser.readElements(chunk.data(), n);
+            out.write(reinterpret_cast<const char*>(chunk.data()), n * sizeof(double));
+            done += n;
+        }
+    }
+    out.close();
+    if (out.fail())
+        throw system_error(EIO, generic_category());
+}
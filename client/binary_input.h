@@ -0,0 +1,94 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include "errno.h"
+using namespace std;
+
+#define SENDFILE_CHUNK (1 << 20) ///< Объём файла, после накопления которого диапазон отправляется без ожидания
+
+/**
+ * @class BinaryInput
+ * @brief Входной файл в двоичном формате протокола
+ * @details Файл устроен так же, как поток к серверу: uint32 количество
+ * векторов, затем для каждого вектора uint32 размер и элементы double
+ * (порядок байт машины клиента). Поэтому любой диапазон файла от начала
+ * до конца кадра можно передать в сокет напрямую через sendfile.
+ * Файл отображается в память только для чтения заголовков кадров.
+ */
+class BinaryInput {
+private:
+    int fd = -1;                ///< Дескриптор входного файла
+    const char* data = nullptr; ///< Отображённое в память содержимое файла
+    size_t length = 0;          ///< Размер файла в байтах
+    size_t pos = 0;             ///< Смещение следующего кадра
+    uint32_t num_vect = 0;      ///< Количество векторов
+    uint32_t remaining = 0;     ///< Количество ещё не пройденных кадров
+
+public:
+    /**
+     * @brief Конструктор
+     * @param[in] path Путь к двоичному файлу
+     * @throw system_error если файл не удаётся открыть или в нём нет заголовка
+     */
+    explicit BinaryInput(const string& path);
+
+    /**
+     * @brief Деструктор: освобождает отображение и закрывает файл
+     */
+    ~BinaryInput();
+
+    BinaryInput(const BinaryInput&) = delete;
+    BinaryInput& operator=(const BinaryInput&) = delete;
+
+    /**
+     * @brief Количество векторов из заголовка файла
+     * @return Количество векторов
+     */
+    uint32_t count() const {
+        return num_vect;
+    };
+
+    /**
+     * @brief Дескриптор файла для sendfile
+     * @return Дескриптор открытого файла
+     */
+    int descriptor() const {
+        return fd;
+    };
+
+    /**
+     * @brief Доступ к содержимому файла
+     * @param[in] offset Смещение в файле
+     * @return Указатель на байт файла с заданным смещением
+     */
+    const char* frame(size_t offset) const {
+        return data + offset;
+    };
+
+    /**
+     * @brief Смещение следующего кадра
+     * @return Смещение в файле
+     */
+    size_t position() const {
+        return pos;
+    };
+
+    /**
+     * @brief Переход к следующему кадру
+     * @param[out] offset Смещение кадра (его заголовка с размером) в файле
+     * @param[out] len Длина кадра вместе с заголовком в байтах
+     * @return false если все кадры пройдены
+     * @throw system_error(EINVAL) если кадр выходит за конец файла
+     */
+    bool nextFrame(size_t& offset, size_t& len);
+};
+
+/**
+ * @brief Преобразование текстового файла с векторами в двоичный формат
+ * @param[in] textPath Путь к текстовому файлу
+ * @param[in] binPath Путь к создаваемому двоичному файлу
+ * @throw system_error при ошибках чтения, формата или записи
+ */
+void convertToBinary(const string& textPath, const string& binPath);
@@ -0,0 +1,96 @@
+#include "buffer_pool.h"
+#include <cstdlib>
+#include <new>
+#include <algorithm>
+
+/**
+ * @brief Конструктор
+ * @param[in] count Начальная вместимость в элементах
+ */
+VectorBuffer::VectorBuffer(size_t count)
+{
+    reserve(count);
+}
+
+/**
+ * @brief Деструктор: освобождает память элементов
+ */
+VectorBuffer::~VectorBuffer()
+{
+    free(elements);
+}
+
+/**
+ * @brief Обеспечение вместимости не меньше count элементов
+ * @param[in] count Требуемая вместимость
+ * @throw bad_alloc при нехватке памяти
+ * @details Вместимость растёт как минимум вдвое, чтобы число перевыделений
+ * было логарифмическим от размера самого большого вектора
+ */
+void VectorBuffer::reserve(size_t count)
+{
+    if (count <= capacity && elements != nullptr)
+        return;
+    size_t grown = max(count, capacity * 2);
+    // aligned_alloc требует размер, кратный выравниванию
+    size_t bytes = (grown * sizeof(double) + BUFFER_ALIGNMENT - 1) / BUFFER_ALIGNMENT * BUFFER_ALIGNMENT;
+    double* memory = static_cast<double*>(aligned_alloc(BUFFER_ALIGNMENT, max<size_t>(bytes, BUFFER_ALIGNMENT)));
+    if (memory == nullptr)
+        throw bad_alloc();
+    free(elements);
+    elements = memory;
+    capacity = grown;
+}
+
+/**
+ * @brief Конструктор
+ * @param[in] count Количество буферов
+ * @param[in] capacity Начальная вместимость каждого буфера в элементах
+ */
+BufferPool::BufferPool(size_t count, size_t capacity)
+{
+    for (size_t i = 0; i < count; i++) {
+        buffers.emplace_back(new VectorBuffer(capacity));
+        freeList.push_back(buffers.back().get());
+    }
+}
+
+/**
+ * @brief Получение свободного буфера
+ * @return Буфер или nullptr, если пул закрыт
+ */
+VectorBuffer* BufferPool::acquire()
+{
+    unique_lock<mutex> lock(m);
+    cv.wait(lock, [this]{ return closed || !freeList.empty(); });
+    if (closed)
+        return nullptr;
+    VectorBuffer* buffer = freeList.back();
+    freeList.pop_back();
+    return buffer;
+}
+
+/**
+ * @brief Возврат буфера в пул
+ * @param[in] buffer Буфер, полученный от acquire
+ */
+void BufferPool::release(VectorBuffer* buffer)
+{
+    {
+        lock_guard<mutex> lock(m);
+        freeList.push_back(buffer);
+    }
+    cv.notify_one();
+}
+
+/**
+ * @brief Закрыть пул и разбудить ожидающие потоки
+ */
+void BufferPool::close()
+{
+    {
+        lock_guard<mutex> lock(m);
+        closed = true;
+    }
+    cv.notify_all();
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+using namespace std;
+
+#define BUFFER_ALIGNMENT 64 ///< Выравнивание буферов (размер строки кэша)
+#define POOL_INITIAL_CAPACITY 4096 ///< Начальная вместимость буфера в элементах
+#define STREAM_CHUNK 65536 ///< Наибольшее количество элементов в одном буфере (часть большого вектора)
+
+/**
+ * @class VectorBuffer
+ * @brief Выровненный буфер элементов вектора многократного использования
+ * @details Память выделяется с выравниванием по строке кэша и только растёт:
+ * после того как буфер один раз вместил самый большой вектор задания,
+ * повторное использование не обращается к распределителю памяти.
+ * Вектор длиннее STREAM_CHUNK передаётся последовательностью буферов:
+ * первый из них отмечен frameStart, все несут полный размер frameSize.
+ */
+class VectorBuffer {
+private:
+    double* elements = nullptr; ///< Выровненная память элементов
+    size_t capacity = 0;        ///< Вместимость в элементах
+
+public:
+    uint32_t size = 0;          ///< Количество элементов в буфере
+    uint32_t frameSize = 0;     ///< Полный размер вектора, которому принадлежат элементы
+    bool frameStart = true;     ///< Буфер начинает вектор (перед ним отправляется размер)
+    uint32_t frameIndex = 0;    ///< Индекс вектора во входном файле (для трассировки)
+
+    /**
+     * @brief Конструктор
+     * @param[in] count Начальная вместимость в элементах
+     */
+    explicit VectorBuffer(size_t count);
+
+    /**
+     * @brief Деструктор: освобождает память элементов
+     */
+    ~VectorBuffer();
+
+    VectorBuffer(const VectorBuffer&) = delete;
+    VectorBuffer& operator=(const VectorBuffer&) = delete;
+
+    /**
+     * @brief Обеспечение вместимости не меньше count элементов
+     * @param[in] count Требуемая вместимость
+     * @throw bad_alloc при нехватке памяти
+     * @details При увеличении прежнее содержимое не сохраняется
+     */
+    void reserve(size_t count);
+
+    /**
+     * @brief Доступ к элементам
+     * @return Указатель на начало выровненной памяти
+     */
+    double* data() {
+        return elements;
+    };
+
+    /**
+     * @brief Текущая вместимость
+     * @return Вместимость в элементах
+     */
+    size_t reserved() const {
+        return capacity;
+    }
+};
+
+/**
+ * @class BufferPool
+ * @brief Пул буферов векторов для конвейера разбора и отправки
+ * @details Разборщик забирает свободный буфер, заполняет его и передаёт на
+ * отправку; после отправки буфер возвращается в пул. Количество буферов
+ * фиксировано, поэтому потребление памяти ограничено глубиной конвейера,
+ * а не количеством векторов. Пустой пул приостанавливает разборщик.
+ */
+class BufferPool {
+private:
+    vector<unique_ptr<VectorBuffer>> buffers; ///< Все буферы пула (владение)
+    vector<VectorBuffer*> freeList;           ///< Свободные буферы
+    mutex m;                                  ///< Мьютекс для защиты списка свободных
+    condition_variable cv;                    ///< Ожидание свободного буфера
+    bool closed = false;                      ///< Признак закрытия пула
+
+public:
+    /**
+     * @brief Конструктор
+     * @param[in] count Количество буферов
+     * @param[in] capacity Начальная вместимость каждого буфера в элементах
+     */
+    BufferPool(size_t count, size_t capacity = POOL_INITIAL_CAPACITY);
+
+    /**
+     * @brief Получение свободного буфера
+     * @details Блокирует поток, пока все буферы заняты
+     * @return Буфер или nullptr, если пул закрыт
+     */
+    VectorBuffer* acquire();
+
+    /**
+     * @brief Возврат буфера в пул
+     * @param[in] buffer Буфер, полученный от acquire
+     */
+    void release(VectorBuffer* buffer);
+
+    /**
+     * @brief Закрыть пул и разбудить ожидающие потоки
+     * @details Используется при аварийной остановке конвейера
+     */
+    void close();
+};
@@ -0,0 +1,83 @@
+#include "checkpoint.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cstdio>
+
+/**
+ * @brief Конструктор
+ * @param[in] path Путь к файлу контрольной точки
+ * @param[in] input Путь к входному файлу задания
+ * @param[in] total Количество векторов задания
+ * @param[in] binary Двоичный формат файла результатов
+ * @throw system_error если входной файл недоступен
+ */
+Checkpoint::Checkpoint(const string& path, const string& input, uint32_t total, bool binary)
+    : path(path), total(total), binary(binary)
+{
+    struct stat st;
+    if (stat(input.c_str(), &st) == -1)
+        throw system_error(errno, generic_category());
+    inputSize = st.st_size;
+    inputMtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+/**
+ * @brief Чтение контрольной точки
+ * @param[out] done Количество сохранённых результатов
+ * @param[out] bytes Длина начала файла результатов с этими результатами
+ * @return false если точки нет или она относится к другому заданию
+ */
+bool Checkpoint::load(uint32_t& done, uint64_t& bytes) const
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return false;
+    Record record; ///< Содержимое файла
+    ssize_t n = read(fd, &record, sizeof(record));
+    close(fd);
+    if (n != (ssize_t)sizeof(record) || record.magic != CHECKPOINT_MAGIC
+        || record.total != total || record.binary != binary || record.done > total
+        || record.inputSize != inputSize || record.inputMtime != inputMtime)
+        return false;
+    done = record.done;
+    bytes = record.bytes;
+    return true;
+}
+
+/**
+ * @brief Сохранение контрольной точки
+ * @param[in] done Количество сохранённых результатов
+ * @param[in] bytes Длина начала файла результатов с этими результатами
+ * @throw system_error при ошибках записи, EIO при неполной записи
+ */
+void Checkpoint::save(uint32_t done, uint64_t bytes)
+{
+    Record record = {CHECKPOINT_MAGIC, total, done, binary, bytes, inputSize, inputMtime};
+    string temp = path + ".tmp"; ///< Временный файл новой точки
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1)
+        throw system_error(errno, generic_category());
+    ssize_t n = write(fd, &record, sizeof(record));
+    if (n != (ssize_t)sizeof(record) || fdatasync(fd) == -1) {
+        // Неполная запись не устанавливает errno
+        int err = n >= 0 && n != (ssize_t)sizeof(record) ? EIO : errno;
+        close(fd);
+        unlink(temp.c_str());
+        throw system_error(err, generic_category());
+    }
+    close(fd);
+    if (rename(temp.c_str(), path.c_str()) == -1) {
+        int err = errno;
+        unlink(temp.c_str());
+        throw system_error(err, generic_category());
+    }
+}
+
+/**
+ * @brief Удаление контрольной точки после завершения задания
+ */
+void Checkpoint::remove()
+{
+    unlink(path.c_str());
+}
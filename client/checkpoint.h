@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include "errno.h"
+using namespace std;
+
+#define CHECKPOINT_MAGIC 0x54504B43   ///< Признак файла контрольной точки ("CKPT")
+#define CHECKPOINT_SUFFIX ".ckpt"     ///< Суффикс файла контрольной точки к имени файла результатов
+#define CHECKPOINT_INTERVAL 1000      ///< Период сохранения контрольной точки в миллисекундах
+#define CHECKPOINT_STEP 4096          ///< Количество результатов между проверками времени
+
+/**
+ * @class Checkpoint
+ * @brief Контрольная точка последовательной записи результатов
+ * @details Хранит количество результатов, записанных подряд с начала и
+ * сброшенных на диск, и длину начала файла результатов, которое их содержит.
+ * Запись заменяет файл целиком через временный файл и rename, поэтому после
+ * сбоя на диске остаётся либо прежняя, либо новая точка. Точка относится к
+ * заданию с тем же количеством векторов и тем же форматом результатов по
+ * тому же входному файлу: его размер и время изменения хранятся в точке,
+ * поэтому другой файл с тем же количеством векторов её не продолжит.
+ */
+class Checkpoint {
+private:
+    string path;     ///< Путь к файлу контрольной точки
+    uint32_t total;  ///< Количество векторов задания
+    bool binary;     ///< Двоичный формат файла результатов
+    uint64_t inputSize;  ///< Размер входного файла
+    int64_t inputMtime;  ///< Время изменения входного файла в наносекундах
+
+    /**
+     * @struct Record
+     * @brief Содержимое файла контрольной точки
+     */
+    struct Record {
+        uint32_t magic;   ///< Признак файла
+        uint32_t total;   ///< Количество векторов задания
+        uint32_t done;    ///< Количество сохранённых результатов
+        uint32_t binary;  ///< Двоичный формат файла результатов
+        uint64_t bytes;   ///< Длина начала файла результатов с сохранёнными результатами
+        uint64_t inputSize;  ///< Размер входного файла
+        int64_t inputMtime;  ///< Время изменения входного файла в наносекундах
+    };
+
+public:
+    /**
+     * @brief Конструктор
+     * @param[in] path Путь к файлу контрольной точки
+     * @param[in] input Путь к входному файлу задания
+     * @param[in] total Количество векторов задания
+     * @param[in] binary Двоичный формат файла результатов
+     * @throw system_error если входной файл недоступен
+     */
+    Checkpoint(const string& path, const string& input, uint32_t total, bool binary);
+
+    /**
+     * @brief Чтение контрольной точки
+     * @param[out] done Количество сохранённых результатов
+     * @param[out] bytes Длина начала файла результатов с этими результатами
+     * @return false если точки нет или она относится к другому заданию
+     */
+    bool load(uint32_t& done, uint64_t& bytes) const;
+
+    /**
+     * @brief Сохранение контрольной точки
+     * @param[in] done Количество сохранённых результатов
+     * @param[in] bytes Длина начала файла результатов с этими результатами
+     * @throw system_error при ошибках записи, EIO при неполной записи
+     */
+    void save(uint32_t done, uint64_t bytes);
+
+    /**
+     * @brief Удаление контрольной точки после завершения задания
+     */
+    void remove();
+};
@@ -0,0 +1,317 @@
+#include "client.h"
+#include <algorithm>
+
+/**
+ * @brief Конструктор: чтение учётных данных и открытие сессий
+ * @param[in] p Указатель на параметры соединения
+ * @details Сессии открываются параллельно в фоне (при Epoll - циклом
+ * событий первого задания), для каждой запускается поток приёма результатов
+ */
+Client::Client(const Params* p) : p(*p), sessions(max<uint32_t>(1, p->Connections))
+{
+    Session::readCredentials(p->inFileData, login, pass);
+
+    // При Epoll сессии открывает цикл событий первого задания, без потока на сессию
+    if (!p->Epoll)
+        Connection::openSessions(&this->p, login, pass, sessions, ready);
+
+    for (size_t i = 0; i < sessions.size(); i++) {
+        slots.emplace_back(new Slot);
+        slots.back()->window = WindowController(p->Window, p->AdaptiveWindow, p->Timeout);
+    }
+    for (size_t i = 0; i < slots.size(); i++)
+        slots[i]->receiver = thread(&Client::receive, this, i);
+}
+
+/**
+ * @brief Деструктор: ожидание ответов на отправленные векторы и закрытие сессий
+ * @details Кэш результатов файловых заданий сохраняется; ошибка записи
+ * не прерывает уничтожение клиента
+ */
+Client::~Client()
+{
+    try {
+        saveCache(true);
+    } catch (const system_error&) {
+    }
+    for (unique_ptr<Slot>& slot : slots) {
+        {
+            unique_lock<mutex> lock(slot->m);
+            slot->cv.wait(lock, [&]{ return slot->pending.empty(); });
+            slot->closing = true;
+        }
+        slot->cv.notify_all();
+        slot->receiver.join();
+    }
+}
+
+/**
+ * @brief Приём результатов сессии (поток сессии)
+ * @param[in] index Номер сессии
+ * @details Сессия читается, только пока есть векторы без ответа; после
+ * ошибки чтения сессия помечается сломанной, и обещания, оставшиеся или
+ * добавленные до её замены, получают исключение без чтения из сокета.
+ * Чтение ограничено сроком ответа на самый старый вектор без ответа
+ */
+void Client::receive(size_t index)
+{
+    Slot& slot = *slots[index];
+    double results[BUFFER_SIZE]; ///< Результаты обработки от сервера
+    unique_lock<mutex> lock(slot.m);
+    for (;;) {
+        slot.cv.wait(lock, [&]{ return slot.closing || !slot.pending.empty(); });
+        if (slot.pending.empty())
+            return;
+
+        exception_ptr error; ///< Ошибка чтения из сессии
+        size_t count = 0;    ///< Количество принятых результатов
+        if (slot.broken) {
+            error = make_exception_ptr(system_error(ECONNRESET, generic_category()));
+        } else {
+            size_t want = min<size_t>(BUFFER_SIZE, slot.pending.size());
+            Session* session = sessions[index].get(); ///< Сессия, по которой отправлены векторы
+            session->reader.setDeadline(slot.window.deadline());
+            lock.unlock();
+            try {
+                count = session->reader.readResults(results, want);
+            } catch (...) {
+                error = current_exception();
+            }
+            lock.lock();
+        }
+
+        // Обещания выполняются без удержания мьютекса
+        deque<promise<double>> done; ///< Обещания принятых результатов
+        if (error) {
+            slot.broken = true;
+            swap(done, slot.pending);
+            slot.window = WindowController(p.Window, p.AdaptiveWindow, p.Timeout);
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                done.push_back(std::move(slot.pending.front()));
+                slot.pending.pop_front();
+            }
+            slot.window.onReceive(count);
+        }
+        slot.inFlight.fetch_sub(done.size(), memory_order_relaxed);
+        lock.unlock();
+        slot.cv.notify_all();
+        for (size_t i = 0; i < done.size(); i++) {
+            if (error)
+                done[i].set_exception(error);
+            else
+                done[i].set_value(results[i]);
+        }
+        lock.lock();
+    }
+}
+
+/**
+ * @brief Выбор сессии с наименьшим количеством векторов без ответа
+ * @return Номер сессии
+ */
+size_t Client::pick() const
+{
+    size_t best = 0; ///< Номер наименее загруженной сессии
+    for (size_t i = 1; i < slots.size(); i++)
+        if (slots[i]->inFlight.load(memory_order_relaxed) < slots[best]->inFlight.load(memory_order_relaxed))
+            best = i;
+    return best;
+}
+
+/**
+ * @brief Отправка векторов одним заданием
+ * @param[in] index Номер сессии
+ * @param[in] batch Векторы задания
+ * @return Результаты векторов в порядке batch
+ * @details Запрос дожидается открытия сессии, начатого конструктором;
+ * сломанная, закрытая после файлового задания или закрытая сервером
+ * простаивающая сессия открывается заново. Обещание вектора ставится в очередь до отправки его
+ * кадра, поэтому очередь совпадает с порядком ответов сервера. При
+ * заполненном окне накопленные кадры отправляются до ожидания ответов.
+ * Задержка вектора для окна отсчитывается от сброса его кадра в сокет.
+ * Ошибка записи разрывает сессию, и поток приёма передаёт её в обещания.
+ * Вектор длиннее UINT32_MAX элементов не помещается в кадр: его обещание
+ * сразу получает EMSGSIZE, и он не входит в количество векторов задания.
+ */
+vector<future<double>> Client::send(size_t index, span<const span<const double>> batch)
+{
+    Slot& slot = *slots[index];
+    vector<future<double>> futures; ///< Результаты векторов
+    futures.reserve(batch.size());
+    lock_guard<mutex> sending(slot.send);
+
+    Session* session; ///< Сессия для отправки
+    exception_ptr error; ///< Ошибка открытия сессии
+    if (ready.size() > index && ready[index].valid()) {
+        try {
+            ready[index].get();
+        } catch (...) {
+            error = current_exception();
+        }
+    }
+    if (!error) {
+        unique_lock<mutex> lock(slot.m);
+        // Простаивающую сессию (например, после файлового задания) сервер
+        // мог закрыть; пока очередь пуста, поток приёма сокет не читает
+        if (slot.broken || !sessions[index] || (slot.pending.empty() && !sessions[index]->alive())) {
+            // Очередь пуста или содержит только обещания сломанной сессии,
+            // поток приёма её не читает
+            slot.cv.wait(lock, [&]{ return slot.pending.empty(); });
+            slot.broken = false;
+            lock.unlock();
+            sessions[index].reset();
+            try {
+                sessions[index].reset(new Session(&p, login, pass));
+            } catch (...) {
+                error = current_exception();
+            }
+        }
+    }
+    if (error) {
+        for (size_t i = 0; i < batch.size(); i++) {
+            promise<double> result;
+            result.set_exception(error);
+            futures.push_back(result.get_future());
+        }
+        return futures;
+    }
+    session = sessions[index].get();
+
+    try {
+        // Размер кадра - uint32_t: более длинный вектор не отправляется,
+        // иначе усечённый размер рассинхронизирует сессию
+        uint32_t count = count_if(batch.begin(), batch.end(), [](span<const double> vect) {
+            return vect.size() <= UINT32_MAX;
+        }); ///< Количество векторов задания
+        if (count > 0)
+            session->writer.write(&count, sizeof(count));
+        for (span<const double> vect : batch) {
+            promise<double> result; ///< Результат вектора
+            futures.push_back(result.get_future());
+            if (vect.size() > UINT32_MAX) {
+                result.set_exception(make_exception_ptr(system_error(EMSGSIZE, generic_category())));
+                continue;
+            }
+            {
+                unique_lock<mutex> lock(slot.m);
+                if (slot.pending.size() >= slot.window.limit()) {
+                    lock.unlock();
+                    session->writer.flush();
+                    lock.lock();
+                    slot.window.onFlush();
+                    slot.cv.wait(lock, [&]{ return slot.pending.size() < slot.window.limit() || slot.broken; });
+                }
+                if (slot.broken) {
+                    result.set_exception(make_exception_ptr(system_error(ECONNRESET, generic_category())));
+                    continue;
+                }
+                slot.pending.push_back(std::move(result));
+                slot.inFlight.fetch_add(1, memory_order_relaxed);
+                slot.window.onSend();
+            }
+            slot.cv.notify_all();
+            session->writer.writeFrame(vect.size(), vect.data());
+        }
+        if (count > 0) {
+            session->writer.flush();
+            lock_guard<mutex> lock(slot.m);
+            slot.window.onFlush();
+        }
+    } catch (...) {
+        exception_ptr error = current_exception();
+        session->abort();
+        {
+            lock_guard<mutex> lock(slot.m);
+            slot.broken = true;
+        }
+        slot.cv.notify_all();
+        while (futures.size() < batch.size()) {
+            promise<double> result;
+            result.set_exception(error);
+            futures.push_back(result.get_future());
+        }
+    }
+    return futures;
+}
+
+/**
+ * @brief Асинхронная обработка вектора
+ * @param[in] vect Элементы вектора
+ * @return Результат сервера; при ошибке соединения future содержит system_error,
+ * для вектора длиннее UINT32_MAX элементов - system_error EMSGSIZE
+ */
+future<double> Client::submit(span<const double> vect)
+{
+    return std::move(send(pick(), span<const span<const double>>(&vect, 1))[0]);
+}
+
+/**
+ * @brief Асинхронная обработка набора векторов одним заданием
+ * @param[in] batch Векторы
+ * @return Результаты в порядке векторов batch
+ */
+vector<future<double>> Client::submitBatch(span<const span<const double>> batch)
+{
+    return send(pick(), batch);
+}
+
+/**
+ * @brief Выполнение файлового задания по сессиям клиента
+ * @param[in] job Указатель на параметры задания
+ * @return 0 при успешном выполнении
+ * @throw system_error при ошибках сетевого взаимодействия или формата файла
+ * @details Запись во все сессии блокируется, поэтому асинхронные запросы
+ * ждут окончания задания, а потоки приёма не читают сессии, пока не
+ * получены ответы на все ранее отправленные векторы. Общий кэш результатов
+ * не перечитывается и не сохраняется целиком после каждого задания
+ */
+int Client::run(const Params* job)
+{
+    vector<unique_lock<mutex>> sending; ///< Блокировки записи во все сессии
+    for (size_t i = 0; i < slots.size(); i++) {
+        sending.emplace_back(slots[i]->send);
+        unique_lock<mutex> lock(slots[i]->m);
+        slots[i]->cv.wait(lock, [&]{ return slots[i]->pending.empty(); });
+        if (slots[i]->broken) {
+            slots[i]->broken = false;
+            sessions[i].reset();
+        }
+    }
+
+    ResultCache* shared = nullptr; ///< Кэш, общий для заданий клиента
+    if (!job->CacheFile.empty() && job->CacheFile == p.CacheFile) {
+        if (!cache) {
+            cache.reset(new ResultCache(p.CacheFile, p.CacheSize));
+            cacheSaved = chrono::steady_clock::now();
+        }
+        shared = cache.get();
+    }
+    int result; ///< Код завершения задания
+    try {
+        result = Connection::runJob(job, login, pass, sessions, ready, shared);
+    } catch (...) {
+        try {
+            saveCache(false);
+        } catch (const system_error&) {
+        }
+        throw;
+    }
+    saveCache(false);
+    return result;
+}
+
+/**
+ * @brief Сохранение кэша результатов файловых заданий
+ * @param[in] force Сохранить, даже если CACHE_SAVE_INTERVAL с прошлого
+ * сохранения ещё не прошёл
+ * @throw system_error при ошибках записи файла кэша
+ */
+void Client::saveCache(bool force)
+{
+    auto now = chrono::steady_clock::now();
+    if (!cache || (!force && now - cacheSaved < chrono::milliseconds(CACHE_SAVE_INTERVAL)))
+        return;
+    cacheSaved = now;
+    cache->save();
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include "errno.h"
+#include "interface.h"
+#include "session.h"
+#include "connection.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+/**
+ * @class Client
+ * @brief Клиент для встраивания: асинхронная обработка векторов по открытым сессиям
+ * @details Конструктор читает учётные данные и начинает открывать в фоне
+ * Connections аутентифицированных сессий, деструктор дожидается ответов на все
+ * отправленные векторы и закрывает сессии. Вектор отправляется сразу
+ * при вызове submit (данные можно освободить после возврата), результат
+ * возвращается через future. Каждая сессия принимает результаты своим
+ * потоком, поэтому запросы разных потоков передаются по сессиям конвейером,
+ * не более Window векторов без ответа на сессию. Файловые задания
+ * (как в командной строке) выполняются методом run по тем же сессиям.
+ */
+class Client {
+private:
+    /**
+     * @struct Slot
+     * @brief Состояние одной сессии для асинхронных запросов
+     */
+    struct Slot {
+        mutex send;                   ///< Порядок записи в сессию и её замены
+        mutex m;                      ///< Мьютекс для защиты очереди ожидания
+        condition_variable cv;        ///< Появление запросов, ответов, закрытие
+        deque<promise<double>> pending; ///< Обещания в порядке отправки векторов
+        atomic<uint32_t> inFlight{0}; ///< Количество векторов без ответа
+        WindowController window;      ///< Размер окна сессии
+        bool broken = false;          ///< Сессия разорвана, нужна новая
+        bool closing = false;         ///< Признак завершения работы клиента
+        thread receiver;              ///< Поток приёма результатов
+    };
+
+    Params p;                             ///< Параметры соединения
+    string login;                         ///< Логин пользователя
+    string pass;                          ///< Пароль пользователя
+    vector<unique_ptr<Session>> sessions; ///< Сессии с сервером
+    vector<future<void>> ready;           ///< Ожидание сессий, открываемых в фоне
+    vector<unique_ptr<Slot>> slots;       ///< Состояние сессий для асинхронных запросов
+    unique_ptr<ResultCache> cache;        ///< Кэш результатов файловых заданий или nullptr
+    chrono::steady_clock::time_point cacheSaved; ///< Время последнего сохранения кэша
+
+    /**
+     * @brief Приём результатов сессии (поток сессии)
+     * @param[in] index Номер сессии
+     * @details При ошибке соединения все ожидающие обещания сессии получают
+     * исключение, а сессия открывается заново при следующем запросе
+     */
+    void receive(size_t index);
+
+    /**
+     * @brief Выбор сессии с наименьшим количеством векторов без ответа
+     * @return Номер сессии
+     */
+    size_t pick() const;
+
+    /**
+     * @brief Отправка векторов одним заданием
+     * @param[in] index Номер сессии
+     * @param[in] batch Векторы задания
+     * @return Результаты векторов в порядке batch
+     */
+    vector<future<double>> send(size_t index, span<const span<const double>> batch);
+
+    /**
+     * @brief Сохранение кэша результатов файловых заданий
+     * @param[in] force Сохранить, даже если CACHE_SAVE_INTERVAL с прошлого
+     * сохранения ещё не прошёл
+     * @throw system_error при ошибках записи файла кэша
+     */
+    void saveCache(bool force);
+
+public:
+    /**
+     * @brief Конструктор: чтение учётных данных и открытие сессий
+     * @param[in] p Указатель на параметры соединения (адрес, порт,
+     * файл учётных данных, Connections, Window)
+     * @details Конструктор не ждёт рукопожатий: первый запрос к сессии
+     * дожидается её открытия, а файловое задание открывает входной файл,
+     * пока сессии аутентифицируются. Ошибка подключения передаётся в
+     * результаты запросов или выбрасывается из run.
+     */
+    explicit Client(const Params* p);
+
+    /**
+     * @brief Деструктор: ожидание ответов на отправленные векторы и закрытие сессий
+     */
+    ~Client();
+
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    /**
+     * @brief Асинхронная обработка вектора
+     * @param[in] vect Элементы вектора
+     * @return Результат сервера; при ошибке соединения future содержит system_error,
+     * для вектора длиннее UINT32_MAX элементов - system_error EMSGSIZE
+     */
+    future<double> submit(span<const double> vect);
+
+    /**
+     * @brief Асинхронная обработка набора векторов одним заданием
+     * @param[in] batch Векторы
+     * @return Результаты в порядке векторов batch
+     * @details Набор отправляется по одной сессии и дешевле такого же
+     * количества отдельных вызовов submit
+     */
+    vector<future<double>> submitBatch(span<const span<const double>> batch);
+
+    /**
+     * @brief Выполнение файлового задания по сессиям клиента
+     * @param[in] job Указатель на параметры задания (входной файл, файл
+     * результатов и параметры обработки)
+     * @return 0 при успешном выполнении
+     * @throw system_error при ошибках сетевого взаимодействия или формата файла
+     * @details Дожидается ответов на асинхронные запросы и не принимает
+     * новые до окончания задания. Кэш результатов с CacheFile клиента
+     * общий для заданий: файл читается при первом задании, а сохраняется
+     * не чаще раза в CACHE_SAVE_INTERVAL и при уничтожении клиента
+     */
+    int run(const Params* job);
+};
@@ -1,5 +1,30 @@
 #include "connection.h"
 
+/**
+ * @brief Проверка, что ошибка вызвана разрывом или недоступностью соединения
+ * @param[in] code Код ошибки
+ * @return true если задание можно продолжить по новому соединению
+ */
+static bool disconnected(const error_code& code)
+{
+    if (code.category() != generic_category())
+        return false;
+    switch (code.value()) {
+    case ECONNRESET:
+    case ECONNREFUSED:
+    case ECONNABORTED:
+    case EPIPE:
+    case ETIMEDOUT:
+    case ENETDOWN:
+    case ENETUNREACH:
+    case EHOSTDOWN:
+    case EHOSTUNREACH:
+        return true;
+    default:
+        return false;
+    }
+}
+
 /**
  * @brief Установка соединения и обмен данными с сервером
  * @param[in] p Указатель на параметры соединения
@@ -9,114 +34,943 @@
  * - Создание TCP-сокета и установка соединения
  * - Аутентификацию по протоколу с получением соли от сервера
  * - Передачу векторов данных и получение результатов вычислений
+ *
+ * Отправка и приём работают конвейером: результаты принимаются отдельным
+ * потоком, а число векторов без ответа ограничено параметром Window.
+ * При Connections > 1 задание распределяется по нескольким соединениям.
  */
 int Connection::conn(const Params* p){
-    // Создание сокета
-    int s = socket(AF_INET, SOCK_STREAM, 0);
-    if (s == -1) 
-        throw system_error(errno, generic_category()); 
-    
-    // Настройка локального адреса
-    unique_ptr <sockaddr_in> self_addr(new sockaddr_in); 
-    self_addr->sin_family = AF_INET; ///< Семейство адресов IPv4
-    self_addr->sin_port = 0; ///< Автоматический выбор порта
-    self_addr->sin_addr.s_addr = 0; ///< Автоматический выбор адреса
-
-    // Настройка адреса сервера
-    unique_ptr <sockaddr_in> serv_addr(new sockaddr_in);
-    serv_addr->sin_family = AF_INET; ///< Семейство адресов IPv4
-    serv_addr->sin_port = htons(p->Port); ///< Порт сервера в сетевом порядке байт
-    serv_addr->sin_addr.s_addr = inet_addr(p->Address.c_str()); ///< IP-адрес сервера
-
-    // Установка соединения с сервером
-    if (connect(s, (sockaddr*) serv_addr.get(), sizeof(sockaddr_in)) == -1)
-        throw system_error(errno, generic_category()); 
-    
     // Аутентификация - чтение учетных данных из файла
-    ifstream fileData(p->inFileData);
     string login; ///< Логин пользователя
-    fileData >> login;
-    
-    // Отправка логина на сервер
-    send(s, login.c_str(), login.length(), 0);
-    
-    // Чтение пароля из файла
-    string pass; ///< Пароль пользователя
-    fileData >> pass;
-
-    // Получение SALT (соли) от сервера
-    char buffer[BUFFER_SIZE]; ///< Буфер для приема данных
-    ssize_t received_bytes = recv(s, buffer, BUFFER_SIZE - 1, 0);
-    if (received_bytes == -1) 
-        throw system_error(errno, generic_category());
-    buffer[received_bytes] = '\0';
-
-    // Отправка MD5 хеша (соль + пароль)
-    string message = buffer; ///< Соль, полученная от сервера
-    message = auth(message, pass); ///< Вычисление MD5 хеша
-    send(s, message.c_str(), message.length(), 0);
-    
-    // Прием подтверждения аутентификации от сервера (ОК)
-    received_bytes = recv(s, buffer, BUFFER_SIZE - 1, 0);
-    if (received_bytes == -1) 
-        throw system_error(errno, generic_category());
-    buffer[received_bytes] = '\0';
-
-    // Обработка данных векторов
-    ifstream file(p->inFileName);
-    if(!file.is_open()){
-        throw system_error(errno, generic_category());
-        return 1;
-    }
-
-    // Отправка количества векторов
-    uint32_t num_vect; ///< Количество векторов для обработки
-    file >> num_vect;
-    if (send(s, &num_vect, sizeof(num_vect), 0) == -1) {
-        close(s);
-        throw system_error(errno, generic_category());
-    }
-
-    // Открытие файла для записи результатов
-    ofstream fileResult(p->inFileResult);
-
-    // Обработка каждого вектора
+    string pass;  ///< Пароль пользователя
+    Session::readCredentials(p->inFileData, login, pass);
+
+    vector<unique_ptr<Session>> sessions(max<uint32_t>(1, p->Connections)); ///< Сессии с сервером
+    vector<future<void>> ready; ///< Ожидание открытия сессий
+    return runJob(p, login, pass, sessions, ready);
+}
+
+/**
+ * @brief Выполнение задания по уже открытым сессиям
+ * @param[in] p Указатель на параметры задания
+ * @param[in] login Логин пользователя
+ * @param[in] pass Пароль пользователя
+ * @param[in,out] sessions Сессии с сервером (по одной на соединение)
+ * @param[in,out] ready Ожидание сессий, открытие которых уже начато
+ * @return 0 при успешном выполнении
+ * @throw system_error при ошибках сетевого взаимодействия или формата файла
+ * @details Отсутствующие и закрытые сервером сессии открываются заново,
+ * остальные используются без повторной аутентификации. Подключение и
+ * рукопожатие идут в фоне, пока задание открывает входной файл и разбирает
+ * первые векторы, так что отправка начинается сразу после ответа сервера.
+ * После ошибки состояние обмена неизвестно, поэтому все сессии закрываются.
+ * Если причина - разрыв соединения, задание продолжается по новым сессиям
+ * с первого вектора без результата: не более Retries раз, с паузой от
+ * RETRY_BACKOFF_MIN, удваивающейся до RETRY_BACKOFF_MAX. Перед выходом с
+ * ошибкой сохраняется контрольная точка для продолжения с флагом Resume.
+ * Кэш результатов сохраняется и после успеха, и перед выходом с ошибкой.
+ * Сессия, не отвечающая дольше Timeout, прерывается с ETIMEDOUT и тоже
+ * считается разорванной. Расхождение результата сервера с локальным при
+ * VerifySample завершает задание ошибкой EBADMSG после записи результатов.
+ */
+int Connection::runJob(const Params* p, const string& login, const string& pass, vector<unique_ptr<Session>>& sessions, vector<future<void>>& ready, ResultCache* cache){
+    Job job;                              ///< Состояние задания между попытками
+    job.cache = cache;
+    uint32_t retries = 0;                 ///< Количество выполненных повторных подключений
+    uint32_t backoff = RETRY_BACKOFF_MIN; ///< Пауза перед следующим подключением
+    for (;;) {
+        try {
+            if (p->Epoll) {
+                // Подключения ведёт цикл событий; начатые ранее открытия
+                // дожидаются, неудачные сессии он откроет заново
+                for (future<void>& r : ready)
+                    if (r.valid()) {
+                        try {
+                            r.get();
+                        } catch (const system_error&) {
+                        }
+                    }
+                ready.clear();
+                ready.resize(sessions.size());
+            } else {
+                openSessions(p, login, pass, sessions, ready);
+            }
+            openJob(p, job);
+            // С кэшем количество отправляемых векторов заранее неизвестно,
+            // поэтому они передаются пакетами
+            if (sessions.size() > 1 || p->Epoll || job.cache)
+                runSharded(p, login, pass, sessions, ready, job);
+            else
+                runSingle(p, sessions[0], ready[0], job);
+            job.results->close();
+            if (job.checkpoint)
+                job.checkpoint->remove();
+            saveCache(job);
+            printStats(p, job);
+            break;
+        } catch (const system_error& e) {
+            // Незавершённые открытия дожидаются до закрытия сессий
+            ready.clear();
+            for (unique_ptr<Session>& session : sessions)
+                session.reset();
+            if (e.code().value() == ETIMEDOUT)
+                job.stats.timeouts++;
+            if (!job.results || retries >= p->Retries || !disconnected(e.code())) {
+                printStats(p, job);
+                if (job.results) {
+                    try {
+                        job.results->checkpointNow();
+                        saveCache(job);
+                    } catch (const system_error&) {
+                    }
+                }
+                throw;
+            }
+        } catch (...) {
+            ready.clear();
+            for (unique_ptr<Session>& session : sessions)
+                session.reset();
+            throw;
+        }
+        job.first = job.results->resume();
+        this_thread::sleep_for(chrono::milliseconds(backoff));
+        backoff = min<uint32_t>(backoff * 2, RETRY_BACKOFF_MAX);
+        retries++;
+    }
+    // Результаты записаны, но сервер ответил неверно хотя бы на один вектор выборки
+    if (job.verifier && job.verifier->mismatches() > 0)
+        throw system_error(EBADMSG, generic_category());
+    return 0;
+}
+
+/**
+ * @brief Вычисление результатов задания локально, без сервера
+ * @param[in] p Указатель на параметры задания
+ * @return 0 при успешном выполнении
+ * @throw system_error при ошибках формата файла или записи результатов
+ * @details Каждый вектор суммируется ядром LocalSum в режиме LocalSum:
+ * текстовый - по мере разбора частями STREAM_CHUNK, двоичный - прямо из
+ * отображённого в память файла. Перед выходом с ошибкой сохраняется
+ * контрольная точка, как при работе с сервером
+ */
+int Connection::offline(const Params* p){
+    Job job; ///< Задание
+    openJob(p, job);
+    SumMode mode = p->LocalSum == "fast" ? SumMode::Fast : SumMode::Compensated; ///< Режим суммирования
+    vector<double> chunk; ///< Часть разбираемого вектора
+    try {
+        for (uint32_t index = job.first; index < job.num_vect; index++){
+            LocalSum sum(mode);
+            if (job.input) {
+                size_t offset, len; ///< Положение кадра в двоичном файле
+                if (!job.input->nextFrame(offset, len))
+                    throw system_error(EINVAL, generic_category());
+                sum.add(job.input->frame(offset + sizeof(uint32_t)), (len - sizeof(uint32_t)) / sizeof(double));
+            } else {
+                uint32_t size_vect = job.parser->readSize(); ///< Размер текущего вектора
+                for (uint32_t done = 0; done < size_vect;) {
+                    uint32_t n = min<uint32_t>(size_vect - done, STREAM_CHUNK);
+                    chunk.resize(n);
+                    job.parser->readElements(chunk.data(), n);
+                    sum.add(chunk.data(), n);
+                    done += n;
+                }
+            }
+            job.results->put(index, sum.value());
+        }
+        job.results->close();
+    } catch (const system_error&) {
+        try {
+            job.results->checkpointNow();
+        } catch (const system_error&) {
+        }
+        throw;
+    }
+    if (job.checkpoint)
+        job.checkpoint->remove();
+    return 0;
+}
+
+/**
+ * @brief Фоновое открытие недостающих сессий
+ * @param[in] p Указатель на параметры соединения
+ * @param[in] login Логин пользователя
+ * @param[in] pass Пароль пользователя
+ * @param[in,out] sessions Сессии с сервером (по одной на соединение)
+ * @param[in,out] ready Ожидание открытия сессий (недействительное для
+ * открытых сессий); дополняется для сессий, открытие которых начато
+ * @details Каждая сессия открывается своим потоком. До успешного get()
+ * ожидания сессия недоступна, ошибка подключения или аутентификации
+ * передаётся через get().
+ */
+void Connection::openSessions(const Params* p, const string& login, const string& pass, vector<unique_ptr<Session>>& sessions, vector<future<void>>& ready){
+    ready.resize(sessions.size());
+    for (size_t i = 0; i < sessions.size(); i++) {
+        if (ready[i].valid() || (sessions[i] && sessions[i]->alive()))
+            continue;
+        sessions[i].reset();
+        ready[i] = async(launch::async, [p, &login, &pass, &session = sessions[i]]{
+            session.reset(new Session(p, login, pass));
+        });
+    }
+}
+
+/**
+ * @brief Обработка задания по одному соединению
+ * @param[in] p Указатель на параметры задания
+ * @param[in] session Сессия с сервером
+ * @param[in] ready Ожидание открытия сессии (недействительное, если она уже открыта)
+ * @param[in,out] job Задание, векторы отправляются начиная с job.first
+ * @throw system_error при ошибках сетевого взаимодействия или формата файла
+ */
+void Connection::runSingle(const Params* p, unique_ptr<Session>& session, future<void>& ready, Job& job){
+    Tracer::threadName("send");
+    uint32_t num_vect = job.num_vect - job.first; ///< Количество векторов для обработки
+
+    // Обработка данных векторов: текстовый файл отображается в память и
+    // разбирается параллельно, двоичный передаётся в сокет без разбора.
+    // Разбор ведётся отдельным потоком и опережает отправку не более чем на
+    // PIPELINE_DEPTH векторов. Векторы разбираются в буферы пула: один
+    // заполняется разборщиком, один отправляется, остальные ждут в очереди.
+    // Разбор начинается до окончания рукопожатия
+    BufferPool pool(p->Binary ? 0 : PIPELINE_DEPTH + 2); ///< Пул буферов векторов
+    SpscRing<VectorBuffer*> ring(PIPELINE_DEPTH);        ///< Очередь разобранных векторов
+    exception_ptr parseError; ///< Ошибка потока разбора
+    thread producer;
+    if (!p->Binary)
+        producer = thread([&]{
+            Tracer::threadName("parse");
+            try {
+                parseVectors(*job.parser, job.first, num_vect, pool, ring, job.verifier.get());
+            } catch (...) {
+                parseError = current_exception();
+            }
+            ring.close();
+        });
+
+    // Приём результатов ведётся отдельным потоком, пока текущий поток
+    // продолжает отправку векторов в пределах окна
+    InFlightWindow window(p->Window, p->AdaptiveWindow, p->Timeout);
+    exception_ptr receiveError; ///< Ошибка потока приёма результатов
+    exception_ptr sendError;    ///< Ошибка подключения или отправки
+    thread receiver;
+    try {
+        if (ready.valid())
+            ready.get();
+        SocketWriter& writer = session->writer; ///< Буферизованный вывод в сокет
+        SocketReader& reader = session->reader; ///< Буферизованный ввод из сокета
+        receiver = thread([&]{
+            Tracer::threadName("receive");
+            try {
+                receiveResults(reader, job.first, num_vect, window, *job.results);
+            } catch (...) {
+                receiveError = current_exception();
+                window.close();
+            }
+        });
+
+        // Количество векторов уходит в сокет вместе с первым кадром (в
+        // двоичном файле оно записано перед кадрами и передаётся из файла,
+        // если задание начинается с первого вектора)
+        bool header = p->Binary && job.first == 0; ///< Количество векторов передаётся из файла
+        if (!header)
+            writer.write(&num_vect, sizeof(num_vect));
+        if (p->Binary)
+            sendBinary(writer, *job.input, job.first, window, header, job.verifier.get());
+        else
+            sendVectors(writer, ring, pool, window);
+    } catch (...) {
+        sendError = current_exception();
+    }
+
+    // Остановка разбора, если отправка прервалась раньше
+    ring.close();
+    pool.close();
+    if (producer.joinable())
+        producer.join();
+    if (sendError || parseError) {
+        window.close();
+        if (session)
+            session->abort();
+    }
+    if (receiver.joinable())
+        receiver.join();
+    if (sendError)
+        rethrow_exception(sendError);
+    if (parseError)
+        rethrow_exception(parseError);
+    if (receiveError)
+        rethrow_exception(receiveError);
+}
+
+/**
+ * @brief Разбор векторов из файла в очередь на отправку (поток-производитель)
+ * @param[in] parser Разборщик файла с векторами данных
+ * @param[in] first Индекс первого вектора
+ * @param[in] num_vect Количество векторов
+ * @param[in] pool Пул буферов векторов
+ * @param[out] ring Очередь разобранных векторов
+ * @param[in] verifier Выборочная проверка результатов или nullptr
+ * @throw system_error при ошибках формата файла
+ * @details Заполненная очередь или пустой пул приостанавливают разбор,
+ * поэтому память ограничена глубиной конвейера и размером части
+ * STREAM_CHUNK независимо от размера файла и размера отдельного вектора
+ */
+void Connection::parseVectors(VectorParser& parser, uint32_t first, uint32_t num_vect, BufferPool& pool, SpscRing<VectorBuffer*>& ring, SampleVerifier* verifier){
     for (uint32_t i = 0; i < num_vect; i++){
-        uint32_t size_vect; ///< Размер текущего вектора
-        file >> size_vect;
-        if (send(s, &size_vect, sizeof(size_vect), 0) == -1) {
-            close(s);
-            throw system_error(errno, generic_category());
+        TraceSpan parse(TraceKind::Parse, first + i); ///< Разбор вектора вместе с передачей его частей в очередь
+        uint32_t size_vect = parser.readSize(); ///< Размер текущего вектора
+
+        // Вектор разбирается частями не более STREAM_CHUNK элементов, каждая
+        // часть уходит на отправку сразу после разбора
+        uint32_t rest = size_vect; ///< Количество ещё не разобранных элементов
+        bool start = true;         ///< Признак первой части вектора
+        do {
+            // nullptr или false - отправка прервана, пул и очередь закрыты
+            VectorBuffer* buffer = pool.acquire(); ///< Буфер для части вектора
+            if (buffer == nullptr)
+                return;
+            uint32_t n = min<uint32_t>(rest, STREAM_CHUNK);
+            buffer->reserve(n);
+            buffer->size = n;
+            buffer->frameSize = size_vect;
+            buffer->frameStart = start;
+            buffer->frameIndex = first + i;
+            parser.readElements(buffer->data(), n);
+            if (verifier != nullptr)
+                verifier->expect(first + i, buffer->data(), n, start);
+            TraceSpan enqueue(TraceKind::Enqueue, first + i); ///< Ожидание места в очереди на отправку
+            if (!ring.push(buffer)) {
+                pool.release(buffer);
+                return;
+            }
+            rest -= n;
+            start = false;
+        } while (rest > 0);
+    }
+}
+
+/**
+ * @brief Отправка векторов из очереди на сервер
+ * @param[in] writer Буферизованный вывод в сокет
+ * @param[in] ring Очередь разобранных векторов
+ * @param[in] pool Пул, в который возвращаются отправленные буферы
+ * @param[in] window Окно векторов в полёте
+ * @throw system_error при ошибках сетевого взаимодействия
+ * @details Перед отправкой каждого вектора занимает место в окне, поэтому
+ * одновременно на сервере находится не более заданного числа векторов.
+ * Кадры накапливаются в буфере и сбрасываются в сокет только на границе
+ * кадра: перед ожиданием разборщика или свободного места в окне и после
+ * последнего вектора. Большой вектор приходит несколькими буферами и
+ * отправляется по мере разбора, не собираясь в памяти целиком. Буфер
+ * возвращается в пул сразу после записи: SocketWriter к этому моменту
+ * либо скопировал, либо отправил его.
+ */
+void Connection::sendVectors(SocketWriter& writer, SpscRing<VectorBuffer*>& ring, BufferPool& pool, InFlightWindow& window){
+    VectorBuffer* buffer; ///< Буфер, извлечённый из очереди
+    // Сброс отмечается в окне: задержка векторов отсчитывается от него
+    auto flush = [&]{
+        writer.flush();
+        window.flushed();
+    };
+    for (;;){
+        // Очередь пуста: накопленные кадры отправляются до ожидания разборщика
+        if (!ring.tryPop(buffer)) {
+            flush();
+            if (!ring.pop(buffer))
+                break;
         }
 
-        vector<double> num_vectt; ///< Вектор числовых значений
-        for (uint32_t i = 0; i < size_vect; i++)
+        TraceSpan send(TraceKind::Send, buffer->frameIndex); ///< Ожидание окна и запись вектора или его части
+        if (buffer->frameStart) {
+            // Ожидание свободного места в окне (false - приёмник завершился с ошибкой);
+            // накопленные кадры отправляются до ожидания, иначе сервер их не получит
+            if (!window.tryAcquire()) {
+                flush();
+                if (!window.acquire()) {
+                    pool.release(buffer);
+                    return;
+                }
+            }
+            // Размер вектора предшествует его первой части
+            writer.write(&buffer->frameSize, sizeof(buffer->frameSize));
+        }
+
+        // Отправка элементов (всего вектора или его части) на сервер
+        writer.write(buffer->data(), buffer->size * sizeof(double));
+        pool.release(buffer);
+    }
+    flush();
+}
+
+/**
+ * @brief Отправка векторов из двоичного файла через sendfile
+ * @param[in] writer Буферизованный вывод в сокет
+ * @param[in] input Двоичный входной файл
+ * @param[in] first Индекс первого вектора
+ * @param[in] window Окно векторов в полёте
+ * @param[in] header Передать из файла и заголовок с количеством векторов
+ * @param[in] verifier Выборочная проверка результатов или nullptr
+ * @throw system_error при ошибках сетевого взаимодействия или формата файла
+ * @details Кадры в файле идут подряд, поэтому векторы, получившие место в
+ * окне, образуют непрерывный диапазон файла. Диапазон передаётся одним
+ * sendfile перед ожиданием места в окне, по достижении SENDFILE_CHUNK байт
+ * и после последнего кадра. Первый диапазон включает заголовок с количеством.
+ */
+void Connection::sendBinary(SocketWriter& writer, BinaryInput& input, uint32_t first, InFlightWindow& window, bool header, SampleVerifier* verifier){
+    size_t start = header ? 0 : input.position(); ///< Начало ещё не отправленного диапазона
+    size_t end = header ? sizeof(uint32_t) : start; ///< Конец диапазона, готового к отправке
+    size_t offset, len;               ///< Положение очередного кадра в файле
+    uint32_t frames = 0;              ///< Кадров в диапазоне, готовом к отправке
+
+    // Диапазон отправляется одним интервалом трассировки на все его векторы
+    auto flush = [&]{
+        TraceSpan send(TraceKind::Send, first, frames);
+        writer.sendFile(input.descriptor(), start, end - start);
+        window.flushed();
+        start = end;
+        first += frames;
+        frames = 0;
+    };
+    while (input.nextFrame(offset, len)){
+        if (verifier != nullptr)
+            verifier->expect(first + frames, input.frame(offset + sizeof(uint32_t)), (len - sizeof(uint32_t)) / sizeof(double));
+        if (!window.tryAcquire()) {
+            flush();
+            if (!window.acquire())
+                return;
+        }
+        end = offset + len;
+        frames++;
+        if (end - start >= SENDFILE_CHUNK)
+            flush();
+    }
+    flush();
+}
+
+/**
+ * @brief Приём результатов от сервера в порядке отправки векторов
+ * @param[in] reader Буферизованный ввод из сокета
+ * @param[in] first Индекс вектора первого результата
+ * @param[in] num_vect Количество ожидаемых результатов
+ * @param[in] window Окно векторов в полёте
+ * @param[out] out Запись результатов
+ * @throw system_error при ошибках сетевого взаимодействия, разрыве соединения или записи в файл
+ * @details За одно чтение из сокета разбирается до BUFFER_SIZE результатов.
+ * Чтение начинается, только когда в окне есть вектор, поэтому медленный
+ * разбор входного файла не исчерпывает тайм-аут. Чтение ограничено сроком
+ * ответа на самый старый вектор в полёте, а не паузой между байтами
+ */
+void Connection::receiveResults(SocketReader& reader, uint32_t first, uint32_t num_vect, InFlightWindow& window, OrderedResults& out){
+    double results[BUFFER_SIZE]; ///< Результаты обработки от сервера
+    uint32_t received = 0;       ///< Количество принятых результатов
+    while (received < num_vect){
+        if (!window.waitInFlight())
+            return;
+        size_t count; ///< Количество прочитанных результатов
         {
-            double v; ///< Элемент вектора
-            file >> v;
-            num_vectt.push_back(v);
+            TraceSpan result(TraceKind::Result, first + received, 0); ///< Ожидание первого байта и чтение
+            reader.setDeadline(window.deadline());
+            count = reader.readResults(results, min<size_t>(BUFFER_SIZE, num_vect - received));
+            result.range(first + received, count);
         }
-        
-        // Отправка элементов вектора на сервер
-        for (double num : num_vectt) {
-            double network_num = num; ///< Число в сетевом порядке байт
-            if (send(s, &network_num, sizeof(network_num), 0) == -1) {
-                close(s);
-                throw system_error(errno, generic_category());
+        window.release(count);
+        TraceSpan write(TraceKind::Write, first + received, count);
+        for (size_t i = 0; i < count; i++)
+            out.put(first + received + i, results[i]);
+        received += count;
+    }
+}
+
+/**
+ * @brief Открытие входного файла
+ * @param[in] p Указатель на параметры соединения
+ * @param[out] parser Разборщик текстового файла (если файл текстовый)
+ * @param[out] input Двоичный файл (если задан флаг Binary)
+ * @return Количество векторов в файле
+ * @throw system_error если файл не удаётся открыть или прочитать заголовок
+ */
+uint32_t Connection::openInput(const Params* p, unique_ptr<VectorParser>& parser, unique_ptr<BinaryInput>& input){
+    if (p->Binary) {
+        input.reset(new BinaryInput(p->inFileName));
+        return input->count();
+    }
+    parser.reset(new VectorParser(p->inFileName));
+    return parser->readCount();
+}
+
+/**
+ * @brief Пропуск векторов в начале входного файла
+ * @param[in] parser Разборщик текстового файла или nullptr
+ * @param[in] input Двоичный файл или nullptr
+ * @param[in] count Количество пропускаемых векторов
+ * @throw system_error при ошибках формата файла
+ */
+void Connection::skipVectors(VectorParser* parser, BinaryInput* input, uint32_t count){
+    for (uint32_t i = 0; i < count; i++){
+        if (input != nullptr) {
+            size_t offset, len; ///< Положение кадра в двоичном файле
+            if (!input->nextFrame(offset, len))
+                throw system_error(EINVAL, generic_category());
+        } else {
+            parser->skipElements(parser->readSize());
+        }
+    }
+}
+
+/**
+ * @brief Открытие файла результатов
+ * @param[in] p Указатель на параметры соединения
+ * @param[in] job Задание с открытым входным файлом
+ * @throw system_error если файл не удаётся создать или продолжить
+ * @details С флагом Resume последовательная запись продолжается с
+ * контрольной точки, если она относится к этому заданию, а индексированный
+ * файл открывается заново и задание продолжается с первой пустой ячейки.
+ * Иначе файл создаётся заново. Если задан CacheFile, читается кэш результатов.
+ * С VerifySample результаты выборки векторов сравниваются с локальными.
+ */
+void Connection::openResults(const Params* p, Job& job){
+    if (p->IndexedResult) {
+        if (p->Resume && access(p->inFileResult.c_str(), F_OK) == 0) {
+            job.file.reset(new IndexedResultFile(p->inFileResult));
+            if (job.file->count() != job.num_vect)
+                throw system_error(EINVAL, generic_category());
+            job.first = job.file->firstMissing();
+        } else {
+            job.file.reset(new IndexedResultFile(p->inFileResult, job.num_vect));
+        }
+    } else {
+        job.checkpoint.reset(new Checkpoint(p->inFileResult + CHECKPOINT_SUFFIX, p->inFileName, job.num_vect, p->BinaryResult));
+        uint32_t done = 0;  ///< Количество результатов по контрольной точке
+        uint64_t bytes = 0; ///< Длина файла результатов по контрольной точке
+        if (!p->Resume || !job.checkpoint->load(done, bytes))
+            done = 0, bytes = 0;
+        job.sink.reset(new ResultSink(p->inFileResult, p->BinaryResult, p->Echo, job.num_vect, bytes, done));
+        job.first = done;
+    }
+    if (!p->CacheFile.empty() && job.cache == nullptr) {
+        job.ownCache.reset(new ResultCache(p->CacheFile, p->CacheSize));
+        job.cache = job.ownCache.get();
+    }
+    if (p->VerifySample > 0 && !p->Offline)
+        job.verifier.reset(new SampleVerifier(p->VerifySample, p->VerifyTolerance, p->LocalSum == "fast" ? SumMode::Fast : SumMode::Compensated));
+    job.results.reset(new OrderedResults(job.sink.get(), job.file.get(), job.checkpoint.get(), job.first, job.cache, job.verifier.get()));
+}
+
+/**
+ * @brief Сохранение кэша результатов задания и вывод его статистики
+ * @param[in,out] job Задание
+ * @throw system_error при ошибках записи файла кэша
+ */
+void Connection::saveCache(Job& job){
+    if (job.cache == nullptr)
+        return;
+    if (job.ownCache)
+        job.cache->save();
+    cerr << "Кэш результатов: попаданий " << job.cache->hits() << ", промахов " << job.cache->misses()
+         << ", повторов в задании " << job.results->repeats() << ", вытеснено " << job.cache->evictions() << endl;
+}
+
+/**
+ * @brief Вывод счётчиков дублирования запросов, тайм-аутов и проверки результатов
+ * @param[in] p Указатель на параметры задания
+ * @param[in] job Задание
+ */
+void Connection::printStats(const Params* p, const Job& job){
+    if (p->HedgePercentile > 0)
+        cerr << "Дублирование запросов: отправлено копий " << job.stats.issued << ", успешных "
+             << job.stats.won << ", отменено " << job.stats.cancelled << endl;
+    if (p->Timeout > 0)
+        cerr << "Тайм-аутов ответа сервера: " << job.stats.timeouts << endl;
+    if (job.verifier)
+        cerr << "Проверка результатов: проверено " << job.verifier->checkedCount() << ", расхождений "
+             << job.verifier->mismatches() << endl;
+}
+
+/**
+ * @brief Открытие файлов задания перед очередной попыткой
+ * @param[in] p Указатель на параметры задания
+ * @param[in,out] job Задание
+ * @throw system_error если файлы не удаётся открыть
+ * @details Входной файл открывается заново при каждой попытке и
+ * пропускается до первого вектора без результата; файл результатов
+ * открывается один раз
+ */
+void Connection::openJob(const Params* p, Job& job){
+    job.parser.reset();
+    job.input.reset();
+    job.num_vect = openInput(p, job.parser, job.input);
+    if (!job.results)
+        openResults(p, job);
+    skipVectors(job.parser.get(), job.input.get(), job.first);
+}
+
+/**
+ * @brief Обработка задания по нескольким соединениям
+ * @param[in] p Указатель на параметры соединения
+ * @param[in] login Логин пользователя
+ * @param[in] pass Пароль пользователя
+ * @param[in,out] sessions Сессии с сервером (по одной на соединение)
+ * @param[in] ready Ожидание открытия сессий
+ * @param[in,out] job Задание, векторы отправляются начиная с job.first
+ * @throw system_error при ошибках сетевого взаимодействия или формата файла
+ * @details Недостающие сессии открываются в фоне, пока открывается входной
+ * файл (при Epoll - неблокирующими подключениями в цикле событий). Отдельный
+ * поток разбирает входной файл в пакеты последовательных векторов, каждая
+ * сессия забирает пакеты из своей очереди или перехватывает чужие.
+ * Протокол требует сообщать количество векторов до их отправки, поэтому
+ * каждый пакет передаётся по сессии отдельным заданием. Векторы длиннее
+ * SplitSize делятся на части, результаты частей складываются на клиенте.
+ * Результаты записываются в порядке входного файла. С HedgePercentile
+ * пакет, обрабатываемый дольше этого перцентиля, повторяется по другому
+ * соединению, и в запись идёт первый ответ.
+ */
+void Connection::runSharded(const Params* p, const string& login, const string& pass, vector<unique_ptr<Session>>& sessions, vector<future<void>>& ready, Job& job){
+    uint32_t num_vect = job.num_vect - job.first; ///< Количество векторов для обработки
+    OrderedResults& results = *job.results;       ///< Восстановление порядка результатов
+
+    // Размер пакета: несколько пакетов на соединение для выравнивания нагрузки;
+    // при дублировании пакеты мельче, чтобы копия повторяла меньше работы
+    uint32_t workers = sessions.size(); ///< Количество соединений
+    uint32_t perConnection = p->HedgePercentile > 0 ? HEDGE_BATCHES_PER_CONNECTION : SHARD_BATCHES_PER_CONNECTION;
+    uint32_t batchVectors = max<uint32_t>(1, (num_vect + workers * perConnection - 1) / (workers * perConnection));
+    ShardQueues queues(workers, workers * SHARD_QUEUED_BATCHES);
+    unique_ptr<Hedger> hedger; ///< Дублирование опаздывающих пакетов
+    if (p->HedgePercentile > 0)
+        hedger.reset(new Hedger(queues, results, job.num_vect, p->HedgePercentile, job.stats));
+
+    exception_ptr parseError; ///< Ошибка потока разбора
+    thread producer([&]{
+        Tracer::threadName("batches");
+        try {
+            buildBatches(job.parser.get(), job.input.get(), job.first, job.num_vect, batchVectors, p->SplitSize, queues, job.cache, job.verifier.get(), results);
+            queues.finish();
+        } catch (...) {
+            parseError = current_exception();
+            queues.close();
+        }
+    });
+
+    // Каждое соединение обслуживается своим потоком (или все - одним
+    // циклом событий); ошибка одного соединения останавливает выдачу
+    // пакетов остальным
+    vector<exception_ptr> errors(workers); ///< Ошибки потоков соединений
+    vector<thread> threads;
+    if (p->Epoll) {
+        try {
+            EventEngine engine(p, login, pass, queues, results, hedger.get());
+            engine.run(sessions);
+        } catch (...) {
+            errors[0] = current_exception();
+            queues.close();
+        }
+    } else {
+        // При дублировании соединения не завершаются после разбора: пока
+        // есть ответы без результатов, могут появиться копии пакетов
+        if (hedger)
+            queues.hold(true);
+        for (uint32_t w = 0; w < workers; w++)
+            threads.emplace_back([&, w]{
+                Tracer::threadName("shard " + to_string(w) + " send");
+                try {
+                    if (ready[w].valid())
+                        ready[w].get();
+                    shardWorker(*sessions[w], w, queues, results, p->Window, p->AdaptiveWindow, p->Timeout, hedger.get());
+                } catch (...) {
+                    errors[w] = current_exception();
+                    queues.close();
+                }
+            });
+    }
+
+    // Наблюдатель дублирует опаздывающие пакеты; когда все результаты
+    // получены, он отпускает соединения и прерывает сессии, ждущие
+    // ответов, которые уже пришли по другим соединениям
+    atomic<bool> stop{false}; ///< Признак остановки наблюдателя
+    thread monitor;
+    if (hedger && !p->Epoll)
+        monitor = thread([&]{
+            while (!stop.load()) {
+                this_thread::sleep_for(chrono::milliseconds(HEDGE_CHECK_INTERVAL));
+                if (!hedger->complete()) {
+                    hedger->check();
+                    continue;
+                }
+                for (size_t w : hedger->busy())
+                    sessions[w]->abort();
+                queues.hold(false);
+                return;
+            }
+        });
+    for (thread& t : threads)
+        t.join();
+    stop = true;
+    if (monitor.joinable())
+        monitor.join();
+    queues.close();
+    producer.join();
+
+    // Все результаты получены: ошибки прерванных сессий не важны,
+    // такие сессии откроются заново перед следующим заданием
+    if (results.written() == job.num_vect)
+        return;
+    if (parseError)
+        rethrow_exception(parseError);
+    for (exception_ptr& e : errors)
+        if (e)
+            rethrow_exception(e);
+    throw system_error(EIO, generic_category());
+}
+
+/**
+ * @brief Разбор входного файла в пакеты векторов (поток-производитель)
+ * @param[in] parser Разборщик текстового файла или nullptr
+ * @param[in] input Двоичный файл или nullptr
+ * @param[in] first Индекс первого разбираемого вектора
+ * @param[in] num_vect Количество векторов во входном файле
+ * @param[in] batchVectors Наибольшее количество векторов в пакете
+ * @param[in] splitSize Наибольший размер вектора, передаваемого целиком (0 - без ограничения)
+ * @param[in] queues Очереди пакетов соединений
+ * @param[in] cache Кэш результатов или nullptr
+ * @param[in] verifier Выборочная проверка результатов или nullptr
+ * @param[out] results Запись результатов, найденных в кэше
+ * @throw system_error при ошибках формата файла или записи результатов
+ * @details Пакет закрывается по достижении batchVectors векторов или
+ * SHARD_BATCH_BYTES байт кадров. Вектор длиннее splitSize делится на части
+ * не более splitSize элементов; каждая часть уходит отдельным пакетом,
+ * поэтому части одного вектора обрабатываются разными соединениями параллельно.
+ * С кэшем кадр целого вектора ищется в нём по хешу: при попадании кадр
+ * убирается из пакета, а результат записывается сразу. Кадр, повторяющий
+ * уже отправленный и ещё не получивший результата, тоже убирается и
+ * получит его результат. Части векторов не кэшируются. Пустые пакеты
+ * серверу не отправляются.
+ */
+void Connection::buildBatches(VectorParser* parser, BinaryInput* input, uint32_t first, uint32_t num_vect, uint32_t batchVectors, uint32_t splitSize, ShardQueues& queues, ResultCache* cache, SampleVerifier* verifier, OrderedResults& results){
+    vector<double> chunk;     ///< Часть разбираемого вектора
+    Batch* batch = nullptr;   ///< Заполняемый пакет целых векторов
+    auto push = [&](Batch* ready){
+        TraceSpan enqueue(TraceKind::Enqueue, ready->first, ready->count); ///< Ожидание места в очередях
+        queues.push(ready);
+    };
+    for (uint32_t index = first; index < num_vect; index++){
+        TraceSpan parse(TraceKind::Parse, index); ///< Разбор вектора вместе с передачей пакетов в очередь
+        // Размер вектора; для двоичного файла также положение его элементов
+        uint32_t size_vect;              ///< Размер текущего вектора
+        const char* elements = nullptr;  ///< Элементы вектора в двоичном файле
+        if (input != nullptr) {
+            size_t offset, len; ///< Положение кадра в двоичном файле
+            if (!input->nextFrame(offset, len))
+                throw system_error(EINVAL, generic_category());
+            size_vect = (len - sizeof(size_vect)) / sizeof(double);
+            elements = input->frame(offset + sizeof(size_vect));
+        } else {
+            size_vect = parser->readSize();
+        }
+
+        if (splitSize > 0 && size_vect > splitSize) {
+            // Пакет целых векторов закрывается, чтобы сохранить порядок индексов
+            if (batch != nullptr) {
+                if (batch->count > 0)
+                    push(batch);
+                else
+                    queues.release(batch);
+                batch = nullptr;
             }
+            uint32_t parts = (size_vect + splitSize - 1) / splitSize; ///< Количество частей
+            for (uint32_t k = 0; k < parts; k++){
+                Batch* part = queues.acquire(); ///< Пакет с одной частью вектора
+                if (part == nullptr)
+                    return;
+                part->reset(index, parts);
+                uint32_t n = min(splitSize, size_vect - k * splitSize);
+                appendFrame(*part, n, parser, elements == nullptr ? nullptr : elements + size_t(k) * splitSize * sizeof(double), chunk);
+                if (verifier != nullptr)
+                    verifier->expect(index, part->frames.data() + sizeof(n), n, k == 0);
+                push(part);
+            }
+            continue;
         }
 
-        // Получение и запись результата от сервера
-        double result; ///< Результат обработки от сервера
-        ssize_t result_received = recv(s, &result, sizeof(result), 0);
-        if (result_received == sizeof(result)){
-            cout << "Результат от сервера: " << result << endl;
-            fileResult << result << endl;
-        }else if (result_received == -1){
-            close(s);
-            throw system_error(errno, generic_category());
+        if (batch == nullptr) {
+            batch = queues.acquire();
+            if (batch == nullptr)
+                return;
+            batch->reset(index, 1);
+        }
+        size_t start = batch->frames.size(); ///< Начало кадра вектора в пакете
+        appendFrame(*batch, size_vect, parser, elements, chunk);
+        if (verifier != nullptr)
+            verifier->expect(index, batch->frames.data() + start + sizeof(size_vect), size_vect);
+        if (cache != nullptr) {
+            ResultCache::Key key = ResultCache::key(batch->frames.data() + start, batch->frames.size() - start);
+            double result; ///< Результат из кэша
+            bool hit = cache->lookup(key, result); ///< Результат найден в кэше
+            if (hit || results.awaitRepeat(key, index)) {
+                batch->frames.resize(start);
+                batch->ends.pop_back();
+                batch->count--;
+                if (hit)
+                    results.put(index, result);
+                continue;
+            }
+            batch->keys.push_back(key);
+            batch->indices.push_back(index);
+        }
+        if (batch->count == batchVectors || batch->frames.size() >= SHARD_BATCH_BYTES) {
+            push(batch);
+            batch = nullptr;
         }
     }
-    close(s);
-    return 0;
-};
+    if (batch != nullptr) {
+        if (batch->count > 0)
+            push(batch);
+        else
+            queues.release(batch);
+    }
+}
+
+/**
+ * @brief Добавление кадра вектора в пакет
+ * @param[in,out] batch Заполняемый пакет
+ * @param[in] size_vect Количество элементов кадра
+ * @param[in] parser Разборщик текстового файла (если elements == nullptr)
+ * @param[in] elements Элементы в двоичном файле или nullptr
+ * @param[in] chunk Временный буфер для разбора текстовых элементов
+ * @throw system_error при ошибках формата файла
+ * @details Текстовые элементы разбираются частями по STREAM_CHUNK
+ */
+void Connection::appendFrame(Batch& batch, uint32_t size_vect, VectorParser* parser, const char* elements, vector<double>& chunk){
+    const char* header = reinterpret_cast<const char*>(&size_vect);
+    batch.frames.insert(batch.frames.end(), header, header + sizeof(size_vect));
+    if (elements != nullptr) {
+        batch.frames.insert(batch.frames.end(), elements, elements + size_t(size_vect) * sizeof(double));
+    } else {
+        for (uint32_t done = 0; done < size_vect;) {
+            uint32_t n = min<uint32_t>(size_vect - done, STREAM_CHUNK);
+            chunk.resize(n);
+            parser->readElements(chunk.data(), n);
+            const char* bytes = reinterpret_cast<const char*>(chunk.data());
+            batch.frames.insert(batch.frames.end(), bytes, bytes + n * sizeof(double));
+            done += n;
+        }
+    }
+    batch.ends.push_back(batch.frames.size());
+    batch.count++;
+}
+
+/**
+ * @brief Обслуживание одного соединения в режиме нескольких соединений
+ * @param[in] session Аутентифицированная сессия
+ * @param[in] worker Номер соединения
+ * @param[in] queues Очереди пакетов соединений
+ * @param[out] results Запись результатов в исходном порядке
+ * @param[in] window Максимальное количество векторов в полёте
+ * @param[in] adaptive Подбирать размер окна не больше window по задержке и скорости
+ * @param[in] timeout Срок ответа на вектор в миллисекундах (0 - без срока)
+ * @param[in] hedger Дублирование опаздывающих пакетов или nullptr
+ * @throw system_error при ошибках сетевого взаимодействия
+ * @details Каждый пакет отправляется заданием протокола (количество и кадры)
+ * и одновременно передаётся потоку приёма, который сопоставляет результаты
+ * с индексами векторов. Окно действует поверх границ пакетов, поэтому
+ * между заданиями нет простоя. Пакет, пара которого уже ответила,
+ * возвращается без отправки.
+ */
+void Connection::shardWorker(Session& session, size_t worker, ShardQueues& queues, OrderedResults& results, uint32_t window, bool adaptive, uint32_t timeout, Hedger* hedger){
+    InFlightWindow inFlight(window, adaptive, timeout); ///< Окно векторов в полёте
+    SpscRing<Batch*> sent(SHARD_QUEUED_BATCHES); ///< Пакеты, ожидающие результатов
+    exception_ptr receiveError; ///< Ошибка потока приёма результатов
+    thread receiver([&]{
+        Tracer::threadName("shard " + to_string(worker) + " receive");
+        try {
+            double received[BUFFER_SIZE]; ///< Результаты обработки от сервера
+            Batch* batch;
+            while (sent.pop(batch)){
+                for (uint32_t i = 0; i < batch->count;){
+                    if (!inFlight.waitInFlight())
+                        return;
+                    size_t count; ///< Количество прочитанных результатов
+                    {
+                        TraceSpan result(TraceKind::Result, batch->index(i), 0); ///< Ожидание первого байта и чтение
+                        session.reader.setDeadline(inFlight.deadline());
+                        count = session.reader.readResults(received, min<size_t>(BUFFER_SIZE, batch->count - i));
+                        result.range(batch->index(i), count);
+                    }
+                    inFlight.release(count);
+                    TraceSpan write(TraceKind::Write, batch->index(i), count);
+                    for (size_t k = 0; k < count; k++)
+                        results.putFrame(*batch, i + k, received[k]);
+                    i += count;
+                }
+                if (hedger != nullptr)
+                    hedger->finish(batch);
+                queues.release(batch);
+            }
+        } catch (...) {
+            receiveError = current_exception();
+            inFlight.close();
+            sent.close();
+        }
+    });
+
+    exception_ptr sendError; ///< Ошибка отправки
+    // Сброс отмечается в окне: задержка векторов отсчитывается от него
+    auto flush = [&]{
+        session.writer.flush();
+        inFlight.flushed();
+    };
+    try {
+        for (;;){
+            // Нет готовых пакетов: накопленные кадры отправляются до ожидания,
+            // иначе пакеты, занятые ими, не освободятся для разборщика
+            Batch* batch = queues.tryPop(worker); ///< Очередной пакет
+            if (batch == nullptr) {
+                flush();
+                batch = queues.pop(worker);
+                if (batch == nullptr)
+                    break;
+            }
+            if (hedger != nullptr && !hedger->start(batch, worker)) {
+                queues.release(batch);
+                continue;
+            }
+            // Пакет передаётся приёмнику до отправки его кадров; после записи
+            // последнего кадра пакет может быть возвращён и заполнен заново,
+            // поэтому границы кадров читаются только до этого момента.
+            // Перед ожиданием приёмника накопленные кадры отправляются,
+            // иначе результаты ожидаемых им пакетов не придут
+            if (!sent.tryPush(batch)) {
+                flush();
+                if (!sent.push(batch)) {
+                    queues.release(batch);
+                    break;
+                }
+            }
+            session.writer.write(&batch->count, sizeof(batch->count));
+            const char* frames = batch->frames.data();
+            size_t frameCount = batch->ends.size();
+            size_t start = 0;
+            for (size_t k = 0; k < frameCount; k++){
+                size_t end = batch->ends[k];
+                TraceSpan send(TraceKind::Send, batch->index(k)); ///< Ожидание окна и запись кадра
+                if (!inFlight.tryAcquire()) {
+                    flush();
+                    if (!inFlight.acquire())
+                        break;
+                }
+                session.writer.write(frames + start, end - start);
+                start = end;
+            }
+        }
+        flush();
+    } catch (...) {
+        sendError = current_exception();
+        inFlight.close();
+        session.abort();
+    }
+    sent.close();
+    receiver.join();
+    if (sendError)
+        rethrow_exception(sendError);
+    if (receiveError)
+        rethrow_exception(receiveError);
+}
@@ -2,6 +2,23 @@
 #include "errno.h"
 #include "crypto.h"
 #include "interface.h"
+#include "session.h"
+#include "window.h"
+#include "socket_writer.h"
+#include "socket_reader.h"
+#include "parser.h"
+#include "binary_input.h"
+#include "spsc_ring.h"
+#include "buffer_pool.h"
+#include "shard.h"
+#include "result_sink.h"
+#include "result_file.h"
+#include "event_engine.h"
+#include "checkpoint.h"
+#include "hedge.h"
+#include "trace.h"
+#include "local_sum.h"
+#include "sample_verifier.h"
 #include <system_error>
 #include <netinet/in.h>
 #include <memory>
@@ -12,9 +29,19 @@
 #include <unistd.h>
 #include <fstream>
 #include <vector>
+#include <thread>
+#include <future>
+#include <exception>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
 using namespace std;
 
-#define BUFFER_SIZE 1024 ///< Размер буфера для сетевого обмена
+#define BUFFER_SIZE 1024 ///< Размер буфера для сетевого обмена (результатов за одно чтение)
+#define PIPELINE_DEPTH 64 ///< Количество разобранных векторов, ожидающих отправки
+#define RETRY_BACKOFF_MIN 100  ///< Пауза перед первым повторным подключением в миллисекундах
+#define RETRY_BACKOFF_MAX 5000 ///< Наибольшая пауза между повторными подключениями в миллисекундах
 
 /**
  * @class Connection
@@ -24,8 +51,188 @@ using namespace std;
 class Connection{
 private:
     static string salt; ///< Соль для хеширования пароля (не используется в текущей реализации)
+
+    /**
+     * @struct Job
+     * @brief Состояние задания, сохраняемое между попытками
+     */
+    struct Job {
+        unique_ptr<VectorParser> parser;    ///< Разборщик текстового файла с векторами
+        unique_ptr<BinaryInput> input;      ///< Двоичный файл с векторами
+        uint32_t num_vect = 0;              ///< Количество векторов во входном файле
+        uint32_t first = 0;                 ///< Индекс первого вектора без результата
+        unique_ptr<ResultSink> sink;        ///< Последовательная запись результатов
+        unique_ptr<IndexedResultFile> file; ///< Индексированный файл результатов
+        unique_ptr<Checkpoint> checkpoint;  ///< Контрольная точка последовательной записи
+        unique_ptr<ResultCache> ownCache;   ///< Кэш результатов, открытый для задания
+        ResultCache* cache = nullptr;       ///< Кэш результатов (свой или общий для заданий) или nullptr
+        unique_ptr<SampleVerifier> verifier; ///< Выборочная проверка результатов или nullptr
+        unique_ptr<OrderedResults> results; ///< Запись результатов в порядке входного файла
+        HedgeStats stats;                   ///< Счётчики дублирования запросов и тайм-аутов
+    };
+
+    /**
+     * @brief Открытие входного файла
+     * @param[in] p Указатель на параметры соединения
+     * @param[out] parser Разборщик текстового файла (если файл текстовый)
+     * @param[out] input Двоичный файл (если задан флаг Binary)
+     * @return Количество векторов в файле
+     * @throw system_error если файл не удаётся открыть или прочитать заголовок
+     */
+    static uint32_t openInput(const Params* p, unique_ptr<VectorParser>& parser, unique_ptr<BinaryInput>& input);
+
+    /**
+     * @brief Пропуск векторов в начале входного файла
+     * @param[in] parser Разборщик текстового файла или nullptr
+     * @param[in] input Двоичный файл или nullptr
+     * @param[in] count Количество пропускаемых векторов
+     * @throw system_error при ошибках формата файла
+     */
+    static void skipVectors(VectorParser* parser, BinaryInput* input, uint32_t count);
+
+    /**
+     * @brief Открытие файла результатов
+     * @param[in] p Указатель на параметры соединения
+     * @param[in] job Задание с открытым входным файлом
+     * @throw system_error если файл не удаётся создать или продолжить
+     */
+    static void openResults(const Params* p, Job& job);
+
+    /**
+     * @brief Сохранение кэша результатов задания и вывод его статистики
+     * @param[in,out] job Задание
+     * @throw system_error при ошибках записи файла кэша
+     * @details Общий для заданий кэш не сохраняется: его сохраняет владелец
+     */
+    static void saveCache(Job& job);
+
+    /**
+     * @brief Вывод счётчиков дублирования запросов, тайм-аутов и проверки результатов
+     * @param[in] p Указатель на параметры задания
+     * @param[in] job Задание
+     */
+    static void printStats(const Params* p, const Job& job);
+
+    /**
+     * @brief Открытие файлов задания перед очередной попыткой
+     * @param[in] p Указатель на параметры задания
+     * @param[in,out] job Задание
+     * @throw system_error если файлы не удаётся открыть
+     */
+    static void openJob(const Params* p, Job& job);
+
+    /**
+     * @brief Обработка задания по одному соединению
+     * @param[in] p Указатель на параметры задания
+     * @param[in] session Сессия с сервером
+     * @param[in] ready Ожидание открытия сессии (недействительное, если она уже открыта)
+     * @param[in,out] job Задание, векторы отправляются начиная с job.first
+     * @throw system_error при ошибках сетевого взаимодействия или формата файла
+     */
+    static void runSingle(const Params* p, unique_ptr<Session>& session, future<void>& ready, Job& job);
+
+    /**
+     * @brief Обработка задания по нескольким соединениям
+     * @param[in] p Указатель на параметры соединения
+     * @param[in] login Логин пользователя
+     * @param[in] pass Пароль пользователя
+     * @param[in,out] sessions Сессии с сервером (по одной на соединение)
+     * @param[in] ready Ожидание открытия сессий
+     * @param[in,out] job Задание, векторы отправляются начиная с job.first
+     * @throw system_error при ошибках сетевого взаимодействия или формата файла
+     */
+    static void runSharded(const Params* p, const string& login, const string& pass, vector<unique_ptr<Session>>& sessions, vector<future<void>>& ready, Job& job);
+
+    /**
+     * @brief Разбор входного файла в пакеты векторов (поток-производитель)
+     * @param[in] parser Разборщик текстового файла или nullptr
+     * @param[in] input Двоичный файл или nullptr
+     * @param[in] first Индекс первого разбираемого вектора
+     * @param[in] num_vect Количество векторов во входном файле
+     * @param[in] batchVectors Наибольшее количество векторов в пакете
+     * @param[in] splitSize Наибольший размер вектора, передаваемого целиком (0 - без ограничения)
+     * @param[in] queues Очереди пакетов соединений
+     * @param[in] cache Кэш результатов или nullptr
+     * @param[in] verifier Выборочная проверка результатов или nullptr
+     * @param[out] results Запись результатов, найденных в кэше
+     * @throw system_error при ошибках формата файла или записи результатов
+     */
+    static void buildBatches(VectorParser* parser, BinaryInput* input, uint32_t first, uint32_t num_vect, uint32_t batchVectors, uint32_t splitSize, ShardQueues& queues, ResultCache* cache, SampleVerifier* verifier, OrderedResults& results);
+
+    /**
+     * @brief Добавление кадра вектора в пакет
+     * @param[in,out] batch Заполняемый пакет
+     * @param[in] size_vect Количество элементов кадра
+     * @param[in] parser Разборщик текстового файла (если elements == nullptr)
+     * @param[in] elements Элементы в двоичном файле или nullptr
+     * @param[in] chunk Временный буфер для разбора текстовых элементов
+     * @throw system_error при ошибках формата файла
+     */
+    static void appendFrame(Batch& batch, uint32_t size_vect, VectorParser* parser, const char* elements, vector<double>& chunk);
+
+    /**
+     * @brief Обслуживание одного соединения в режиме нескольких соединений
+     * @param[in] session Аутентифицированная сессия
+     * @param[in] worker Номер соединения
+     * @param[in] queues Очереди пакетов соединений
+     * @param[out] results Запись результатов в исходном порядке
+     * @param[in] window Максимальное количество векторов в полёте
+     * @param[in] adaptive Подбирать размер окна не больше window по задержке и скорости
+     * @param[in] timeout Срок ответа на вектор в миллисекундах (0 - без срока)
+     * @param[in] hedger Дублирование опаздывающих пакетов или nullptr
+     * @throw system_error при ошибках сетевого взаимодействия
+     */
+    static void shardWorker(Session& session, size_t worker, ShardQueues& queues, OrderedResults& results, uint32_t window, bool adaptive, uint32_t timeout, Hedger* hedger);
+
+    /**
+     * @brief Отправка векторов из очереди на сервер
+     * @param[in] writer Буферизованный вывод в сокет
+     * @param[in] ring Очередь разобранных векторов
+     * @param[in] pool Пул, в который возвращаются отправленные буферы
+     * @param[in] window Окно векторов в полёте
+     * @throw system_error при ошибках сетевого взаимодействия
+     */
+    static void sendVectors(SocketWriter& writer, SpscRing<VectorBuffer*>& ring, BufferPool& pool, InFlightWindow& window);
+
+    /**
+     * @brief Отправка векторов из двоичного файла через sendfile
+     * @param[in] writer Буферизованный вывод в сокет
+     * @param[in] input Двоичный входной файл
+     * @param[in] first Индекс первого вектора
+     * @param[in] window Окно векторов в полёте
+     * @param[in] header Передать из файла и заголовок с количеством векторов
+     * @param[in] verifier Выборочная проверка результатов или nullptr
+     * @throw system_error при ошибках сетевого взаимодействия или формата файла
+     */
+    static void sendBinary(SocketWriter& writer, BinaryInput& input, uint32_t first, InFlightWindow& window, bool header, SampleVerifier* verifier);
+
+    /**
+     * @brief Приём результатов от сервера в порядке отправки векторов
+     * @param[in] reader Буферизованный ввод из сокета
+     * @param[in] first Индекс вектора первого результата
+     * @param[in] num_vect Количество ожидаемых результатов
+     * @param[in] window Окно векторов в полёте
+     * @param[out] out Запись результатов
+     * @throw system_error при ошибках сетевого взаимодействия, разрыве соединения или записи в файл
+     */
+    static void receiveResults(SocketReader& reader, uint32_t first, uint32_t num_vect, InFlightWindow& window, OrderedResults& out);
     
 public:
+    /**
+     * @brief Разбор векторов из файла в очередь на отправку (поток-производитель)
+     * @param[in] parser Разборщик файла с векторами данных
+     * @param[in] first Индекс первого вектора
+     * @param[in] num_vect Количество векторов
+     * @param[in] pool Пул буферов векторов
+     * @param[out] ring Очередь разобранных векторов
+     * @param[in] verifier Выборочная проверка результатов или nullptr
+     * @throw system_error при ошибках формата файла
+     * @details Вектор длиннее STREAM_CHUNK разбирается в несколько буферов,
+     * поэтому вместимость буфера пула (с учётом роста вдвое) остаётся меньше
+     * 2 * STREAM_CHUNK при любом размере вектора
+     */
+    static void parseVectors(VectorParser& parser, uint32_t first, uint32_t num_vect, BufferPool& pool, SpscRing<VectorBuffer*>& ring, SampleVerifier* verifier);
+
     /**
      * @brief Установка соединения и обмен данными с сервером
      * @param[in] p Указатель на параметры соединения
@@ -33,4 +240,45 @@ public:
      * @throw system_error при ошибках сетевого взаимодействия
      */
     static int conn(const Params* p);
+
+    /**
+     * @brief Фоновое открытие недостающих сессий
+     * @param[in] p Указатель на параметры соединения
+     * @param[in] login Логин пользователя
+     * @param[in] pass Пароль пользователя
+     * @param[in,out] sessions Сессии с сервером (по одной на соединение)
+     * @param[in,out] ready Ожидание открытия сессий (недействительное для
+     * открытых сессий); дополняется для сессий, открытие которых начато
+     * @details До успешного get() ожидания сессия недоступна, ошибка
+     * подключения или аутентификации передаётся через get()
+     */
+    static void openSessions(const Params* p, const string& login, const string& pass, vector<unique_ptr<Session>>& sessions, vector<future<void>>& ready);
+
+    /**
+     * @brief Выполнение задания по уже открытым сессиям
+     * @param[in] p Указатель на параметры задания
+     * @param[in] login Логин пользователя
+     * @param[in] pass Пароль пользователя
+     * @param[in,out] sessions Сессии с сервером (по одной на соединение)
+     * @param[in,out] ready Ожидание сессий, открытие которых уже начато
+     * @param[in] cache Кэш результатов, общий для заданий, или nullptr
+     * (тогда кэш читается из CacheFile и сохраняется после задания)
+     * @return 0 при успешном выполнении
+     * @throw system_error при ошибках сетевого взаимодействия или формата файла
+     * @details Отсутствующие и закрытые сервером сессии открываются заново
+     * параллельно с открытием входного файла, после ошибки все сессии
+     * закрываются. После разрыва соединения задание продолжается с первого
+     * вектора без результата (не более Retries раз, с растущей паузой)
+     */
+    static int runJob(const Params* p, const string& login, const string& pass, vector<unique_ptr<Session>>& sessions, vector<future<void>>& ready, ResultCache* cache = nullptr);
+
+    /**
+     * @brief Вычисление результатов задания локально, без сервера
+     * @param[in] p Указатель на параметры задания
+     * @return 0 при успешном выполнении
+     * @throw system_error при ошибках формата файла или записи результатов
+     * @details Файл результатов тот же, что при работе с сервером, включая
+     * контрольную точку для продолжения с флагом Resume
+     */
+    static int offline(const Params* p);
 };
@@ -0,0 +1,31 @@
+#include "binary_input.h"
+#include "result_file.h"
+#include <iostream>
+#include <cstring>
+
+/**
+ * @brief Утилита преобразования файлов клиента
+ * @param[in] argc Количество аргументов командной строки
+ * @param[in] argv Массив аргументов: входной текстовый и выходной двоичный файлы
+ * либо --export, индексированный файл результатов и выходной текстовый файл
+ * @return 0 при успешном выполнении, 1 при ошибке
+ */
+int main(int argc, const char** argv)
+{
+    bool exporting = argc == 4 && strcmp(argv[1], "--export") == 0; ///< Экспорт результатов
+    if (argc != 3 && !exporting) {
+        cout << "Usage: " << argv[0] << " <input.txt> <output.bin>" << endl;
+        cout << "       " << argv[0] << " --export <result.idx> <result.txt>" << endl;
+        return 1;
+    }
+    try {
+        if (exporting)
+            exportResults(argv[2], argv[3]);
+        else
+            convertToBinary(argv[1], argv[2]);
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,163 @@
+#include "daemon.h"
+#include <sstream>
+#include <cstring>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/**
+ * @brief Запись строки в дескриптор целиком
+ * @param[in] out Дескриптор
+ * @param[in] text Строка
+ * @throw system_error при ошибках записи
+ */
+static void writeAll(int out, const string& text)
+{
+    const char* data = text.data(); ///< Ещё не записанные данные
+    size_t len = text.size();       ///< Длина незаписанных данных
+    while (len > 0) {
+        ssize_t n = send(out, data, len, MSG_NOSIGNAL);
+        if (n == -1 && errno == ENOTSOCK)
+            n = write(out, data, len);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            throw system_error(errno, generic_category());
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+/**
+ * @brief Конструктор: чтение учётных данных и открытие сессий
+ * @param[in] p Указатель на параметры командной строки
+ * @details Сессии открываются в фоне; ошибка подключения или
+ * аутентификации возвращается ответом ERR на первое задание
+ */
+Daemon::Daemon(const Params* p) : p(p), client(p)
+{
+}
+
+/**
+ * @brief Приём и выполнение заданий
+ * @return 0 по окончании stdin
+ * @throw system_error при ошибках чтения stdin или создания сокета
+ */
+int Daemon::run()
+{
+    if (p->JobSocket.empty()) {
+        serve(STDIN_FILENO, STDOUT_FILENO);
+        return 0;
+    }
+    int listener = listenOn(p->JobSocket); ///< Слушающий сокет заданий
+    for (;;) {
+        int client = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client == -1) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            int err = errno;
+            close(listener);
+            throw system_error(err, generic_category());
+        }
+        // Отключение клиента не останавливает службу
+        try {
+            serve(client, client);
+        } catch (const system_error&) {
+        }
+        close(client);
+    }
+}
+
+/**
+ * @brief Приём заданий из дескриптора до конца данных
+ * @param[in] in Дескриптор, из которого читаются задания
+ * @param[in] out Дескриптор, в который пишутся ответы
+ * @throw system_error при ошибках чтения заданий или записи ответов
+ */
+void Daemon::serve(int in, int out)
+{
+    string pending;              ///< Прочитанные, но ещё не выполненные строки
+    char buf[DAEMON_READ_SIZE];  ///< Буфер чтения
+    for (;;) {
+        ssize_t n = read(in, buf, sizeof(buf));
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            throw system_error(errno, generic_category());
+        }
+        if (n == 0)
+            break;
+        pending.append(buf, n);
+        size_t start = 0; ///< Начало очередной строки
+        size_t end;       ///< Конец очередной строки
+        while ((end = pending.find('\n', start)) != string::npos) {
+            writeAll(out, runLine(pending.substr(start, end - start)));
+            start = end + 1;
+        }
+        pending.erase(0, start);
+    }
+    // Последняя строка без перевода строки
+    writeAll(out, runLine(pending));
+}
+
+/**
+ * @brief Выполнение одного задания
+ * @param[in] line Строка задания
+ * @return Строка ответа с переводом строки; пустая для пустой строки задания
+ * @details При ошибке формата строки поле файла результатов ответа -
+ * второе поле строки или пустое, если его нет
+ */
+string Daemon::runLine(const string& line)
+{
+    istringstream fields(line);
+    string input;  ///< Входной файл задания
+    string result; ///< Файл результатов задания
+    string extra;  ///< Лишнее поле (признак ошибки формата)
+    if (!(fields >> input))
+        return "";
+    if (!(fields >> result) || fields >> extra)
+        return "ERR " + result + " " + system_error(EINVAL, generic_category()).what() + "\n";
+
+    Params job = *p; ///< Параметры задания
+    job.inFileName = input;
+    job.inFileResult = result;
+    try {
+        client.run(&job);
+    } catch (const exception& e) {
+        return "ERR " + result + " " + e.what() + "\n";
+    }
+    return "OK " + result + "\n";
+}
+
+/**
+ * @brief Создание локального сокета для приёма заданий
+ * @param[in] path Путь к сокету (существующий сокет заменяется)
+ * @return Дескриптор слушающего сокета
+ * @throw system_error при ошибках создания сокета, EEXIST если по пути
+ * находится не сокет
+ */
+int Daemon::listenOn(const string& path)
+{
+    sockaddr_un addr = {};
+    if (path.size() >= sizeof(addr.sun_path))
+        throw system_error(ENAMETOOLONG, generic_category());
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    // Заменяется только сокет, оставшийся от прежнего запуска: путь,
+    // по ошибке указывающий на обычный файл, не удаляется
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0 && !S_ISSOCK(st.st_mode))
+        throw system_error(EEXIST, generic_category());
+
+    int s = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (s == -1)
+        throw system_error(errno, generic_category());
+    unlink(path.c_str());
+    if (bind(s, (sockaddr*) &addr, sizeof(addr)) == -1 || listen(s, DAEMON_BACKLOG) == -1) {
+        int err = errno;
+        close(s);
+        throw system_error(err, generic_category());
+    }
+    return s;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "errno.h"
+#include "interface.h"
+#include "session.h"
+#include "client.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <system_error>
+using namespace std;
+
+#define DAEMON_BACKLOG 16          ///< Очередь ожидающих подключений к сокету заданий
+#define DAEMON_READ_SIZE 4096      ///< Размер порции чтения заданий
+
+/**
+ * @class Daemon
+ * @brief Режим службы: выполнение заданий по заранее открытым сессиям
+ * @details Учётные данные читаются и сессии аутентифицируются один раз при
+ * запуске. Задания читаются построчно из stdin или из подключений к локальному
+ * сокету; строка задания - путь к входному файлу и путь к файлу результатов
+ * через пробел. Задания выполняются друг за другом по тем же сессиям, все
+ * остальные параметры берутся из командной строки. На каждое задание
+ * отвечает строкой "OK <result>" или "ERR <result> <описание ошибки>".
+ */
+class Daemon {
+private:
+    const Params* p; ///< Параметры командной строки
+    Client client;   ///< Клиент с открытыми сессиями
+
+    /**
+     * @brief Создание локального сокета для приёма заданий
+     * @param[in] path Путь к сокету (существующий сокет заменяется)
+     * @return Дескриптор слушающего сокета
+     * @throw system_error при ошибках создания сокета, EEXIST если по пути
+     * находится не сокет
+     */
+    static int listenOn(const string& path);
+
+public:
+    /**
+     * @brief Конструктор: чтение учётных данных и открытие сессий
+     * @param[in] p Указатель на параметры командной строки
+     * @details Сессии открываются в фоне; ошибка подключения или
+     * аутентификации возвращается ответом ERR на первое задание
+     */
+    explicit Daemon(const Params* p);
+
+    /**
+     * @brief Приём и выполнение заданий
+     * @return 0 по окончании stdin
+     * @throw system_error при ошибках чтения stdin или создания сокета
+     * @details С сокетом заданий работает, пока процесс не будет остановлен;
+     * подключения обслуживаются по очереди
+     */
+    int run();
+
+    /**
+     * @brief Приём заданий из дескриптора до конца данных
+     * @param[in] in Дескриптор, из которого читаются задания
+     * @param[in] out Дескриптор, в который пишутся ответы
+     * @throw system_error при ошибках чтения заданий или записи ответов
+     */
+    void serve(int in, int out);
+
+    /**
+     * @brief Выполнение одного задания
+     * @param[in] line Строка задания
+     * @return Строка ответа с переводом строки; пустая для пустой строки задания
+     * @details При ошибке формата строки поле файла результатов ответа -
+     * второе поле строки или пустое, если его нет
+     */
+    string runLine(const string& line);
+};
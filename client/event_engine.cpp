@@ -0,0 +1,451 @@
+#include "event_engine.h"
+#include "metrics.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#define ENGINE_WAKE UINT64_MAX ///< Метка события eventfd в epoll
+
+/**
+ * @brief Перевод сокета в блокирующий или неблокирующий режим
+ * @param[in] fd Дескриптор сокета
+ * @param[in] nonblocking Неблокирующий режим
+ * @throw system_error при ошибках fcntl
+ */
+static void setNonBlocking(int fd, bool nonblocking)
+{
+    int flags = fcntl(fd, F_GETFL);
+    if (flags == -1)
+        throw system_error(errno, generic_category());
+    flags = nonblocking ? flags | O_NONBLOCK : flags & ~O_NONBLOCK;
+    if (fcntl(fd, F_SETFL, flags) == -1)
+        throw system_error(errno, generic_category());
+}
+
+/**
+ * @brief Конструктор
+ * @param[in] p Указатель на параметры задания
+ * @param[in] login Логин пользователя
+ * @param[in] pass Пароль пользователя
+ * @param[in] queues Очереди пакетов
+ * @param[out] results Запись результатов
+ * @param[in] hedger Дублирование опаздывающих пакетов или nullptr
+ * @throw system_error при ошибках создания epoll или eventfd
+ */
+EventEngine::EventEngine(const Params* p, const string& login, const string& pass, ShardQueues& queues, OrderedResults& results, Hedger* hedger)
+    : p(p), login(login), pass(pass), queues(queues), results(results), hedger(hedger)
+{
+    ep = epoll_create1(EPOLL_CLOEXEC);
+    if (ep == -1)
+        throw system_error(errno, generic_category());
+    wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake == -1) {
+        int err = errno;
+        close(ep);
+        throw system_error(err, generic_category());
+    }
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = ENGINE_WAKE;
+    if (epoll_ctl(ep, EPOLL_CTL_ADD, wake, &ev) == -1) {
+        int err = errno;
+        close(wake);
+        close(ep);
+        throw system_error(err, generic_category());
+    }
+}
+
+/**
+ * @brief Деструктор: закрывает epoll, eventfd и собственные сокеты
+ * @details Сокеты, взятые у сессий, закрываются их владельцами
+ */
+EventEngine::~EventEngine()
+{
+    queues.setNotify(-1);
+    for (Conn& c : conns)
+        if (!c.adopted && c.fd != -1)
+            close(c.fd);
+    close(wake);
+    close(ep);
+}
+
+/**
+ * @brief Начало неблокирующего подключения
+ * @param[in,out] c Соединение
+ * @throw system_error при ошибках создания сокета
+ */
+void EventEngine::startConnect(Conn& c)
+{
+    c.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (c.fd == -1)
+        throw system_error(errno, generic_category());
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(p->Port);
+    addr.sin_addr.s_addr = inet_addr(p->Address.c_str());
+    c.opened = chrono::steady_clock::now();
+    if (connect(c.fd, (sockaddr*) &addr, sizeof(addr)) == -1 && errno != EINPROGRESS)
+        throw system_error(errno, generic_category());
+    c.state = State::Connecting;
+}
+
+/**
+ * @brief Выполнение задания
+ * @param[in,out] sessions Сессии с сервером (по одной на соединение)
+ * @throw system_error при ошибках сетевого взаимодействия
+ */
+void EventEngine::run(vector<unique_ptr<Session>>& sessions)
+{
+    Tracer::threadName("event loop");
+    conns.resize(sessions.size());
+    for (size_t i = 0; i < conns.size(); i++) {
+        Conn& c = conns[i];
+        c.active = chrono::steady_clock::now();
+        c.window = WindowController(p->Window, p->AdaptiveWindow, p->Timeout);
+        if (sessions[i] && sessions[i]->alive()) {
+            c.fd = sessions[i]->descriptor();
+            c.adopted = true;
+            c.state = State::Ready;
+            setNonBlocking(c.fd, true);
+        } else {
+            sessions[i].reset();
+            startConnect(c);
+        }
+        // Событие с фронтом: после него сокет читается и пишется до EAGAIN
+        epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.u64 = i;
+        if (epoll_ctl(ep, EPOLL_CTL_ADD, c.fd, &ev) == -1)
+            throw system_error(errno, generic_category());
+    }
+    queues.setNotify(wake);
+
+    epoll_event events[ENGINE_MAX_EVENTS]; ///< Готовые события
+    int wait = p->Timeout > 0 || hedger != nullptr ? HEDGE_CHECK_INTERVAL : -1; ///< Наибольшее ожидание событий
+    for (size_t i = 0; i < conns.size(); i++)
+        send(i);
+    while (!idle() && !(hedger != nullptr && hedger->complete())) {
+        expire();
+        int n;
+        {
+            PhaseTimer timer(Phase::Wait);
+            n = epoll_wait(ep, events, ENGINE_MAX_EVENTS, wait);
+        }
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            throw system_error(errno, generic_category());
+        }
+        for (int k = 0; k < n; k++) {
+            if (events[k].data.u64 != ENGINE_WAKE) {
+                handle(events[k].data.u64);
+                continue;
+            }
+            // Появились пакеты: их разбирают соединения, которым нечего отправлять
+            uint64_t count;
+            while (read(wake, &count, sizeof(count)) == sizeof(count))
+                ;
+            for (size_t i = 0; i < conns.size(); i++)
+                if (conns[i].sending == nullptr)
+                    send(i);
+        }
+    }
+    queues.setNotify(-1);
+
+    // Сокеты возвращаются в блокирующий режим; новые аутентифицированные
+    // соединения становятся сессиями для следующих заданий. Соединение,
+    // ещё ждущее ответов, в непредсказуемом состоянии и закрывается
+    for (size_t i = 0; i < conns.size(); i++) {
+        Conn& c = conns[i];
+        epoll_ctl(ep, EPOLL_CTL_DEL, c.fd, nullptr);
+        if (c.sending != nullptr || !c.sent.empty() || c.state != State::Ready) {
+            if (c.adopted)
+                sessions[i].reset();
+            else
+                close(c.fd);
+            c.fd = -1;
+            continue;
+        }
+        setNonBlocking(c.fd, false);
+        if (!c.adopted && c.state == State::Ready) {
+            sessions[i].reset(new Session(c.fd));
+            c.fd = -1;
+        }
+    }
+}
+
+/**
+ * @brief Проверка окончания работы
+ * @return true если пакетов больше не будет и ответы на все векторы получены
+ */
+bool EventEngine::idle() const
+{
+    if (!queues.exhausted())
+        return false;
+    for (const Conn& c : conns)
+        if (c.sending != nullptr || !c.sent.empty())
+            return false;
+    return true;
+}
+
+/**
+ * @brief Проверка сроков ответов и дублирование опаздывающих пакетов
+ * @throw system_error ETIMEDOUT если соединение ждёт ответа дольше Timeout
+ * @details Тайм-аут отсчитывается от последнего продвижения обмена и
+ * действует, пока идёт рукопожатие или есть векторы без ответа; кроме того,
+ * ответ на самый старый вектор без ответа должен прийти не позже Timeout
+ * после его отправки
+ */
+void EventEngine::expire()
+{
+    if (hedger != nullptr)
+        hedger->check();
+    if (p->Timeout == 0)
+        return;
+    auto now = chrono::steady_clock::now();
+    for (Conn& c : conns) {
+        // Обмен без продвижения ограничен тайм-аутом, а ответ на каждый
+        // отправленный вектор - сроком от его отправки
+        if ((c.state != State::Ready || c.inFlight > 0) && now - c.active > chrono::milliseconds(p->Timeout))
+            throw system_error(ETIMEDOUT, generic_category());
+        if (c.inFlight > 0 && c.window.deadline(now) < now)
+            throw system_error(ETIMEDOUT, generic_category());
+    }
+}
+
+/**
+ * @brief Обработка готовности сокета соединения
+ * @param[in] index Номер соединения
+ * @throw system_error при ошибках сетевого взаимодействия,
+ * EACCES если сервер не подтвердил аутентификацию
+ */
+void EventEngine::handle(size_t index)
+{
+    Conn& c = conns[index];
+    if (c.state != State::Ready && !handshake(c))
+        return;
+    receive(c);
+    send(index);
+}
+
+/**
+ * @brief Продвижение рукопожатия
+ * @param[in,out] c Соединение
+ * @return true если рукопожатие завершено
+ * @throw system_error при ошибках сетевого взаимодействия
+ */
+bool EventEngine::handshake(Conn& c)
+{
+    for (;;) {
+        switch (c.state) {
+        case State::Connecting: {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            if (getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1)
+                err = errno;
+            if (err != 0)
+                throw system_error(err, generic_category());
+            if (Metrics* metrics = Metrics::active()) {
+                metrics->addPhase(Phase::Connect, chrono::steady_clock::now() - c.opened);
+                c.opened = chrono::steady_clock::now();
+            }
+            c.out = login;
+            c.state = State::SendLogin;
+            break;
+        }
+        case State::SendLogin:
+        case State::SendHash:
+            while (!c.out.empty()) {
+                ssize_t n = ::send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+                if (Metrics* metrics = Metrics::active())
+                    metrics->sent(max<ssize_t>(n, 0));
+                if (n == -1) {
+                    if (errno == EAGAIN)
+                        return false;
+                    if (errno == EINTR)
+                        continue;
+                    throw system_error(errno, generic_category());
+                }
+                c.out.erase(0, n);
+                c.active = chrono::steady_clock::now();
+            }
+            c.state = c.state == State::SendLogin ? State::ReadSalt : State::ReadOk;
+            break;
+        case State::ReadSalt:
+        case State::ReadOk: {
+            size_t need = c.state == State::ReadSalt ? SALT_LENGTH : strlen(AUTH_OK); ///< Длина ожидаемого ответа
+            while (c.in.size() < need) {
+                char buf[SALT_LENGTH];
+                ssize_t n = recv(c.fd, buf, need - c.in.size(), 0);
+                if (Metrics* metrics = Metrics::active())
+                    metrics->received(max<ssize_t>(n, 0));
+                if (n == -1) {
+                    if (errno == EAGAIN)
+                        return false;
+                    if (errno == EINTR)
+                        continue;
+                    throw system_error(errno, generic_category());
+                }
+                if (n == 0)
+                    throw system_error(ECONNRESET, generic_category());
+                c.in.append(buf, n);
+                c.active = chrono::steady_clock::now();
+            }
+            if (c.state == State::ReadSalt) {
+                c.out = auth(c.in, pass);
+                c.state = State::SendHash;
+            } else {
+                if (c.in != AUTH_OK)
+                    throw system_error(EACCES, generic_category());
+                if (Metrics* metrics = Metrics::active())
+                    metrics->addPhase(Phase::Handshake, chrono::steady_clock::now() - c.opened);
+                c.state = State::Ready;
+            }
+            c.in.clear();
+            break;
+        }
+        case State::Ready:
+            return true;
+        }
+    }
+}
+
+/**
+ * @brief Приём и разбор результатов до опустошения сокета
+ * @param[in,out] c Соединение
+ * @throw system_error при ошибках сетевого взаимодействия или разрыве соединения,
+ * EPROTO если сервер прислал результат без отправленного вектора
+ */
+void EventEngine::receive(Conn& c)
+{
+    char buf[ENGINE_READ_SIZE + sizeof(double)]; ///< Неполный результат и принятые байты
+    for (;;) {
+        memcpy(buf, c.partial, c.partialLen);
+        ssize_t n; ///< Принято байт
+        {
+            // Ожидание результатов идёт в epoll_wait, интервал - только чтение
+            TraceSpan result(TraceKind::Result, 0, 0);
+            n = recv(c.fd, buf + c.partialLen, ENGINE_READ_SIZE, 0);
+            if (n > 0 && !c.sent.empty())
+                result.range(c.sent.front()->index(c.received), (c.partialLen + n) / sizeof(double));
+        }
+        if (Metrics* metrics = Metrics::active())
+            metrics->received(max<ssize_t>(n, 0));
+        if (n == -1) {
+            if (errno == EAGAIN)
+                return;
+            if (errno == EINTR)
+                continue;
+            throw system_error(errno, generic_category());
+        }
+        if (n == 0)
+            throw system_error(ECONNRESET, generic_category());
+        c.active = chrono::steady_clock::now();
+        size_t len = c.partialLen + n;           ///< Байт в буфере
+        size_t count = len / sizeof(double);     ///< Полных результатов в буфере
+        TraceSpan write(TraceKind::Write, c.sent.empty() ? 0 : c.sent.front()->index(c.received), count);
+        for (size_t k = 0; k < count; k++) {
+            if (c.sent.empty())
+                throw system_error(EPROTO, generic_category());
+            double result; ///< Результат вектора
+            memcpy(&result, buf + k * sizeof(double), sizeof(double));
+            Batch* batch = c.sent.front();
+            results.putFrame(*batch, c.received, result);
+            c.inFlight--;
+            c.window.onReceive(1);
+            if (++c.received == batch->count) {
+                c.sent.pop_front();
+                c.received = 0;
+                if (hedger != nullptr)
+                    hedger->finish(batch);
+                queues.release(batch);
+            }
+        }
+        c.partialLen = len - count * sizeof(double);
+        memcpy(c.partial, buf + count * sizeof(double), c.partialLen);
+    }
+}
+
+/**
+ * @brief Отправка пакетов в пределах окна до заполнения сокета
+ * @param[in] index Номер соединения
+ * @throw system_error при ошибках сетевого взаимодействия
+ * @details Кадр считается в полёте с момента, когда окно допустило его
+ * отправку; пакет возвращается в набор свободных только после приёма
+ * всех его результатов, то есть не раньше окончания его отправки
+ */
+void EventEngine::send(size_t index)
+{
+    Conn& c = conns[index];
+    if (c.state != State::Ready)
+        return;
+    for (;;) {
+        if (c.sending == nullptr) {
+            c.sending = queues.tryPop(index);
+            if (c.sending == nullptr)
+                return;
+            if (hedger != nullptr && !hedger->start(c.sending, index)) {
+                queues.release(c.sending);
+                c.sending = nullptr;
+                continue;
+            }
+            c.sent.push_back(c.sending);
+            c.header = 0;
+            c.frame = 0;
+            c.pos = 0;
+        }
+        Batch* batch = c.sending;
+        const char* data; ///< Отправляемые данные
+        size_t len;       ///< Их длина
+        if (c.header < sizeof(batch->count)) {
+            data = reinterpret_cast<const char*>(&batch->count) + c.header;
+            len = sizeof(batch->count) - c.header;
+        } else {
+            while (c.frame < batch->ends.size() && c.inFlight < c.window.limit()) {
+                // Срок ответа отсчитывается с момента, когда появился вектор без ответа
+                if (c.inFlight == 0)
+                    c.active = chrono::steady_clock::now();
+                c.frame++;
+                c.inFlight++;
+                c.window.onSend();
+            }
+            size_t limit = c.frame == 0 ? 0 : batch->ends[c.frame - 1]; ///< Конец допущенных кадров
+            if (c.pos == limit) {
+                if (c.frame < batch->ends.size())
+                    return;
+                c.sending = nullptr;
+                continue;
+            }
+            data = batch->frames.data() + c.pos;
+            len = limit - c.pos;
+        }
+        // Интервал - запись допущенных окном кадров (ожидание окна идёт в цикле событий)
+        TraceSpan span(TraceKind::Send, 0, 0);
+        if (Tracer::active() != nullptr && c.header >= sizeof(batch->count)) {
+            uint32_t done = upper_bound(batch->ends.begin(), batch->ends.begin() + c.frame, c.pos) - batch->ends.begin();
+            span.range(batch->index(done), c.frame - done);
+        }
+        ssize_t n = ::send(c.fd, data, len, MSG_NOSIGNAL | (c.header < sizeof(batch->count) ? MSG_MORE : 0));
+        if (Metrics* metrics = Metrics::active())
+            metrics->sent(max<ssize_t>(n, 0));
+        if (n == -1) {
+            if (errno == EAGAIN)
+                return;
+            if (errno == EINTR)
+                continue;
+            throw system_error(errno, generic_category());
+        }
+        if (c.header < sizeof(batch->count)) {
+            c.header += n;
+        } else {
+            c.pos += n;
+            // Допущенные кадры целиком в сокете: от этого момента
+            // отсчитываются их задержка и срок ответа
+            if (c.pos == batch->ends[c.frame - 1])
+                c.window.onFlush();
+        }
+    }
+}
@@ -0,0 +1,165 @@
+#pragma once
+#include "errno.h"
+#include "crypto.h"
+#include "interface.h"
+#include "session.h"
+#include "shard.h"
+#include "hedge.h"
+#include "window.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <system_error>
+using namespace std;
+
+#define ENGINE_MAX_EVENTS 256   ///< Количество событий за один вызов epoll_wait
+#define ENGINE_READ_SIZE 65536  ///< Размер порции чтения результатов из сокета
+
+/**
+ * @class EventEngine
+ * @brief Обслуживание всех сессий задания одним потоком через epoll
+ * @details Вместо потока (и двух блокирующих операций) на соединение все
+ * сокеты переводятся в неблокирующий режим и обслуживаются одним циклом
+ * событий. Для каждого соединения ведётся конечный автомат: неблокирующее
+ * подключение, рукопожатие (логин, соль, хеш, подтверждение), затем обмен
+ * пакетами из ShardQueues - заголовок задания и кадры в пределах окна,
+ * результаты разбираются по мере поступления байтов. О новых пакетах
+ * разборщик сообщает через eventfd, поэтому цикл не опрашивает очереди.
+ * С тайм-аутом или дублированием цикл просыпается не реже раза в
+ * HEDGE_CHECK_INTERVAL миллисекунд, чтобы проверить сроки ответов.
+ */
+class EventEngine {
+private:
+    /**
+     * @enum State
+     * @brief Состояние соединения
+     */
+    enum class State {
+        Connecting, ///< Ожидание завершения неблокирующего connect
+        SendLogin,  ///< Отправка логина
+        ReadSalt,   ///< Чтение соли
+        SendHash,   ///< Отправка хеша
+        ReadOk,     ///< Чтение подтверждения
+        Ready       ///< Аутентифицировано, обмен пакетами
+    };
+
+    /**
+     * @struct Conn
+     * @brief Состояние одного соединения
+     */
+    struct Conn {
+        int fd = -1;              ///< Дескриптор сокета
+        bool adopted = false;     ///< Сокет взят у существующей сессии
+        State state = State::Connecting; ///< Состояние автомата
+        string out;               ///< Данные рукопожатия для отправки
+        string in;                ///< Принятые данные рукопожатия
+        Batch* sending = nullptr; ///< Отправляемый пакет
+        size_t header = 0;        ///< Отправлено байт заголовка пакета
+        size_t frame = 0;         ///< Количество кадров пакета, допущенных окном
+        size_t pos = 0;           ///< Отправлено байт кадров пакета
+        deque<Batch*> sent;       ///< Пакеты, ожидающие результатов
+        uint32_t received = 0;    ///< Принято результатов первого пакета в sent
+        uint32_t inFlight = 0;    ///< Векторы без ответа
+        WindowController window;  ///< Размер окна соединения
+        char partial[sizeof(double)]; ///< Начало неполного результата
+        size_t partialLen = 0;    ///< Длина неполного результата
+        chrono::steady_clock::time_point active; ///< Последнее продвижение обмена
+        chrono::steady_clock::time_point opened; ///< Начало подключения или рукопожатия
+    };
+
+    const Params* p;          ///< Параметры задания
+    string login;             ///< Логин пользователя
+    string pass;              ///< Пароль пользователя
+    ShardQueues& queues;      ///< Очереди пакетов
+    OrderedResults& results;  ///< Запись результатов
+    Hedger* hedger;           ///< Дублирование опаздывающих пакетов или nullptr
+    vector<Conn> conns;       ///< Соединения
+    int ep = -1;              ///< Дескриптор epoll
+    int wake = -1;            ///< eventfd для уведомлений о новых пакетах
+
+    /**
+     * @brief Начало неблокирующего подключения
+     * @param[in,out] c Соединение
+     * @throw system_error при ошибках создания сокета
+     */
+    void startConnect(Conn& c);
+
+    /**
+     * @brief Обработка готовности сокета соединения
+     * @param[in] index Номер соединения
+     * @throw system_error при ошибках сетевого взаимодействия,
+     * EACCES если сервер не подтвердил аутентификацию
+     */
+    void handle(size_t index);
+
+    /**
+     * @brief Продвижение рукопожатия
+     * @param[in,out] c Соединение
+     * @return true если рукопожатие завершено
+     * @throw system_error при ошибках сетевого взаимодействия
+     */
+    bool handshake(Conn& c);
+
+    /**
+     * @brief Приём и разбор результатов до опустошения сокета
+     * @param[in,out] c Соединение
+     * @throw system_error при ошибках сетевого взаимодействия или разрыве соединения
+     */
+    void receive(Conn& c);
+
+    /**
+     * @brief Отправка пакетов в пределах окна до заполнения сокета
+     * @param[in] index Номер соединения
+     * @throw system_error при ошибках сетевого взаимодействия
+     */
+    void send(size_t index);
+
+    /**
+     * @brief Проверка окончания работы
+     * @return true если пакетов больше не будет и ответы на все векторы получены
+     */
+    bool idle() const;
+
+    /**
+     * @brief Проверка сроков ответов и дублирование опаздывающих пакетов
+     * @throw system_error ETIMEDOUT если соединение ждёт ответа дольше Timeout
+     */
+    void expire();
+
+public:
+    /**
+     * @brief Конструктор
+     * @param[in] p Указатель на параметры задания
+     * @param[in] login Логин пользователя
+     * @param[in] pass Пароль пользователя
+     * @param[in] queues Очереди пакетов
+     * @param[out] results Запись результатов
+     * @param[in] hedger Дублирование опаздывающих пакетов или nullptr
+     * @throw system_error при ошибках создания epoll или eventfd
+     */
+    EventEngine(const Params* p, const string& login, const string& pass, ShardQueues& queues, OrderedResults& results, Hedger* hedger = nullptr);
+
+    /**
+     * @brief Деструктор: закрывает epoll, eventfd и собственные сокеты
+     */
+    ~EventEngine();
+
+    EventEngine(const EventEngine&) = delete;
+    EventEngine& operator=(const EventEngine&) = delete;
+
+    /**
+     * @brief Выполнение задания
+     * @param[in,out] sessions Сессии с сервером (по одной на соединение)
+     * @throw system_error при ошибках сетевого взаимодействия
+     * @details Живые сессии используются без повторной аутентификации,
+     * вместо отсутствующих открываются новые соединения; после успешного
+     * задания они сохраняются в sessions для следующих заданий. Соединения,
+     * ждущие ответов на пакеты, результаты которых уже пришли по другим
+     * соединениям, закрываются
+     */
+    void run(vector<unique_ptr<Session>>& sessions);
+};
@@ -0,0 +1,58 @@
+#include "workload.h"
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <iostream>
+#include <thread>
+namespace po = boost::program_options;
+
+/**
+ * @brief Генератор синтетических заданий для нагрузочных испытаний
+ * @param[in] argc Количество аргументов командной строки
+ * @param[in] argv Массив аргументов
+ * @return 0 при успешном выполнении, 1 при ошибке
+ * @details Записывает входной файл клиента (текстовый или двоичный) и файл
+ * ожидаемых результатов в формате файла результатов клиента
+ */
+int main(int argc, const char** argv)
+{
+    string input, expected, sizeSpec, valueSpec;
+    uint32_t count, threads;
+    uint64_t seed;
+    double duplicates;
+    bool binary = false, binaryResult = false;
+
+    po::options_description desc("Allowed options");
+    desc.add_options()
+    ("help,h", "Show help")
+    ("output,o", po::value<string>(&input)->required(), "Input file to generate")
+    ("expected,e", po::value<string>(&expected)->required(), "File of expected results")
+    ("count,n", po::value<uint32_t>(&count)->required(), "Number of vectors")
+    ("sizes,s", po::value<string>(&sizeSpec)->default_value("fixed:1000"), "Vector sizes: fixed:N, uniform:MIN:MAX, zipf:S:MAX or pareto:ALPHA:MIN:MAX")
+    ("values,v", po::value<string>(&valueSpec)->default_value("uniform:-1000:1000"), "Elements: uniform:A:B, normal:MEAN:SD or int:A:B")
+    ("duplicates,d", po::value<double>(&duplicates)->default_value(0), "Fraction (0-1) of vectors repeating one of the recent vectors")
+    ("seed", po::value<uint64_t>(&seed)->default_value(1), "Random seed; the same seed gives the same files")
+    ("threads,j", po::value<uint32_t>(&threads)->default_value(thread::hardware_concurrency()), "Number of generating threads")
+    ("binary,b", po::bool_switch(&binary), "Write the input file in binary wire format")
+    ("binary-result,B", po::bool_switch(&binaryResult), "Write expected results as raw binary doubles");
+
+    try {
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        if (vm.count("help") || argc == 1) {
+            cout << desc << endl;
+            return 1;
+        }
+        po::notify(vm);
+
+        Workload workload(count, SizeDistribution::parse(sizeSpec), ValueDistribution::parse(valueSpec), duplicates, seed);
+        auto start = chrono::steady_clock::now();
+        uint64_t bytes = workload.generate(input, expected, binary, binaryResult, threads);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "Сгенерировано векторов: " << count << ", байт: " << bytes
+             << ", " << bytes / 1e6 / max(seconds, 1e-9) << " МБ/с" << endl;
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include "hedge.h"
+#include <algorithm>
+
+/**
+ * @brief Конструктор
+ * @param[in] queues Очереди пакетов
+ * @param[in] results Запись результатов
+ * @param[in] total Количество векторов задания
+ * @param[in] percentile Перцентиль времени пакетов (0-100)
+ * @param[in,out] stats Счётчики задания
+ */
+Hedger::Hedger(ShardQueues& queues, OrderedResults& results, uint32_t total, double percentile, HedgeStats& stats)
+    : queues(queues), results(results), total(total), percentile(percentile), stats(stats), samples(HEDGE_SAMPLES)
+{
+}
+
+/**
+ * @brief Начало отправки пакета
+ * @param[in] batch Пакет
+ * @param[in] worker Номер соединения
+ * @return false если пакет не нужен (его пара уже ответила)
+ */
+bool Hedger::start(Batch* batch, size_t worker)
+{
+    lock_guard<mutex> lock(m);
+    if (superseded.erase(batch)) {
+        copies.erase(batch);
+        stats.cancelled++;
+        return false;
+    }
+    flights[batch] = {chrono::steady_clock::now(), worker};
+    return true;
+}
+
+/**
+ * @brief Получение всех результатов пакета
+ * @param[in] batch Пакет (возвращается в набор свободных после вызова)
+ * @details Время пакета становится замером; пара пакета, если она есть,
+ * отмечается как ненужная
+ */
+void Hedger::finish(Batch* batch)
+{
+    lock_guard<mutex> lock(m);
+    auto flight = flights.find(batch);
+    if (flight != flights.end()) {
+        chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - flight->second.start;
+        samples[sampled++ % samples.size()] = elapsed.count();
+        flights.erase(flight);
+    }
+    superseded.erase(batch);
+    bool copy = copies.erase(batch) > 0; ///< Пакет - копия
+    auto twin = twins.find(batch);
+    if (twin == twins.end())
+        return;
+    Batch* other = twin->second; ///< Пара пакета
+    twins.erase(twin);
+    twins.erase(other);
+    superseded.insert(other);
+    if (copy)
+        stats.won++;
+}
+
+/**
+ * @brief Порог дублирования (под мьютексом)
+ * @param[out] threshold Время пакета в миллисекундах, после которого он дублируется
+ * @return false если замеров для оценки ещё мало
+ */
+bool Hedger::limit(double& threshold)
+{
+    if (sampled < HEDGE_MIN_SAMPLES)
+        return false;
+    vector<double> sorted(samples.begin(), samples.begin() + min(sampled, samples.size()));
+    size_t rank = min(sorted.size() - 1, size_t(percentile / 100 * sorted.size()));
+    nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    threshold = sorted[rank];
+    return true;
+}
+
+/**
+ * @brief Дублирование опаздывающих пакетов
+ */
+void Hedger::check()
+{
+    lock_guard<mutex> lock(m);
+    double threshold; ///< Порог дублирования в миллисекундах
+    if (!limit(threshold))
+        return;
+    auto now = chrono::steady_clock::now();
+    for (auto& [batch, flight] : flights) {
+        if (batch->parts > 1 || copies.count(batch) || twins.count(batch) || superseded.count(batch))
+            continue;
+        chrono::duration<double, milli> elapsed = now - flight.start;
+        if (elapsed.count() <= threshold)
+            continue;
+        Batch* copy = queues.tryAcquire(); ///< Копия опаздывающего пакета
+        if (copy == nullptr)
+            return;
+        *copy = *batch;
+        copies.insert(copy);
+        twins[batch] = copy;
+        twins[copy] = batch;
+        stats.issued++;
+        queues.pushHedge(copy, flight.worker);
+    }
+}
+
+/**
+ * @brief Проверка, что получены результаты всех векторов задания
+ * @return true если все результаты записаны
+ */
+bool Hedger::complete()
+{
+    return results.written() >= total;
+}
+
+/**
+ * @brief Соединения с пакетами без ответа
+ * @return Номера соединений
+ */
+vector<size_t> Hedger::busy()
+{
+    lock_guard<mutex> lock(m);
+    vector<size_t> workers;
+    for (auto& [batch, flight] : flights)
+        if (find(workers.begin(), workers.end(), flight.worker) == workers.end())
+            workers.push_back(flight.worker);
+    return workers;
+}
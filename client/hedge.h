@@ -0,0 +1,120 @@
+#pragma once
+#include "shard.h"
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+using namespace std;
+
+#define HEDGE_SAMPLES 256                ///< Количество последних времён пакетов для оценки перцентиля
+#define HEDGE_MIN_SAMPLES 8              ///< Наименьшее количество замеров до первого дублирования
+#define HEDGE_CHECK_INTERVAL 5           ///< Период проверки опаздывающих пакетов в миллисекундах
+#define HEDGE_BATCHES_PER_CONNECTION 32  ///< Количество пакетов на соединение при дублировании
+
+/**
+ * @struct HedgeStats
+ * @brief Счётчики дублирования запросов и тайм-аутов задания
+ */
+struct HedgeStats {
+    uint64_t issued = 0;    ///< Отправлено копий пакетов
+    uint64_t won = 0;       ///< Копий, ответивших раньше исходного пакета
+    uint64_t cancelled = 0; ///< Копий и пакетов, не отправленных за ненадобностью
+    uint64_t timeouts = 0;  ///< Попыток, прерванных тайм-аутом сессии
+};
+
+/**
+ * @class Hedger
+ * @brief Дублирование опаздывающих пакетов на другие соединения
+ * @details Соединения сообщают о начале отправки пакета и о получении всех
+ * его результатов; по времени обработки последних пакетов оценивается
+ * заданный перцентиль. Пакет, который обрабатывается дольше, копируется
+ * в очередь копий и уходит по другому соединению; в запись идёт первый
+ * пришедший результат, повторный отбрасывается. Когда одна из пары
+ * ответила целиком, вторая, если ещё не отправлена, отменяется. Части
+ * разбитых векторов не дублируются: их результаты складываются.
+ * Методы можно вызывать из разных потоков.
+ */
+class Hedger {
+private:
+    /**
+     * @struct Flight
+     * @brief Пакет, отправляемый соединением
+     */
+    struct Flight {
+        chrono::steady_clock::time_point start; ///< Начало отправки
+        size_t worker;                          ///< Номер соединения
+    };
+
+    ShardQueues& queues;       ///< Очереди пакетов
+    OrderedResults& results;   ///< Запись результатов
+    uint32_t total;            ///< Количество векторов задания
+    double percentile;         ///< Перцентиль времени пакетов для дублирования
+    HedgeStats& stats;         ///< Счётчики задания
+    mutex m;                   ///< Мьютекс для защиты состояния
+    unordered_map<Batch*, Flight> flights;  ///< Пакеты в работе
+    unordered_map<Batch*, Batch*> twins;    ///< Пакет и его копия (в обе стороны)
+    unordered_set<Batch*> copies;           ///< Копии пакетов
+    unordered_set<Batch*> superseded;       ///< Пакеты, пара которых уже ответила
+    vector<double> samples;    ///< Последние времена пакетов в миллисекундах (кольцо)
+    size_t sampled = 0;        ///< Количество замеров за всё время
+
+    /**
+     * @brief Порог дублирования (под мьютексом)
+     * @param[out] threshold Время пакета в миллисекундах, после которого он дублируется
+     * @return false если замеров для оценки ещё мало
+     */
+    bool limit(double& threshold);
+
+public:
+    /**
+     * @brief Конструктор
+     * @param[in] queues Очереди пакетов
+     * @param[in] results Запись результатов
+     * @param[in] total Количество векторов задания
+     * @param[in] percentile Перцентиль времени пакетов (0-100)
+     * @param[in,out] stats Счётчики задания
+     */
+    Hedger(ShardQueues& queues, OrderedResults& results, uint32_t total, double percentile, HedgeStats& stats);
+
+    Hedger(const Hedger&) = delete;
+    Hedger& operator=(const Hedger&) = delete;
+
+    /**
+     * @brief Начало отправки пакета
+     * @param[in] batch Пакет
+     * @param[in] worker Номер соединения
+     * @return false если пакет не нужен (его пара уже ответила);
+     * тогда он возвращается в набор свободных без отправки
+     */
+    bool start(Batch* batch, size_t worker);
+
+    /**
+     * @brief Получение всех результатов пакета
+     * @param[in] batch Пакет (возвращается в набор свободных после вызова)
+     */
+    void finish(Batch* batch);
+
+    /**
+     * @brief Дублирование опаздывающих пакетов
+     * @details Вызывается периодически; каждый пакет дублируется не более
+     * одного раза и только при наличии свободного пакета для копии
+     */
+    void check();
+
+    /**
+     * @brief Проверка, что получены результаты всех векторов задания
+     * @return true если все результаты записаны
+     */
+    bool complete();
+
+    /**
+     * @brief Соединения с пакетами без ответа
+     * @return Номера соединений
+     * @details После получения всех результатов такие соединения
+     * ждут ответов, которые уже не нужны, и их сессии прерываются
+     */
+    vector<size_t> busy();
+};
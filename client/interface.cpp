@@ -9,11 +9,35 @@ UserInterface::UserInterface() : desc("Allowed options")
     // добавление параметров в парсер командной строки
     desc.add_options()
     ("help,h", "Show help") ///< Опция для вывода справки
-    ("input,i", po::value<std::string>(&params.inFileName)->required(),"Set input file name") ///< Обязательный параметр: входной файл
-    ("result,r", po::value<std::string>(&params.inFileResult)->required(),"Set output file name") ///< Обязательный параметр: файл результатов
-    ("data,d", po::value<std::string>(&params.inFileData)->required(),"Set data file name") ///< Обязательный параметр: файл с данными аутентификации
-    ("port,t", po::value<int>(&params.Port)->required(), "Set port") ///< Обязательный параметр: порт сервера
-    ("address,a", po::value<string>(&params.Address)->required(), "Set address"); ///< Обязательный параметр: адрес сервера
+    ("input,i", po::value<std::string>(&params.inFileName),"Set input file name") ///< Обязательный параметр (кроме режима службы): входной файл
+    ("result,r", po::value<std::string>(&params.inFileResult),"Set output file name") ///< Обязательный параметр (кроме режима службы): файл результатов
+    ("data,d", po::value<std::string>(&params.inFileData),"Set data file name") ///< Обязательный параметр (кроме режима offline): файл с данными аутентификации
+    ("port,t", po::value<int>(&params.Port), "Set port") ///< Обязательный параметр (кроме режима offline): порт сервера
+    ("address,a", po::value<string>(&params.Address), "Set address") ///< Обязательный параметр (кроме режима offline): адрес сервера
+    ("window,w", po::value<uint32_t>(&params.Window)->default_value(1), "Set number of vectors in flight") ///< Необязательный параметр: размер окна конвейера
+    ("binary,b", po::bool_switch(&params.Binary), "Input file is in binary wire format") ///< Флаг: двоичный входной файл
+    ("connections,n", po::value<uint32_t>(&params.Connections)->default_value(1), "Set number of parallel sessions") ///< Необязательный параметр: количество соединений
+    ("split,s", po::value<uint32_t>(&params.SplitSize)->default_value(0), "Split vectors longer than this across sessions") ///< Необязательный параметр: размер части большого вектора
+    ("binary-result,B", po::bool_switch(&params.BinaryResult), "Write results as raw binary doubles") ///< Флаг: двоичный файл результатов
+    ("echo,e", po::bool_switch(&params.Echo), "Print every result to the console") ///< Флаг: вывод результатов на консоль
+    ("indexed-result,x", po::bool_switch(&params.IndexedResult), "Write results into a preallocated indexed file (export with converter --export)") ///< Флаг: индексированный файл результатов
+    ("epoll,E", po::bool_switch(&params.Epoll), "Drive all sessions from one thread with epoll") ///< Флаг: цикл событий вместо потока на соединение
+    ("daemon,D", po::bool_switch(&params.Daemon), "Keep sessions open and run jobs \"<input> <result>\" read line by line") ///< Флаг: режим службы
+    ("socket,u", po::value<string>(&params.JobSocket), "Read jobs from this Unix socket instead of stdin") ///< Необязательный параметр: локальный сокет заданий
+    ("retries,R", po::value<uint32_t>(&params.Retries)->default_value(0), "Reconnect this many times after a disconnect, resuming from the first missing result") ///< Необязательный параметр: количество повторных подключений
+    ("resume,c", po::bool_switch(&params.Resume), "Continue an interrupted job from its checkpoint") ///< Флаг: продолжение с контрольной точки
+    ("cache,k", po::value<string>(&params.CacheFile), "Persistent result cache file; vectors found in it are not sent") ///< Необязательный параметр: файл кэша результатов
+    ("cache-size,K", po::value<uint32_t>(&params.CacheSize)->default_value(1 << 20), "Maximum number of result cache entries") ///< Необязательный параметр: размер кэша результатов
+    ("timeout,T", po::value<uint32_t>(&params.Timeout)->default_value(0), "Fail a session whose server leaves a sent vector unanswered for this many milliseconds (0 - wait forever)") ///< Необязательный параметр: тайм-аут ответа сервера
+    ("hedge,H", po::value<double>(&params.HedgePercentile)->default_value(0), "Re-send a batch on another session once it is slower than this percentile of finished batches (0 - off)") ///< Необязательный параметр: перцентиль дублирования запросов
+    ("adaptive,A", po::bool_switch(&params.AdaptiveWindow), "Size the window of each session from measured latency and throughput; --window becomes the upper bound") ///< Флаг: адаптивное окно
+    ("metrics,m", po::value<string>(&params.MetricsFile), "Write phase timings, vector latency histogram and byte/syscall counters to this file at exit (- for stdout)") ///< Необязательный параметр: файл метрик
+    ("metrics-format", po::value<string>(&params.MetricsFormat)->default_value("json"), "Metrics format: json or prometheus") ///< Необязательный параметр: формат метрик
+    ("trace", po::value<string>(&params.TraceFile), "Record parse, enqueue, send, result and write spans of every vector per thread and write them to this file at exit as Chrome trace JSON (chrome://tracing, Perfetto)") ///< Необязательный параметр: файл трассировки
+    ("offline", po::bool_switch(&params.Offline), "Compute results locally without connecting to a server") ///< Флаг: локальное вычисление без сервера
+    ("verify-sample", po::value<double>(&params.VerifySample)->default_value(0), "Check this fraction (0-1) of server results against a local computation; a mismatch fails the job") ///< Необязательный параметр: доля проверяемых результатов
+    ("verify-tolerance", po::value<double>(&params.VerifyTolerance)->default_value(1e-9), "Allowed relative difference between a server result and the local one") ///< Необязательный параметр: допустимое расхождение
+    ("local-sum", po::value<string>(&params.LocalSum)->default_value("compensated"), "Local reduction for --offline and --verify-sample: fast or compensated"); ///< Необязательный параметр: режим локального суммирования
 }
 
 /**
@@ -36,6 +60,35 @@ bool UserInterface::Parser(int argc, const char** argv)
     return false;
     // проверка обязательных параметров и присвоение значений
     po::notify(vm);
+    // без сервера не нужны ни адрес, ни учётные данные
+    if (!params.Offline) {
+        if (!vm.count("data"))
+            throw po::required_option("data");
+        if (!vm.count("port"))
+            throw po::required_option("port");
+        if (!vm.count("address"))
+            throw po::required_option("address");
+    }
+    // в режиме службы входной файл и файл результатов задаются в заданиях
+    if (!params.Daemon) {
+        if (!vm.count("input"))
+            throw po::required_option("input");
+        if (!vm.count("result"))
+            throw po::required_option("result");
+    }
+    if (params.HedgePercentile < 0 || params.HedgePercentile >= 100)
+        throw po::validation_error(po::validation_error::invalid_option_value, "hedge");
+    if (params.MetricsFormat != "json" && params.MetricsFormat != "prometheus")
+        throw po::validation_error(po::validation_error::invalid_option_value, "metrics-format");
+    if (params.VerifySample < 0 || params.VerifySample > 1)
+        throw po::validation_error(po::validation_error::invalid_option_value, "verify-sample");
+    if (params.LocalSum != "fast" && params.LocalSum != "compensated")
+        throw po::validation_error(po::validation_error::invalid_option_value, "local-sum");
+    if (params.Offline && params.Daemon)
+        throw po::validation_error(po::validation_error::invalid_option_value, "offline");
+    // адаптивное окно без явного предела растёт до WINDOW_ADAPTIVE_LIMIT
+    if (params.AdaptiveWindow && vm["window"].defaulted())
+        params.Window = WINDOW_ADAPTIVE_LIMIT;
     return true;
 }
 
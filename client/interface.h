@@ -1,10 +1,13 @@
 #pragma once
 #include <boost/program_options.hpp>
 #include <string>
+#include <cstdint>
 #include <sstream>
 using namespace std;
 namespace po = boost::program_options;
 
+#define WINDOW_ADAPTIVE_LIMIT 4096 ///< Наибольший размер адаптивного окна, если Window не задан
+
 /**
  * @struct Params
  * @brief Структура для хранения параметров командной строки
@@ -16,6 +19,30 @@ struct Params {
     string inFileData;   ///< Имя файла с данными аутентификации (логин и пароль)
     int Port;           ///< Порт сервера для подключения
     string Address;     ///< IP-адрес сервера
+    uint32_t Window = 1; ///< Максимальное количество векторов в полёте (1 - режим "запрос-ответ")
+    bool Binary = false; ///< Входной файл в двоичном формате протокола
+    uint32_t Connections = 1; ///< Количество параллельных соединений с сервером
+    uint32_t SplitSize = 0; ///< Векторы длиннее делятся на части между соединениями (0 - не делятся)
+    bool BinaryResult = false; ///< Файл результатов в двоичном формате (значения double подряд)
+    bool Echo = false;  ///< Вывод каждого результата на консоль
+    bool IndexedResult = false; ///< Результаты пишутся в ячейки индексированного файла по мере получения
+    bool Epoll = false; ///< Все соединения задания обслуживаются одним потоком через epoll
+    bool Daemon = false; ///< Режим службы: задания читаются из stdin или локального сокета
+    string JobSocket;   ///< Путь локального сокета для приёма заданий (пусто - stdin)
+    uint32_t Retries = 0; ///< Количество повторных подключений после разрыва соединения
+    bool Resume = false; ///< Продолжение прерванного задания с контрольной точки
+    string CacheFile; ///< Файл кэша результатов (пусто - без кэша)
+    uint32_t CacheSize = 1 << 20; ///< Наибольшее количество записей в кэше результатов
+    uint32_t Timeout = 0; ///< Наибольшее ожидание ответа сервера в миллисекундах (0 - без ограничения)
+    double HedgePercentile = 0; ///< Перцентиль времени пакетов, после которого пакет дублируется (0 - без дублирования)
+    bool AdaptiveWindow = false; ///< Окно подбирается по задержке и скорости, Window - наибольший размер
+    string MetricsFile;   ///< Файл метрик, записываемый при завершении (пусто - метрики выключены, "-" - стандартный вывод)
+    string MetricsFormat = "json"; ///< Формат метрик: json или prometheus
+    string TraceFile;     ///< Файл трассировки векторов, записываемый при завершении (пусто - трассировка выключена)
+    bool Offline = false; ///< Результаты вычисляются локально, без сервера
+    double VerifySample = 0; ///< Доля результатов сервера, проверяемых локальным вычислением (0 - без проверки)
+    double VerifyTolerance = 1e-9; ///< Допустимое относительное расхождение результата сервера с локальным
+    string LocalSum = "compensated"; ///< Режим локального суммирования: fast или compensated
 };
 
 /**
@@ -0,0 +1,158 @@
+#include "local_server.h"
+#include "crypto.h"
+#include "session.h"
+#include "socket_reader.h"
+#include "socket_writer.h"
+#include "summation.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+/**
+ * @brief Конструктор: запуск сервера
+ * @param[in] login Логин пользователя
+ * @param[in] pass Пароль пользователя
+ * @param[in] port Порт (0 - свободный порт, выбранный системой)
+ * @throw system_error при ошибках создания слушающего сокета
+ */
+LocalServer::LocalServer(const string& login, const string& pass, uint16_t port)
+    : login(login), pass(pass)
+{
+    listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener == -1)
+        throw system_error(errno, generic_category());
+    int on = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    socklen_t len = sizeof(addr);
+    if (bind(listener, (sockaddr*) &addr, len) == -1 || listen(listener, SOMAXCONN) == -1
+        || getsockname(listener, (sockaddr*) &addr, &len) == -1) {
+        int err = errno;
+        close(listener);
+        throw system_error(err, generic_category());
+    }
+    bound = ntohs(addr.sin_port);
+    acceptor = thread([this]{
+        int s;
+        while ((s = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC)) != -1) {
+            // Ответы и так собираются в пакеты, задержка Нейгла им не нужна
+            int nodelay = 1;
+            setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+            lock_guard<mutex> lock(m);
+            clients.push_back(s);
+            threads.emplace_back(&LocalServer::serve, this, s);
+        }
+    });
+}
+
+/**
+ * @brief Деструктор: закрытие подключений и остановка потоков
+ * @details Подключения, которые клиент ещё не закрыл, прерываются
+ */
+LocalServer::~LocalServer()
+{
+    shutdown(listener, SHUT_RDWR);
+    acceptor.join();
+    close(listener);
+    {
+        lock_guard<mutex> lock(m);
+        for (int s : clients)
+            shutdown(s, SHUT_RDWR);
+    }
+    for (thread& t : threads)
+        t.join();
+}
+
+/**
+ * @brief Количество принятых подключений
+ * @return Подключений, принятых за всё время работы
+ */
+size_t LocalServer::connections()
+{
+    lock_guard<mutex> lock(m);
+    return threads.size();
+}
+
+/**
+ * @brief Аутентификация клиента
+ * @param[in] s Дескриптор подключения
+ * @return true если клиент прошёл аутентификацию
+ */
+bool LocalServer::authenticate(int s)
+{
+    char name[256];
+    ssize_t n = recv(s, name, sizeof(name), 0);
+    if (n <= 0)
+        return false;
+
+    // Соль - случайное 64-битное число в шестнадцатеричной записи
+    static thread_local mt19937_64 random(random_device{}());
+    char salt[SALT_LENGTH + 1];
+    snprintf(salt, sizeof(salt), "%016llX", (unsigned long long) random());
+    if (send(s, salt, SALT_LENGTH, MSG_NOSIGNAL) != SALT_LENGTH)
+        return false;
+
+    string expected = auth(salt, pass); ///< Хеш, который должен прислать клиент
+    string hash(expected.size(), '\0');
+    if (recv(s, hash.data(), hash.size(), MSG_WAITALL) != (ssize_t) hash.size())
+        return false;
+    bool ok = string(name, n) == login && hash == expected;
+    const char* reply = ok ? AUTH_OK : AUTH_ERR;
+    return send(s, reply, strlen(reply), MSG_NOSIGNAL) == (ssize_t) strlen(reply) && ok;
+}
+
+/**
+ * @brief Обслуживание подключения до его закрытия клиентом
+ * @param[in] s Дескриптор подключения
+ */
+void LocalServer::serve(int s)
+{
+    if (authenticate(s)) {
+        SocketReader reader(s);
+        SocketWriter writer(s);
+        vector<double> elements; ///< Элементы текущего вектора
+        // Ответы уходят, когда для продолжения не хватает принятых данных:
+        // клиент может ждать их, прежде чем прислать следующий кадр
+        auto read = [&](void* dst, size_t len){
+            if (reader.buffered() < len)
+                writer.flush();
+            reader.readExact(dst, len);
+        };
+        try {
+            for (;;) {
+                uint32_t count;
+                read(&count, sizeof(count));
+                for (uint32_t i = 0; i < count; i++) {
+                    uint32_t size;
+                    read(&size, sizeof(size));
+                    NeumaierSum sum;
+                    // Длинный вектор читается частями, чтобы не держать его в памяти
+                    for (uint32_t done = 0; done < size;) {
+                        size_t part = min<size_t>(size - done, LOCAL_SERVER_CHUNK);
+                        elements.resize(part);
+                        read(elements.data(), part * sizeof(double));
+                        for (double x : elements)
+                            sum.add(x);
+                        done += part;
+                    }
+                    double result = sum.value();
+                    writer.write(&result, sizeof(result));
+                    vectors++;
+                }
+            }
+        } catch (const system_error&) {
+        }
+    }
+    lock_guard<mutex> lock(m);
+    clients.erase(find(clients.begin(), clients.end(), s));
+    close(s);
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <system_error>
+#include "errno.h"
+using namespace std;
+
+#define AUTH_ERR "ERR"            ///< Отказ в аутентификации
+#define LOCAL_SERVER_CHUNK 65536  ///< Наибольшее количество элементов вектора, читаемых за раз
+
+/**
+ * @class LocalServer
+ * @brief Локальный сервер векторов с протоколом настоящего сервера
+ * @details Слушает адрес 127.0.0.1 и на каждом подключении проводит
+ * аутентификацию, как настоящий сервер: принимает логин, отправляет
+ * случайную соль, сверяет MD5-хеш клиента с auth(соль, пароль) и отвечает
+ * "OK" (при неверных логине или хеше - "ERR" и закрытие подключения).
+ * Затем на каждое задание (количество векторов, для каждого размер и
+ * элементы) отвечает суммой элементов каждого вектора. Ответы
+ * накапливаются и отправляются, когда в сокете нет новых данных клиента.
+ * Каждое подключение обслуживается своим потоком. Нужен для измерения
+ * производительности клиента без внешнего сервера.
+ */
+class LocalServer {
+private:
+    string login;           ///< Ожидаемый логин
+    string pass;            ///< Пароль пользователя
+    int listener;           ///< Слушающий сокет
+    uint16_t bound;         ///< Порт, на котором слушает сервер
+    thread acceptor;        ///< Поток приёма подключений
+    mutex m;                ///< Мьютекс для защиты списков подключений
+    vector<thread> threads; ///< Потоки обслуживания подключений
+    vector<int> clients;    ///< Открытые подключения
+    atomic<uint64_t> vectors{0}; ///< Обработано векторов
+
+    /**
+     * @brief Обслуживание подключения до его закрытия клиентом
+     * @param[in] s Дескриптор подключения
+     */
+    void serve(int s);
+
+    /**
+     * @brief Аутентификация клиента
+     * @param[in] s Дескриптор подключения
+     * @return true если клиент прошёл аутентификацию
+     */
+    bool authenticate(int s);
+
+public:
+    /**
+     * @brief Конструктор: запуск сервера
+     * @param[in] login Логин пользователя
+     * @param[in] pass Пароль пользователя
+     * @param[in] port Порт (0 - свободный порт, выбранный системой)
+     * @throw system_error при ошибках создания слушающего сокета
+     */
+    LocalServer(const string& login, const string& pass, uint16_t port = 0);
+
+    /**
+     * @brief Деструктор: закрытие подключений и остановка потоков
+     */
+    ~LocalServer();
+
+    LocalServer(const LocalServer&) = delete;
+    LocalServer& operator=(const LocalServer&) = delete;
+
+    /**
+     * @brief Порт сервера
+     * @return Порт, на котором сервер принимает подключения
+     */
+    uint16_t port() const {
+        return bound;
+    }
+
+    /**
+     * @brief Количество обработанных векторов
+     * @return Векторов, на которые отправлен ответ, за всё время работы
+     */
+    uint64_t served() const {
+        return vectors.load();
+    }
+
+    /**
+     * @brief Количество принятых подключений
+     * @return Подключений, принятых за всё время работы
+     */
+    size_t connections();
+};
@@ -0,0 +1,284 @@
+#include "local_sum.h"
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LOCAL_SUM_X86 ///< Доступны ядра AVX2 и AVX-512
+#endif
+
+/**
+ * @brief Ядро суммирования: добавляет сумму элементов к итогу
+ */
+typedef void (*SumKernel)(const char* x, size_t n, NeumaierSum& total);
+
+/**
+ * @brief Чтение элемента без требований к выравниванию
+ * @param[in] x Элементы
+ * @param[in] i Номер элемента
+ * @return Элемент
+ */
+static inline double load(const char* x, size_t i)
+{
+    double v;
+    memcpy(&v, x + i * sizeof(double), sizeof(v));
+    return v;
+}
+
+/**
+ * @brief Быстрое суммирование без векторных инструкций
+ * @param[in] x Элементы (без требований к выравниванию)
+ * @param[in] n Количество элементов
+ * @param[in,out] total Итог
+ * @details Четыре независимые суммы не ждут друг друга на конвейере сложения
+ */
+static void fastScalar(const char* x, size_t n, NeumaierSum& total)
+{
+    double s[4] = {0, 0, 0, 0};
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s[0] += load(x, i);
+        s[1] += load(x, i + 1);
+        s[2] += load(x, i + 2);
+        s[3] += load(x, i + 3);
+    }
+    for (; i < n; i++)
+        s[0] += load(x, i);
+    total.add((s[0] + s[1]) + (s[2] + s[3]));
+}
+
+/**
+ * @brief Компенсированное суммирование без векторных инструкций
+ * @param[in] x Элементы (без требований к выравниванию)
+ * @param[in] n Количество элементов
+ * @param[in,out] total Итог
+ */
+static void compensatedScalar(const char* x, size_t n, NeumaierSum& total)
+{
+    for (size_t i = 0; i < n; i++)
+        total.add(load(x, i));
+}
+
+#ifdef LOCAL_SUM_X86
+/**
+ * @brief Сложение с точной ошибкой в дорожках AVX2 (TwoSum Кнута)
+ * @param[in,out] s Суммы дорожек
+ * @param[in,out] c Накопленные ошибки дорожек
+ * @param[in] x Слагаемые
+ * @details В отличие от NeumaierSum не требует сравнения модулей, поэтому
+ * обходится без ветвлений
+ */
+__attribute__((target("avx2"))) static inline void twoSum(__m256d& s, __m256d& c, __m256d x)
+{
+    __m256d t = _mm256_add_pd(s, x);
+    __m256d z = _mm256_sub_pd(t, s);
+    __m256d e = _mm256_add_pd(_mm256_sub_pd(s, _mm256_sub_pd(t, z)), _mm256_sub_pd(x, z));
+    c = _mm256_add_pd(c, e);
+    s = t;
+}
+
+/**
+ * @brief Быстрое суммирование AVX2
+ * @param[in] x Элементы (без требований к выравниванию)
+ * @param[in] n Количество элементов
+ * @param[in,out] total Итог
+ */
+__attribute__((target("avx2"))) static void fastAvx2(const char* x, size_t n, NeumaierSum& total)
+{
+    __m256d s0 = _mm256_setzero_pd(), s1 = s0, s2 = s0, s3 = s0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        s0 = _mm256_add_pd(s0, _mm256_loadu_pd(reinterpret_cast<const double*>(x) + i));
+        s1 = _mm256_add_pd(s1, _mm256_loadu_pd(reinterpret_cast<const double*>(x) + i + 4));
+        s2 = _mm256_add_pd(s2, _mm256_loadu_pd(reinterpret_cast<const double*>(x) + i + 8));
+        s3 = _mm256_add_pd(s3, _mm256_loadu_pd(reinterpret_cast<const double*>(x) + i + 12));
+    }
+    for (; i + 4 <= n; i += 4)
+        s0 = _mm256_add_pd(s0, _mm256_loadu_pd(reinterpret_cast<const double*>(x) + i));
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(_mm256_add_pd(s0, s1), _mm256_add_pd(s2, s3)));
+    double s = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < n; i++)
+        s += load(x, i);
+    total.add(s);
+}
+
+/**
+ * @brief Компенсированное суммирование AVX2
+ * @param[in] x Элементы (без требований к выравниванию)
+ * @param[in] n Количество элементов
+ * @param[in,out] total Итог
+ */
+__attribute__((target("avx2"))) static void compensatedAvx2(const char* x, size_t n, NeumaierSum& total)
+{
+    __m256d s0 = _mm256_setzero_pd(), c0 = s0, s1 = s0, c1 = s0;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        twoSum(s0, c0, _mm256_loadu_pd(reinterpret_cast<const double*>(x) + i));
+        twoSum(s1, c1, _mm256_loadu_pd(reinterpret_cast<const double*>(x) + i + 4));
+    }
+    for (; i + 4 <= n; i += 4)
+        twoSum(s0, c0, _mm256_loadu_pd(reinterpret_cast<const double*>(x) + i));
+    double sums[8], errors[8];
+    _mm256_storeu_pd(sums, s0);
+    _mm256_storeu_pd(sums + 4, s1);
+    _mm256_storeu_pd(errors, c0);
+    _mm256_storeu_pd(errors + 4, c1);
+    for (int k = 0; k < 8; k++)
+        total.add(sums[k]);
+    for (int k = 0; k < 8; k++)
+        total.add(errors[k]);
+    for (; i < n; i++)
+        total.add(load(x, i));
+}
+
+/**
+ * @brief Сложение с точной ошибкой в дорожках AVX-512 (TwoSum Кнута)
+ * @param[in,out] s Суммы дорожек
+ * @param[in,out] c Накопленные ошибки дорожек
+ * @param[in] x Слагаемые
+ */
+__attribute__((target("avx512f"))) static inline void twoSum(__m512d& s, __m512d& c, __m512d x)
+{
+    __m512d t = _mm512_add_pd(s, x);
+    __m512d z = _mm512_sub_pd(t, s);
+    __m512d e = _mm512_add_pd(_mm512_sub_pd(s, _mm512_sub_pd(t, z)), _mm512_sub_pd(x, z));
+    c = _mm512_add_pd(c, e);
+    s = t;
+}
+
+/**
+ * @brief Быстрое суммирование AVX-512
+ * @param[in] x Элементы (без требований к выравниванию)
+ * @param[in] n Количество элементов
+ * @param[in,out] total Итог
+ */
+__attribute__((target("avx512f"))) static void fastAvx512(const char* x, size_t n, NeumaierSum& total)
+{
+    __m512d s0 = _mm512_setzero_pd(), s1 = s0, s2 = s0, s3 = s0;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        s0 = _mm512_add_pd(s0, _mm512_loadu_pd(reinterpret_cast<const double*>(x) + i));
+        s1 = _mm512_add_pd(s1, _mm512_loadu_pd(reinterpret_cast<const double*>(x) + i + 8));
+        s2 = _mm512_add_pd(s2, _mm512_loadu_pd(reinterpret_cast<const double*>(x) + i + 16));
+        s3 = _mm512_add_pd(s3, _mm512_loadu_pd(reinterpret_cast<const double*>(x) + i + 24));
+    }
+    for (; i + 8 <= n; i += 8)
+        s0 = _mm512_add_pd(s0, _mm512_loadu_pd(reinterpret_cast<const double*>(x) + i));
+    double lanes[8];
+    _mm512_storeu_pd(lanes, _mm512_add_pd(_mm512_add_pd(s0, s1), _mm512_add_pd(s2, s3)));
+    double s = ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+    for (; i < n; i++)
+        s += load(x, i);
+    total.add(s);
+}
+
+/**
+ * @brief Компенсированное суммирование AVX-512
+ * @param[in] x Элементы (без требований к выравниванию)
+ * @param[in] n Количество элементов
+ * @param[in,out] total Итог
+ */
+__attribute__((target("avx512f"))) static void compensatedAvx512(const char* x, size_t n, NeumaierSum& total)
+{
+    __m512d s0 = _mm512_setzero_pd(), c0 = s0, s1 = s0, c1 = s0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        twoSum(s0, c0, _mm512_loadu_pd(reinterpret_cast<const double*>(x) + i));
+        twoSum(s1, c1, _mm512_loadu_pd(reinterpret_cast<const double*>(x) + i + 8));
+    }
+    for (; i + 8 <= n; i += 8)
+        twoSum(s0, c0, _mm512_loadu_pd(reinterpret_cast<const double*>(x) + i));
+    double sums[16], errors[16];
+    _mm512_storeu_pd(sums, s0);
+    _mm512_storeu_pd(sums + 8, s1);
+    _mm512_storeu_pd(errors, c0);
+    _mm512_storeu_pd(errors + 8, c1);
+    for (int k = 0; k < 16; k++)
+        total.add(sums[k]);
+    for (int k = 0; k < 16; k++)
+        total.add(errors[k]);
+    for (; i < n; i++)
+        total.add(load(x, i));
+}
+#endif
+
+/**
+ * @brief Ядра по набору инструкций и режиму
+ */
+static const SumKernel KERNELS[3][2] = {
+    {fastScalar, compensatedScalar},
+#ifdef LOCAL_SUM_X86
+    {fastAvx2, compensatedAvx2},
+    {fastAvx512, compensatedAvx512},
+#else
+    {fastScalar, compensatedScalar},
+    {fastScalar, compensatedScalar},
+#endif
+};
+
+/**
+ * @brief Определение наилучшего набора инструкций
+ * @return Набор инструкций
+ */
+static SumIsa detect()
+{
+#ifdef LOCAL_SUM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return SumIsa::Avx512;
+    if (__builtin_cpu_supports("avx2"))
+        return SumIsa::Avx2;
+#endif
+    return SumIsa::Scalar;
+}
+
+/**
+ * @brief Наилучший набор инструкций, поддерживаемый процессором
+ * @return Набор инструкций, ядро которого используется по умолчанию
+ */
+SumIsa LocalSum::best()
+{
+    static const SumIsa isa = detect(); ///< Определяется при первом вызове
+    return isa;
+}
+
+/**
+ * @brief Имя набора инструкций
+ * @param[in] isa Набор инструкций
+ * @return Имя для вывода
+ */
+const char* LocalSum::name(SumIsa isa)
+{
+    switch (isa) {
+    case SumIsa::Avx512:
+        return "avx512";
+    case SumIsa::Avx2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
+
+/**
+ * @brief Добавление части элементов вектора
+ * @param[in] x Элементы (без требований к выравниванию)
+ * @param[in] n Количество элементов
+ */
+void LocalSum::add(const void* x, size_t n)
+{
+    KERNELS[size_t(best())][size_t(mode)](static_cast<const char*>(x), n, total);
+}
+
+/**
+ * @brief Сумма элементов выбранным ядром
+ * @param[in] x Элементы (без требований к выравниванию)
+ * @param[in] n Количество элементов
+ * @param[in] mode Режим суммирования
+ * @param[in] isa Набор инструкций (не выше best())
+ * @return Сумма
+ */
+double LocalSum::sum(const void* x, size_t n, SumMode mode, SumIsa isa)
+{
+    NeumaierSum total;
+    KERNELS[size_t(isa)][size_t(mode)](static_cast<const char*>(x), n, total);
+    return total.value();
+}
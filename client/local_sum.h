@@ -0,0 +1,87 @@
+#pragma once
+#include "summation.h"
+#include <cstddef>
+#include <cstdint>
+using namespace std;
+
+/**
+ * @enum SumMode
+ * @brief Режим локального суммирования
+ */
+enum class SumMode {
+    Fast,        ///< Несколько независимых сумм без поправок (быстрее, погрешность растёт с длиной)
+    Compensated  ///< Сумма и поправка в каждой дорожке (погрешность не растёт с длиной)
+};
+
+/**
+ * @enum SumIsa
+ * @brief Набор инструкций ядра суммирования
+ */
+enum class SumIsa {
+    Scalar, ///< Без векторных инструкций
+    Avx2,   ///< AVX2: 4 double в регистре
+    Avx512  ///< AVX-512F: 8 double в регистре
+};
+
+/**
+ * @class LocalSum
+ * @brief Локальное вычисление суммы элементов вектора, как на сервере
+ * @details Ядро выбирается один раз при запуске по возможностям процессора
+ * (AVX-512F, AVX2 или без векторных инструкций); все ядра собираются в
+ * одном исполняемом файле с атрибутами target, поэтому флаги -m для всей
+ * сборки не нужны. Ядро возвращает сумму и поправку, которые добавляются
+ * к итогу компенсированным суммированием, поэтому вектор можно передавать
+ * частями (например, по мере разбора) без потери точности между частями.
+ * Элементы могут быть не выровнены: кадры двоичного файла начинаются со
+ * смещения, кратного только размеру uint32_t.
+ */
+class LocalSum {
+private:
+    NeumaierSum total; ///< Сумма уже переданных частей
+    SumMode mode;      ///< Режим суммирования
+
+public:
+    /**
+     * @brief Конструктор
+     * @param[in] mode Режим суммирования
+     */
+    explicit LocalSum(SumMode mode = SumMode::Compensated) : mode(mode) {}
+
+    /**
+     * @brief Добавление части элементов вектора
+     * @param[in] x Элементы (без требований к выравниванию)
+     * @param[in] n Количество элементов
+     */
+    void add(const void* x, size_t n);
+
+    /**
+     * @brief Сумма переданных элементов
+     * @return Сумма
+     */
+    double value() const {
+        return total.value();
+    }
+
+    /**
+     * @brief Сумма элементов выбранным ядром
+     * @param[in] x Элементы (без требований к выравниванию)
+     * @param[in] n Количество элементов
+     * @param[in] mode Режим суммирования
+     * @param[in] isa Набор инструкций (не выше best())
+     * @return Сумма
+     */
+    static double sum(const void* x, size_t n, SumMode mode, SumIsa isa);
+
+    /**
+     * @brief Наилучший набор инструкций, поддерживаемый процессором
+     * @return Набор инструкций, ядро которого используется по умолчанию
+     */
+    static SumIsa best();
+
+    /**
+     * @brief Имя набора инструкций
+     * @param[in] isa Набор инструкций
+     * @return Имя для вывода
+     */
+    static const char* name(SumIsa isa);
+};
@@ -1,5 +1,37 @@
-#include "connection.h"
+#include "client.h"
+#include "daemon.h"
 #include "interface.h"
+#include "metrics.h"
+#include "trace.h"
+#include <csignal>
+
+/**
+ * @brief Выполнение задания или работа в режиме службы
+ * @param[in] params Указатель на параметры командной строки
+ * @return Код возврата
+ */
+static int run(const Params* params)
+{
+    if (params->Daemon)
+        return Daemon(params).run();
+    if (params->Offline)
+        return Connection::offline(params);
+    Client client(params);
+    return client.run(params);
+}
+
+/**
+ * @brief Запись метрик и трассировки, если они включены
+ * @param[in] params Указатель на параметры командной строки
+ * @throw system_error при ошибках записи
+ */
+static void report(const Params* params)
+{
+    if (Metrics* metrics = Metrics::active())
+        metrics->save(params->MetricsFile, params->MetricsFormat == "prometheus");
+    if (Tracer* tracer = Tracer::active())
+        tracer->save(params->TraceFile);
+}
 
 /**
  * @brief Главная функция приложения
@@ -10,6 +42,8 @@
  * - Парсинг параметров командной строки
  * - Проверку корректности параметров
  * - Установку соединения с сервером и обработку данных
+ * (в режиме службы - выполнение заданий по открытым сессиям)
+ * - Запись метрик и трассировки при завершении, если заданы --metrics и --trace
  */
 int main(int argc, const char** argv)
 {
@@ -21,9 +55,28 @@ int main(int argc, const char** argv)
         return 1;
     }
     
+    // Разрыв соединения во время sendfile обрабатывается как ошибка EPIPE,
+    // а не завершением процесса сигналом
+    signal(SIGPIPE, SIG_IGN);
+
     // Получение параметров и установка соединения
     Params params = interface.getParams();
-    Connection::conn(&params);
-    
-    return 0;
+    if (params.MetricsFile.empty() && params.TraceFile.empty())
+        return run(&params);
+
+    // Метрики и трасса записываются и после ошибки: по ним видно, на каком
+    // этапе и на каком векторе она случилась
+    if (!params.MetricsFile.empty())
+        Metrics::enable();
+    if (!params.TraceFile.empty())
+        Tracer::enable();
+    int rc;
+    try {
+        rc = run(&params);
+    } catch (...) {
+        report(&params);
+        throw;
+    }
+    report(&params);
+    return rc;
 }
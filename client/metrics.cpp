@@ -0,0 +1,200 @@
+#include "metrics.h"
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+Metrics* Metrics::instance = nullptr;
+
+/**
+ * @brief Имена этапов в выводе метрик
+ */
+static const char* const PHASE_NAMES[size_t(Phase::Count)] = {"connect", "handshake", "parse", "send", "wait"};
+
+/**
+ * @brief Номер корзины значения
+ * @param[in] value Значение
+ * @return Номер корзины
+ */
+size_t LatencyHistogram::bucket(uint64_t value)
+{
+    if (value < HISTOGRAM_SUB_COUNT)
+        return value;
+    int exponent = 63 - countl_zero(value); ///< Номер старшего бита, не меньше HISTOGRAM_SUB_BITS
+    int shift = exponent - HISTOGRAM_SUB_BITS; ///< Ширина корзины - 2^shift
+    return size_t(shift + 1) * HISTOGRAM_SUB_COUNT + ((value >> shift) - HISTOGRAM_SUB_COUNT);
+}
+
+/**
+ * @brief Наименьшее значение корзины
+ * @param[in] index Номер корзины
+ * @return Нижняя граница корзины
+ */
+uint64_t LatencyHistogram::lowest(size_t index)
+{
+    if (index < HISTOGRAM_SUB_COUNT)
+        return index;
+    int shift = int(index / HISTOGRAM_SUB_COUNT) - 1;
+    return (uint64_t(HISTOGRAM_SUB_COUNT) + index % HISTOGRAM_SUB_COUNT) << shift;
+}
+
+/**
+ * @brief Добавление значения
+ * @param[in] value Значение
+ */
+void LatencyHistogram::record(uint64_t value)
+{
+    buckets[bucket(value)].fetch_add(1, memory_order_relaxed);
+    counted.fetch_add(1, memory_order_relaxed);
+    summed.fetch_add(value, memory_order_relaxed);
+    uint64_t seen = largest.load(memory_order_relaxed);
+    while (value > seen && !largest.compare_exchange_weak(seen, value, memory_order_relaxed))
+        ;
+}
+
+/**
+ * @brief Перцентиль значений
+ * @param[in] percentile Перцентиль (0-100)
+ * @return Верхняя граница корзины, в которую попадает перцентиль
+ * (не больше наибольшего значения); 0 для пустой гистограммы
+ */
+uint64_t LatencyHistogram::percentile(double percentile) const
+{
+    uint64_t total = count();
+    if (total == 0)
+        return 0;
+    uint64_t rank = std::max<uint64_t>(1, uint64_t(percentile / 100 * total + 0.5)); ///< Номер значения по возрастанию
+    uint64_t seen = 0; ///< Значений в пройденных корзинах
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += buckets[i].load(memory_order_relaxed);
+        if (seen >= rank)
+            return i + 1 < HISTOGRAM_BUCKETS ? std::min(lowest(i + 1) - 1, max()) : max();
+    }
+    return max();
+}
+
+/**
+ * @brief Конструктор: метрики начинают отсчёт времени работы
+ */
+Metrics::Metrics() : started(chrono::steady_clock::now())
+{
+}
+
+/**
+ * @brief Включение метрик процесса
+ */
+void Metrics::enable()
+{
+    static Metrics metrics; ///< Метрики процесса
+    instance = &metrics;
+}
+
+/**
+ * @brief Добавление времени этапа
+ * @param[in] phase Этап
+ * @param[in] elapsed Время этапа
+ */
+void Metrics::addPhase(Phase phase, chrono::steady_clock::duration elapsed)
+{
+    Timer& timer = phases[size_t(phase)];
+    timer.nanoseconds.fetch_add(chrono::duration_cast<chrono::nanoseconds>(elapsed).count(), memory_order_relaxed);
+    timer.count.fetch_add(1, memory_order_relaxed);
+}
+
+/**
+ * @brief Метрики в формате JSON
+ * @return Текст JSON-объекта
+ * @details Время этапов и работы - в секундах, время векторов - в микросекундах
+ */
+string Metrics::json() const
+{
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - started;
+    ostringstream out;
+    out << "{\n  \"elapsed_seconds\": " << elapsed.count() << ",\n  \"phases\": {";
+    for (size_t i = 0; i < size_t(Phase::Count); i++)
+        out << (i == 0 ? "" : ",") << "\n    \"" << PHASE_NAMES[i] << "\": {\"seconds\": "
+            << phases[i].nanoseconds.load(memory_order_relaxed) / 1e9 << ", \"count\": "
+            << phases[i].count.load(memory_order_relaxed) << "}";
+    out << "\n  },\n  \"bytes\": {\"sent\": " << bytesSent.load(memory_order_relaxed)
+        << ", \"received\": " << bytesReceived.load(memory_order_relaxed) << "},\n"
+        << "  \"syscalls\": {\"send\": " << sendCalls.load(memory_order_relaxed)
+        << ", \"recv\": " << recvCalls.load(memory_order_relaxed) << "},\n"
+        << "  \"vector_rtt_us\": {\"count\": " << rtt.count()
+        << ", \"mean\": " << (rtt.count() == 0 ? 0 : rtt.sum() / 1e3 / rtt.count())
+        << ", \"p50\": " << rtt.percentile(50) / 1e3 << ", \"p90\": " << rtt.percentile(90) / 1e3
+        << ", \"p99\": " << rtt.percentile(99) / 1e3 << ", \"p999\": " << rtt.percentile(99.9) / 1e3
+        << ", \"max\": " << rtt.max() / 1e3 << "}\n}\n";
+    return out.str();
+}
+
+/**
+ * @brief Метрики в текстовом формате Prometheus
+ * @return Текст метрик
+ * @details Время векторов выводится гистограммой с границами непустых
+ * корзин, поэтому её точность та же, что у LatencyHistogram
+ */
+string Metrics::prometheus() const
+{
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - started;
+    ostringstream out;
+    out << "# HELP " METRICS_PREFIX "elapsed_seconds Время работы клиента\n"
+        << "# TYPE " METRICS_PREFIX "elapsed_seconds gauge\n"
+        << METRICS_PREFIX "elapsed_seconds " << elapsed.count() << "\n"
+        << "# HELP " METRICS_PREFIX "phase_seconds_total Время этапов, суммарно по потокам\n"
+        << "# TYPE " METRICS_PREFIX "phase_seconds_total counter\n";
+    for (size_t i = 0; i < size_t(Phase::Count); i++)
+        out << METRICS_PREFIX "phase_seconds_total{phase=\"" << PHASE_NAMES[i] << "\"} "
+            << phases[i].nanoseconds.load(memory_order_relaxed) / 1e9 << "\n";
+    out << "# HELP " METRICS_PREFIX "phase_calls_total Количество замеров этапов\n"
+        << "# TYPE " METRICS_PREFIX "phase_calls_total counter\n";
+    for (size_t i = 0; i < size_t(Phase::Count); i++)
+        out << METRICS_PREFIX "phase_calls_total{phase=\"" << PHASE_NAMES[i] << "\"} "
+            << phases[i].count.load(memory_order_relaxed) << "\n";
+    out << "# HELP " METRICS_PREFIX "bytes_total Байт через сокеты\n"
+        << "# TYPE " METRICS_PREFIX "bytes_total counter\n"
+        << METRICS_PREFIX "bytes_total{direction=\"sent\"} " << bytesSent.load(memory_order_relaxed) << "\n"
+        << METRICS_PREFIX "bytes_total{direction=\"received\"} " << bytesReceived.load(memory_order_relaxed) << "\n"
+        << "# HELP " METRICS_PREFIX "syscalls_total Системных вызовов обмена\n"
+        << "# TYPE " METRICS_PREFIX "syscalls_total counter\n"
+        << METRICS_PREFIX "syscalls_total{call=\"send\"} " << sendCalls.load(memory_order_relaxed) << "\n"
+        << METRICS_PREFIX "syscalls_total{call=\"recv\"} " << recvCalls.load(memory_order_relaxed) << "\n"
+        << "# HELP " METRICS_PREFIX "vector_rtt_seconds Время от отправки вектора до его результата\n"
+        << "# TYPE " METRICS_PREFIX "vector_rtt_seconds histogram\n";
+    uint64_t cumulative = 0; ///< Значений в пройденных корзинах
+    for (size_t i = 0; i + 1 < HISTOGRAM_BUCKETS && cumulative < rtt.count(); i++) {
+        uint64_t n = rtt.bucketCount(i);
+        if (n == 0)
+            continue;
+        cumulative += n;
+        out << METRICS_PREFIX "vector_rtt_seconds_bucket{le=\"" << LatencyHistogram::lowest(i + 1) / 1e9 << "\"} "
+            << cumulative << "\n";
+    }
+    out << METRICS_PREFIX "vector_rtt_seconds_bucket{le=\"+Inf\"} " << rtt.count() << "\n"
+        << METRICS_PREFIX "vector_rtt_seconds_sum " << rtt.sum() / 1e9 << "\n"
+        << METRICS_PREFIX "vector_rtt_seconds_count " << rtt.count() << "\n";
+    return out.str();
+}
+
+/**
+ * @brief Запись метрик в файл
+ * @param[in] path Путь к файлу ("-" - стандартный вывод)
+ * @param[in] prometheus Формат Prometheus вместо JSON
+ * @throw system_error при ошибках записи
+ */
+void Metrics::save(const string& path, bool prometheus) const
+{
+    string text = prometheus ? this->prometheus() : json();
+    if (path == "-") {
+        cout << text << flush;
+        return;
+    }
+    ofstream out(path, ios::trunc);
+    if (!out.is_open())
+        throw system_error(errno, generic_category());
+    out << text;
+    out.close();
+    if (out.fail())
+        throw system_error(EIO, generic_category());
+}
@@ -0,0 +1,245 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include "errno.h"
+using namespace std;
+
+#define HISTOGRAM_SUB_BITS 5  ///< Двоичный логарифм количества поддиапазонов степени двойки (точность около 3%)
+#define HISTOGRAM_SUB_COUNT (1 << HISTOGRAM_SUB_BITS) ///< Количество поддиапазонов степени двойки
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT) ///< Количество корзин гистограммы
+#define METRICS_PREFIX "client_" ///< Префикс имён метрик Prometheus
+
+/**
+ * @enum Phase
+ * @brief Этапы работы клиента, время которых измеряется
+ */
+enum class Phase {
+    Connect,   ///< Установка TCP-соединения
+    Handshake, ///< Обмен логином, солью и хешем
+    Parse,     ///< Ожидание разобранных элементов текстового файла
+    Send,      ///< Запись в сокет
+    Wait,      ///< Ожидание данных сервера (recv, epoll_wait)
+    Count      ///< Количество этапов
+};
+
+/**
+ * @class LatencyHistogram
+ * @brief Гистограмма времён с логарифмическими корзинами (как в HdrHistogram)
+ * @details Значения меньше HISTOGRAM_SUB_COUNT хранятся точно, каждая
+ * следующая степень двойки делится на HISTOGRAM_SUB_COUNT равных корзин,
+ * поэтому относительная погрешность не превышает 1/HISTOGRAM_SUB_COUNT
+ * во всём диапазоне uint64. Запись - одно атомарное сложение без
+ * блокировок, поэтому значения можно добавлять из разных потоков.
+ */
+class LatencyHistogram {
+private:
+    atomic<uint64_t> buckets[HISTOGRAM_BUCKETS] = {}; ///< Количество значений в корзинах
+    atomic<uint64_t> counted{0}; ///< Количество значений
+    atomic<uint64_t> summed{0};  ///< Сумма значений
+    atomic<uint64_t> largest{0}; ///< Наибольшее значение
+
+public:
+    /**
+     * @brief Номер корзины значения
+     * @param[in] value Значение
+     * @return Номер корзины
+     */
+    static size_t bucket(uint64_t value);
+
+    /**
+     * @brief Наименьшее значение корзины
+     * @param[in] index Номер корзины
+     * @return Нижняя граница корзины
+     */
+    static uint64_t lowest(size_t index);
+
+    /**
+     * @brief Добавление значения
+     * @param[in] value Значение
+     */
+    void record(uint64_t value);
+
+    /**
+     * @brief Количество значений
+     * @return Количество добавленных значений
+     */
+    uint64_t count() const {
+        return counted.load(memory_order_relaxed);
+    }
+
+    /**
+     * @brief Сумма значений
+     * @return Сумма добавленных значений
+     */
+    uint64_t sum() const {
+        return summed.load(memory_order_relaxed);
+    }
+
+    /**
+     * @brief Наибольшее значение
+     * @return Наибольшее добавленное значение
+     */
+    uint64_t max() const {
+        return largest.load(memory_order_relaxed);
+    }
+
+    /**
+     * @brief Количество значений в корзине
+     * @param[in] index Номер корзины
+     * @return Количество значений
+     */
+    uint64_t bucketCount(size_t index) const {
+        return buckets[index].load(memory_order_relaxed);
+    }
+
+    /**
+     * @brief Перцентиль значений
+     * @param[in] percentile Перцентиль (0-100)
+     * @return Верхняя граница корзины, в которую попадает перцентиль
+     * (не больше наибольшего значения); 0 для пустой гистограммы
+     */
+    uint64_t percentile(double percentile) const;
+};
+
+/**
+ * @class Metrics
+ * @brief Метрики работы клиента: время этапов, время векторов, байты и вызовы
+ * @details Экземпляр создаётся один раз на процесс вызовом enable() до
+ * начала работы, и места замеров обращаются к нему через active(). Пока
+ * метрики не включены, active() возвращает nullptr и замеры сводятся к
+ * одной проверке указателя: часы не читаются. Счётчики - атомарные
+ * переменные, которые обновляются без блокировок из любых потоков.
+ * Время этапов суммируется по всем потокам, поэтому этапы, идущие
+ * параллельно, могут в сумме превышать время работы.
+ */
+class Metrics {
+private:
+    /**
+     * @struct Timer
+     * @brief Суммарное время этапа
+     */
+    struct Timer {
+        atomic<uint64_t> nanoseconds{0}; ///< Суммарное время в наносекундах
+        atomic<uint64_t> count{0};       ///< Количество замеров
+    };
+
+    static Metrics* instance; ///< Метрики процесса или nullptr
+
+    chrono::steady_clock::time_point started; ///< Время включения метрик
+    Timer phases[size_t(Phase::Count)];       ///< Время этапов
+    atomic<uint64_t> bytesSent{0};      ///< Отправлено байт
+    atomic<uint64_t> bytesReceived{0};  ///< Принято байт
+    atomic<uint64_t> sendCalls{0};      ///< Вызовов отправки (send, sendmsg, sendfile)
+    atomic<uint64_t> recvCalls{0};      ///< Вызовов приёма (recv)
+    LatencyHistogram rtt;               ///< Время от отправки вектора до его результата в наносекундах
+
+    Metrics();
+
+public:
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    /**
+     * @brief Включение метрик процесса
+     * @details Вызывается до запуска потоков; повторный вызов ничего не меняет
+     */
+    static void enable();
+
+    /**
+     * @brief Метрики процесса
+     * @return Метрики или nullptr, если они не включены
+     */
+    static Metrics* active() {
+        return instance;
+    }
+
+    /**
+     * @brief Добавление времени этапа
+     * @param[in] phase Этап
+     * @param[in] elapsed Время этапа
+     */
+    void addPhase(Phase phase, chrono::steady_clock::duration elapsed);
+
+    /**
+     * @brief Учёт вызова отправки
+     * @param[in] bytes Отправлено байт (0 при ошибке)
+     */
+    void sent(size_t bytes) {
+        sendCalls.fetch_add(1, memory_order_relaxed);
+        bytesSent.fetch_add(bytes, memory_order_relaxed);
+    }
+
+    /**
+     * @brief Учёт вызова приёма
+     * @param[in] bytes Принято байт (0 при ошибке)
+     */
+    void received(size_t bytes) {
+        recvCalls.fetch_add(1, memory_order_relaxed);
+        bytesReceived.fetch_add(bytes, memory_order_relaxed);
+    }
+
+    /**
+     * @brief Учёт времени вектора
+     * @param[in] elapsed Время от отправки вектора до получения результата
+     */
+    void addRtt(chrono::steady_clock::duration elapsed) {
+        rtt.record(chrono::duration_cast<chrono::nanoseconds>(elapsed).count());
+    }
+
+    /**
+     * @brief Метрики в формате JSON
+     * @return Текст JSON-объекта
+     */
+    string json() const;
+
+    /**
+     * @brief Метрики в текстовом формате Prometheus
+     * @return Текст метрик
+     */
+    string prometheus() const;
+
+    /**
+     * @brief Запись метрик в файл
+     * @param[in] path Путь к файлу ("-" - стандартный вывод)
+     * @param[in] prometheus Формат Prometheus вместо JSON
+     * @throw system_error при ошибках записи
+     */
+    void save(const string& path, bool prometheus) const;
+};
+
+/**
+ * @class PhaseTimer
+ * @brief Замер времени этапа от создания до уничтожения объекта
+ * @details Если метрики не включены, часы не читаются
+ */
+class PhaseTimer {
+private:
+    Metrics* metrics;                         ///< Метрики или nullptr
+    Phase phase;                              ///< Этап
+    chrono::steady_clock::time_point start;   ///< Начало замера
+
+public:
+    /**
+     * @brief Конструктор: начало замера
+     * @param[in] phase Этап
+     */
+    explicit PhaseTimer(Phase phase) : metrics(Metrics::active()), phase(phase) {
+        if (metrics != nullptr)
+            start = chrono::steady_clock::now();
+    }
+
+    /**
+     * @brief Деструктор: учёт времени этапа
+     */
+    ~PhaseTimer() {
+        if (metrics != nullptr)
+            metrics->addPhase(phase, chrono::steady_clock::now() - start);
+    }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+};
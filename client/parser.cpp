@@ -0,0 +1,242 @@
+#include "parser.h"
+#include "metrics.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <exception>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @brief Проверка символа-разделителя (как для operator>> потока)
+ * @param[in] c Символ
+ * @return true для пробельных символов
+ */
+static inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/**
+ * @brief Разбор всех чисел из диапазона текста
+ * @param[in] begin Начало диапазона (на границе числа)
+ * @param[in] end Конец диапазона (на границе числа)
+ * @param[out] out Массив для разобранных чисел
+ * @param[out] notCounts Индексы в out целых чисел, которые from_chars не
+ * разбирает в uint32_t целиком (5.0, 5e0, -0): они не могут быть размерами
+ * @return false если встретилась некорректная запись числа
+ * @details Запись проверяется только у целых чисел из диапазона uint32_t,
+ * поэтому дробные элементы разбираются без дополнительной работы
+ */
+static bool parseRange(const char* begin, const char* end, vector<double>& out, vector<size_t>& notCounts)
+{
+    // Оценка по типичной записи; при более коротких числах массив дорастёт
+    out.reserve((end - begin) / PARSER_BYTES_PER_TOKEN + 1);
+    const char* p = begin;
+    for (;;) {
+        while (p < end && isSpace(*p))
+            p++;
+        if (p == end)
+            return true;
+        // from_chars не принимает ведущий '+', в отличие от operator>>;
+        // знак после '+' и inf/nan, которые operator>> отвергает, - ошибка
+        if (*p == '+' && ++p < end && *p == '-')
+            return false;
+        double v;
+        auto res = from_chars(p, end, v);
+        if (res.ec != errc() || (res.ptr < end && !isSpace(*res.ptr)) || !isfinite(v))
+            return false;
+        if (v >= 0 && v <= UINT32_MAX && v == floor(v)) {
+            uint32_t count;
+            auto whole = from_chars(p, res.ptr, count);
+            if (whole.ec != errc() || whole.ptr != res.ptr)
+                notCounts.push_back(out.size());
+        }
+        out.push_back(v);
+        p = res.ptr;
+    }
+}
+
+/**
+ * @brief Конструктор
+ * @param[in] path Путь к файлу с векторами
+ * @param[in] threads Количество потоков разбора (0 - по числу ядер)
+ * @param[in] chunkSize Размер части участка для одного потока в байтах
+ * @throw system_error если файл не удаётся открыть или отобразить в память
+ */
+VectorParser::VectorParser(const string& path, unsigned threads, size_t chunkSize)
+    : threads(threads != 0 ? threads : max(1u, thread::hardware_concurrency())),
+      chunkSize(max<size_t>(chunkSize, 1))
+{
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        throw system_error(errno, generic_category());
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        int err = errno;
+        close(fd);
+        throw system_error(err, generic_category());
+    }
+    length = st.st_size;
+    if (length == 0)
+        return;
+    void* map = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        int err = errno;
+        close(fd);
+        throw system_error(err, generic_category());
+    }
+    madvise(map, length, MADV_SEQUENTIAL);
+    data = static_cast<const char*>(map);
+}
+
+/**
+ * @brief Деструктор: освобождает отображение и закрывает файл
+ */
+VectorParser::~VectorParser()
+{
+    if (data != nullptr)
+        munmap(const_cast<char*>(data), length);
+    if (fd != -1)
+        close(fd);
+}
+
+/**
+ * @brief Разбор следующего участка файла
+ * @return false если файл разобран полностью
+ * @throw system_error при некорректной записи числа
+ * @details Участок из threads частей по chunkSize байт; граница каждой части
+ * сдвигается до ближайшего пробельного символа, чтобы не разрезать число
+ */
+bool VectorParser::fillTokens()
+{
+    PhaseTimer timer(Phase::Parse);
+    tokens.clear();
+    notCounts.clear();
+    next = 0;
+    while (tokens.empty() && pos < length) {
+        // Границы частей участка
+        vector<size_t> bounds{pos};
+        for (unsigned t = 0; t < threads && bounds.back() < length; t++) {
+            size_t b = min(length, bounds.back() + chunkSize);
+            while (b < length && !isSpace(data[b]))
+                b++;
+            bounds.push_back(b);
+        }
+        pos = bounds.back();
+
+        // Параллельный разбор частей
+        size_t parts = bounds.size() - 1;
+        vector<vector<double>> parsed(parts);
+        vector<vector<size_t>> marked(parts);
+        vector<char> ok(parts, 1);
+        vector<thread> workers;
+        for (size_t t = 1; t < parts; t++)
+            workers.emplace_back([&, t]{
+                ok[t] = parseRange(data + bounds[t], data + bounds[t + 1], parsed[t], marked[t]);
+            });
+        ok[0] = parseRange(data + bounds[0], data + bounds[1], parsed[0], marked[0]);
+        for (thread& w : workers)
+            w.join();
+        if (find(ok.begin(), ok.end(), 0) != ok.end())
+            throw system_error(EINVAL, generic_category());
+
+        // Объединение результатов в порядке следования частей
+        size_t total = 0;
+        for (const vector<double>& part : parsed)
+            total += part.size();
+        tokens.reserve(total);
+        for (size_t t = 0; t < parts; t++) {
+            for (size_t i : marked[t])
+                notCounts.push_back(tokens.size() + i);
+            tokens.insert(tokens.end(), parsed[t].begin(), parsed[t].end());
+        }
+    }
+    return !tokens.empty();
+}
+
+/**
+ * @brief Чтение следующего числа
+ * @return Значение числа
+ * @throw system_error если файл закончился или число записано некорректно
+ */
+double VectorParser::nextToken()
+{
+    if (next == tokens.size() && !fillTokens())
+        throw system_error(ENODATA, generic_category());
+    return tokens[next++];
+}
+
+/**
+ * @brief Чтение неотрицательного целого, помещающегося в uint32_t
+ * @return Значение числа
+ * @throw system_error если число не является допустимым целым или
+ * записано не как целое (5.0, 5e0), как и при чтении operator>> в uint32_t
+ */
+uint32_t VectorParser::nextCount()
+{
+    double v = nextToken();
+    if (!(v >= 0 && v <= UINT32_MAX) || v != floor(v)
+        || binary_search(notCounts.begin(), notCounts.end(), next - 1))
+        throw system_error(EINVAL, generic_category());
+    return static_cast<uint32_t>(v);
+}
+
+/**
+ * @brief Чтение количества векторов (первое число файла)
+ * @return Количество векторов
+ * @throw system_error при некорректном формате файла
+ */
+uint32_t VectorParser::readCount()
+{
+    return nextCount();
+}
+
+/**
+ * @brief Чтение размера очередного вектора
+ * @return Количество элементов вектора
+ * @throw system_error при некорректном формате файла
+ */
+uint32_t VectorParser::readSize()
+{
+    return nextCount();
+}
+
+/**
+ * @brief Чтение элементов вектора
+ * @param[out] out Массив для элементов
+ * @param[in] count Количество элементов
+ * @throw system_error если файл закончился раньше или число записано некорректно
+ */
+void VectorParser::readElements(double* out, size_t count)
+{
+    while (count > 0) {
+        if (next == tokens.size() && !fillTokens())
+            throw system_error(ENODATA, generic_category());
+        size_t n = min(count, tokens.size() - next);
+        memcpy(out, tokens.data() + next, n * sizeof(double));
+        next += n;
+        out += n;
+        count -= n;
+    }
+}
+
+/**
+ * @brief Пропуск элементов вектора
+ * @param[in] count Количество элементов
+ * @throw system_error если файл закончился раньше или число записано некорректно
+ */
+void VectorParser::skipElements(size_t count)
+{
+    while (count > 0) {
+        if (next == tokens.size() && !fillTokens())
+            throw system_error(ENODATA, generic_category());
+        size_t n = min(count, tokens.size() - next);
+        next += n;
+        count -= n;
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <system_error>
+#include "errno.h"
+using namespace std;
+
+#define PARSER_CHUNK_SIZE (4 << 20) ///< Размер участка файла, разбираемого одним потоком за проход
+#define PARSER_BYTES_PER_TOKEN 8    ///< Оценка байт на число с разделителем для резервирования памяти
+
+/**
+ * @class VectorParser
+ * @brief Быстрый разбор текстового файла с векторами
+ * @details Файл отображается в память и разбирается при помощи from_chars.
+ * Очередной участок файла делится на части по границам пробельных символов,
+ * которые разбираются параллельно на всех ядрах. Формат файла: количество
+ * векторов, затем для каждого вектора его размер и элементы.
+ * Объём памяти ограничен одним участком и не зависит от размера файла.
+ */
+class VectorParser {
+private:
+    int fd = -1;                ///< Дескриптор входного файла
+    const char* data = nullptr; ///< Отображённое в память содержимое файла
+    size_t length = 0;          ///< Размер файла в байтах
+    size_t pos = 0;             ///< Смещение первого неразобранного байта
+    unsigned threads;           ///< Количество потоков разбора
+    size_t chunkSize;           ///< Размер части участка для одного потока
+    vector<double> tokens;      ///< Числа, разобранные из текущего участка
+    vector<size_t> notCounts;   ///< Индексы целых чисел участка, записанных не как uint32_t (5.0, 1e3, -0)
+    size_t next = 0;            ///< Индекс следующего непрочитанного числа
+
+    /**
+     * @brief Разбор следующего участка файла
+     * @return false если файл разобран полностью
+     * @throw system_error при некорректной записи числа
+     */
+    bool fillTokens();
+
+    /**
+     * @brief Чтение следующего числа
+     * @return Значение числа
+     * @throw system_error если файл закончился или число записано некорректно
+     */
+    double nextToken();
+
+    /**
+     * @brief Чтение неотрицательного целого, помещающегося в uint32_t
+     * @return Значение числа
+     * @throw system_error если число не является допустимым целым или
+     * записано не как целое (5.0, 5e0), как и при чтении operator>> в uint32_t
+     */
+    uint32_t nextCount();
+
+public:
+    /**
+     * @brief Конструктор
+     * @param[in] path Путь к файлу с векторами
+     * @param[in] threads Количество потоков разбора (0 - по числу ядер)
+     * @param[in] chunkSize Размер части участка для одного потока в байтах
+     * @throw system_error если файл не удаётся открыть или отобразить в память
+     */
+    explicit VectorParser(const string& path, unsigned threads = 0, size_t chunkSize = PARSER_CHUNK_SIZE);
+
+    /**
+     * @brief Деструктор: освобождает отображение и закрывает файл
+     */
+    ~VectorParser();
+
+    VectorParser(const VectorParser&) = delete;
+    VectorParser& operator=(const VectorParser&) = delete;
+
+    /**
+     * @brief Чтение количества векторов (первое число файла)
+     * @return Количество векторов
+     * @throw system_error при некорректном формате файла
+     */
+    uint32_t readCount();
+
+    /**
+     * @brief Чтение размера очередного вектора
+     * @return Количество элементов вектора
+     * @throw system_error при некорректном формате файла
+     */
+    uint32_t readSize();
+
+    /**
+     * @brief Чтение элементов вектора
+     * @param[out] out Массив для элементов
+     * @param[in] count Количество элементов
+     * @throw system_error если файл закончился раньше или число записано некорректно
+     */
+    void readElements(double* out, size_t count);
+
+    /**
+     * @brief Пропуск элементов вектора
+     * @param[in] count Количество элементов
+     * @throw system_error если файл закончился раньше или число записано некорректно
+     */
+    void skipElements(size_t count);
+};
@@ -0,0 +1,226 @@
+#include "result_cache.h"
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/**
+ * @struct CacheHeader
+ * @brief Заголовок файла кэша
+ */
+struct CacheHeader {
+    uint32_t magic;    ///< Признак файла
+    uint32_t reserved; ///< Не используется (выравнивание)
+    uint64_t count;    ///< Количество записей
+};
+
+/**
+ * @brief Конструктор: чтение файла кэша
+ * @param[in] path Путь к файлу кэша (отсутствующий файл - пустой кэш)
+ * @param[in] capacity Наибольшее количество записей
+ * @throw system_error при ошибках чтения, EINVAL если файл не является файлом кэша
+ * @details Пустой файл и файл прежнего формата (без длин кадров) считаются
+ * пустым кэшем. Если в файле больше записей, чем capacity, читаются
+ * недавно использованные
+ */
+ResultCache::ResultCache(const string& path, size_t capacity) : path(path), capacity(max<size_t>(1, capacity))
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        if (errno == ENOENT)
+            return;
+        throw system_error(errno, generic_category());
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        int err = errno;
+        close(fd);
+        throw system_error(err, generic_category());
+    }
+    CacheHeader header;                    ///< Заголовок файла
+    vector<Entry> stored;                  ///< Записи файла
+    size_t length = st.st_size;            ///< Размер файла
+    if (length == 0) {
+        close(fd);
+        return;
+    }
+    // Записи прежнего формата без длины кадра не защищены от коллизий:
+    // кэш начинается заново и заменяет их при сохранении
+    if (length >= sizeof(header) && pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header)
+        && header.magic == CACHE_MAGIC_OLD) {
+        close(fd);
+        return;
+    }
+    bool valid = length >= sizeof(header) && pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header)
+                 && header.magic == CACHE_MAGIC && (length - sizeof(header)) % sizeof(Entry) == 0
+                 && (length - sizeof(header)) / sizeof(Entry) == header.count;
+    if (valid) {
+        stored.resize(header.count);
+        size_t bytes = stored.size() * sizeof(Entry); ///< Размер записей в байтах
+        size_t done = 0;                              ///< Прочитано байт записей
+        while (done < bytes) {
+            ssize_t n = pread(fd, reinterpret_cast<char*>(stored.data()) + done, bytes - done, sizeof(header) + done);
+            if (n == -1 && errno == EINTR)
+                continue;
+            if (n <= 0) {
+                int err = n == 0 ? EINVAL : errno;
+                close(fd);
+                throw system_error(err, generic_category());
+            }
+            done += n;
+        }
+    }
+    close(fd);
+    if (!valid)
+        throw system_error(EINVAL, generic_category());
+    for (size_t i = 0; i < stored.size() && lru.size() < this->capacity; i++) {
+        if (entries.count(stored[i].key.hash))
+            continue;
+        lru.push_back(stored[i]);
+        entries.emplace(stored[i].key.hash, prev(lru.end()));
+    }
+}
+
+/**
+ * @brief Поиск результата
+ * @param[in] key Ключ кадра вектора
+ * @param[out] result Результат сервера
+ * @return true при попадании
+ */
+bool ResultCache::lookup(const Key& key, double& result)
+{
+    lock_guard<mutex> lock(m);
+    auto it = entries.find(key.hash);
+    if (it == entries.end() || it->second->key.length != key.length) {
+        missCount++;
+        return false;
+    }
+    // Запись становится недавно использованной
+    lru.splice(lru.begin(), lru, it->second);
+    result = it->second->result;
+    hitCount++;
+    return true;
+}
+
+/**
+ * @brief Добавление результата
+ * @param[in] key Ключ кадра вектора
+ * @param[in] result Результат сервера
+ */
+void ResultCache::insert(const Key& key, double result)
+{
+    lock_guard<mutex> lock(m);
+    changed = true;
+    auto it = entries.find(key.hash);
+    if (it != entries.end()) {
+        it->second->key = key;
+        it->second->result = result;
+        lru.splice(lru.begin(), lru, it->second);
+        return;
+    }
+    if (lru.size() == capacity) {
+        entries.erase(lru.back().key.hash);
+        lru.pop_back();
+        evictCount++;
+    }
+    lru.push_front({key, result});
+    entries.emplace(key.hash, lru.begin());
+}
+
+/**
+ * @brief Сохранение кэша в файл, если записи изменились
+ * @throw system_error при ошибках записи
+ * @details Файл заменяется через временный файл и rename, поэтому после
+ * сбоя остаётся прежний или новый кэш целиком
+ */
+void ResultCache::save()
+{
+    vector<char> data; ///< Содержимое файла
+    {
+        lock_guard<mutex> lock(m);
+        if (!changed)
+            return;
+        CacheHeader header = {CACHE_MAGIC, 0, lru.size()};
+        data.resize(sizeof(header) + lru.size() * sizeof(Entry));
+        char* out = data.data();
+        memcpy(out, &header, sizeof(header));
+        out += sizeof(header);
+        for (const Entry& e : lru) {
+            memcpy(out, &e, sizeof(e));
+            out += sizeof(e);
+        }
+        changed = false;
+    }
+
+    string temp = path + ".tmp"; ///< Временный файл нового кэша
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1)
+        throw system_error(errno, generic_category());
+    const char* p = data.data(); ///< Ещё не записанные данные
+    size_t len = data.size();    ///< Длина незаписанных данных
+    int err = 0;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            err = errno;
+            break;
+        }
+        p += n;
+        len -= n;
+    }
+    if (err == 0 && fdatasync(fd) == -1)
+        err = errno;
+    close(fd);
+    if (err == 0 && rename(temp.c_str(), path.c_str()) == -1)
+        err = errno;
+    if (err != 0) {
+        unlink(temp.c_str());
+        throw system_error(err, generic_category());
+    }
+}
+
+/**
+ * @brief Количество попаданий
+ * @return Количество векторов, результат которых найден в кэше
+ */
+uint64_t ResultCache::hits()
+{
+    lock_guard<mutex> lock(m);
+    return hitCount;
+}
+
+/**
+ * @brief Количество промахов
+ * @return Количество векторов, не найденных в кэше
+ */
+uint64_t ResultCache::misses()
+{
+    lock_guard<mutex> lock(m);
+    return missCount;
+}
+
+/**
+ * @brief Количество вытесненных записей
+ * @return Количество записей, удалённых при переполнении
+ */
+uint64_t ResultCache::evictions()
+{
+    lock_guard<mutex> lock(m);
+    return evictCount;
+}
+
+/**
+ * @brief Количество записей
+ * @return Текущее количество записей в кэше
+ */
+size_t ResultCache::size()
+{
+    lock_guard<mutex> lock(m);
+    return lru.size();
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <system_error>
+#include "errno.h"
+#include "xxhash.h"
+using namespace std;
+
+#define CACHE_MAGIC 0x32435352          ///< Признак файла кэша результатов ("RSC2")
+#define CACHE_MAGIC_OLD 0x48435352      ///< Признак файла кэша без длин кадров ("RSCH"), читается как пустой
+#define CACHE_DEFAULT_ENTRIES (1 << 20) ///< Размер кэша по умолчанию (записей)
+#define CACHE_SAVE_INTERVAL 60000       ///< Наименьший период сохранения кэша, общего для заданий, в миллисекундах
+
+/**
+ * @class ResultCache
+ * @brief Постоянный локальный кэш результатов сервера
+ * @details Ключ записи - XXH64 кадра вектора в формате протокола, то есть
+ * размера и элементов, вместе с длиной кадра, значение - результат сервера.
+ * Запись находится, только если совпадают и хеш, и длина, поэтому коллизия
+ * хешей векторов разного размера не подменяет результат. Кэш ограничен заданным
+ * количеством записей; при переполнении вытесняется запись, дольше всех не
+ * использованная (LRU). Файл кэша читается при создании и заменяется целиком
+ * при сохранении, записи в нём идут от недавно использованных к давно.
+ * Методы можно вызывать из разных потоков.
+ */
+class ResultCache {
+public:
+    /**
+     * @struct Key
+     * @brief Ключ кадра вектора
+     */
+    struct Key {
+        uint64_t hash;   ///< XXH64 кадра
+        uint64_t length; ///< Длина кадра в байтах
+    };
+
+private:
+    /**
+     * @struct Entry
+     * @brief Запись кэша (в памяти и в файле)
+     */
+    struct Entry {
+        Key key;        ///< Ключ кадра вектора
+        double result;  ///< Результат сервера
+    };
+
+    string path;        ///< Путь к файлу кэша
+    size_t capacity;    ///< Наибольшее количество записей
+    mutex m;            ///< Мьютекс для защиты записей и счётчиков
+    list<Entry> lru;    ///< Записи от недавно использованных к давно
+    unordered_map<uint64_t, list<Entry>::iterator> entries; ///< Записи по хешу ключа
+    uint64_t hitCount = 0;      ///< Количество попаданий
+    uint64_t missCount = 0;     ///< Количество промахов
+    uint64_t evictCount = 0;    ///< Количество вытесненных записей
+    bool changed = false;       ///< Записи изменились после чтения файла
+
+public:
+    /**
+     * @brief Конструктор: чтение файла кэша
+     * @param[in] path Путь к файлу кэша (отсутствующий файл - пустой кэш)
+     * @param[in] capacity Наибольшее количество записей
+     * @throw system_error при ошибках чтения, EINVAL если файл не является файлом кэша
+     */
+    ResultCache(const string& path, size_t capacity = CACHE_DEFAULT_ENTRIES);
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    /**
+     * @brief Ключ кадра вектора
+     * @param[in] frame Кадр в формате протокола (размер и элементы)
+     * @param[in] len Длина кадра в байтах
+     * @return Ключ записи
+     */
+    static Key key(const char* frame, size_t len) {
+        return {xxh64(frame, len), len};
+    }
+
+    /**
+     * @brief Поиск результата
+     * @param[in] key Ключ кадра вектора
+     * @param[out] result Результат сервера
+     * @return true при попадании
+     */
+    bool lookup(const Key& key, double& result);
+
+    /**
+     * @brief Добавление результата
+     * @param[in] key Ключ кадра вектора
+     * @param[in] result Результат сервера
+     */
+    void insert(const Key& key, double result);
+
+    /**
+     * @brief Сохранение кэша в файл, если записи изменились
+     * @throw system_error при ошибках записи
+     */
+    void save();
+
+    /**
+     * @brief Количество попаданий
+     * @return Количество векторов, результат которых найден в кэше
+     */
+    uint64_t hits();
+
+    /**
+     * @brief Количество промахов
+     * @return Количество векторов, не найденных в кэше
+     */
+    uint64_t misses();
+
+    /**
+     * @brief Количество вытесненных записей
+     * @return Количество записей, удалённых при переполнении
+     */
+    uint64_t evictions();
+
+    /**
+     * @brief Количество записей
+     * @return Текущее количество записей в кэше
+     */
+    size_t size();
+};
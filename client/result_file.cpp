@@ -0,0 +1,183 @@
+#include "result_file.h"
+#include "result_sink.h"
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define RESULT_FILE_HEADER (2 * sizeof(uint32_t)) ///< Размер заголовка файла
+
+/**
+ * @brief Создание файла
+ * @param[in] path Путь к файлу (создаётся или перезаписывается)
+ * @param[in] num_vect Количество векторов
+ * @throw system_error если файл не удаётся создать или выделить
+ */
+IndexedResultFile::IndexedResultFile(const string& path, uint32_t num_vect) : num_vect(num_vect)
+{
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1)
+        throw system_error(errno, generic_category());
+    length = RESULT_FILE_HEADER + size_t(num_vect) * (sizeof(double) + sizeof(uint8_t));
+    // Место выделяется сразу: запись в ячейки не упрётся в нехватку места
+    // на диске посреди работы (это привело бы к SIGBUS при записи в отображение)
+    int err = posix_fallocate(fd, 0, length);
+    if (err != 0) {
+        ::close(fd);
+        throw system_error(err, generic_category());
+    }
+    map();
+    uint32_t header[2] = {RESULT_FILE_MAGIC, num_vect};
+    memcpy(data, header, sizeof(header));
+}
+
+/**
+ * @brief Открытие существующего файла
+ * @param[in] path Путь к файлу
+ * @throw system_error если файл не удаётся открыть или он не является
+ * индексированным файлом результатов (EINVAL)
+ */
+IndexedResultFile::IndexedResultFile(const string& path)
+{
+    fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd == -1)
+        throw system_error(errno, generic_category());
+    struct stat st;
+    uint32_t header[2];
+    if (fstat(fd, &st) == -1) {
+        int err = errno;
+        ::close(fd);
+        throw system_error(err, generic_category());
+    }
+    length = st.st_size;
+    if (length < RESULT_FILE_HEADER || pread(fd, header, sizeof(header), 0) != (ssize_t)sizeof(header)
+        || header[0] != RESULT_FILE_MAGIC
+        || length != RESULT_FILE_HEADER + size_t(header[1]) * (sizeof(double) + sizeof(uint8_t))) {
+        ::close(fd);
+        throw system_error(EINVAL, generic_category());
+    }
+    num_vect = header[1];
+    map();
+    // Ячейка, запись которой прервалась, считается пустой
+    uint32_t n = 0; ///< Количество заполненных ячеек
+    for (uint32_t i = 0; i < num_vect; i++) {
+        if (ready[i] != RESULT_CELL_READY)
+            ready[i] = RESULT_CELL_EMPTY;
+        n += ready[i] == RESULT_CELL_READY;
+    }
+    filled.store(n, memory_order_release);
+}
+
+/**
+ * @brief Отображение открытого файла в память и разметка ячеек
+ * @throw system_error при ошибках отображения
+ */
+void IndexedResultFile::map()
+{
+    void* m = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (m == MAP_FAILED) {
+        int err = errno;
+        ::close(fd);
+        throw system_error(err, generic_category());
+    }
+    data = static_cast<char*>(m);
+    values = reinterpret_cast<double*>(data + RESULT_FILE_HEADER);
+    ready = reinterpret_cast<uint8_t*>(values + num_vect);
+}
+
+/**
+ * @brief Деструктор: освобождает отображение и закрывает файл
+ */
+IndexedResultFile::~IndexedResultFile()
+{
+    if (data != nullptr)
+        munmap(data, length);
+    if (fd != -1)
+        ::close(fd);
+}
+
+/**
+ * @brief Запись результата в ячейку
+ * @param[in] index Индекс вектора
+ * @param[in] result Результат вектора
+ * @details Признак готовности выставляется после значения (release), поэтому
+ * читатель, увидевший признак, видит и значение. Ячейку занимает первая
+ * запись; повторная (ответ на продублированный запрос или повторно
+ * отправленный вектор) отбрасывается, поэтому одновременные записи одной
+ * ячейки из разных потоков не пересекаются.
+ */
+void IndexedResultFile::put(uint32_t index, double result)
+{
+    uint8_t empty = RESULT_CELL_EMPTY;
+    if (!atomic_ref<uint8_t>(ready[index]).compare_exchange_strong(empty, RESULT_CELL_WRITING, memory_order_acquire))
+        return;
+    values[index] = result;
+    atomic_ref<uint8_t>(ready[index]).store(RESULT_CELL_READY, memory_order_release);
+    filled.fetch_add(1, memory_order_release);
+}
+
+/**
+ * @brief Чтение ячейки
+ * @param[in] index Индекс вектора
+ * @param[out] result Результат вектора
+ * @return false если ячейка ещё не заполнена
+ */
+bool IndexedResultFile::get(uint32_t index, double& result) const
+{
+    if (atomic_ref<uint8_t>(ready[index]).load(memory_order_acquire) != RESULT_CELL_READY)
+        return false;
+    result = values[index];
+    return true;
+}
+
+/**
+ * @brief Поиск первой незаполненной ячейки
+ * @return Индекс ячейки или count(), если заполнены все
+ */
+uint32_t IndexedResultFile::firstMissing() const
+{
+    uint32_t index = 0; ///< Индекс проверяемой ячейки
+    while (index < num_vect && atomic_ref<uint8_t>(ready[index]).load(memory_order_acquire) != RESULT_CELL_EMPTY)
+        index++;
+    return index;
+}
+
+/**
+ * @brief Сброс содержимого на диск и закрытие файла
+ * @throw system_error при ошибках записи
+ */
+void IndexedResultFile::close()
+{
+    if (data == nullptr)
+        return;
+    int err = msync(data, length, MS_SYNC) == -1 ? errno : 0;
+    munmap(data, length);
+    data = nullptr;
+    if (::close(fd) == -1 && err == 0)
+        err = errno;
+    fd = -1;
+    if (err != 0)
+        throw system_error(err, generic_category());
+}
+
+/**
+ * @brief Экспорт индексированного файла результатов в текстовый
+ * @param[in] indexedPath Путь к индексированному файлу
+ * @param[in] textPath Путь к текстовому файлу (создаётся или перезаписывается)
+ * @throw system_error при ошибках ввода-вывода, ENODATA если не все ячейки заполнены
+ */
+void exportResults(const string& indexedPath, const string& textPath)
+{
+    IndexedResultFile file(indexedPath);
+    if (file.written() != file.count())
+        throw system_error(ENODATA, generic_category());
+    ResultSink sink(textPath);
+    for (uint32_t i = 0; i < file.count(); i++) {
+        double result; ///< Результат вектора
+        if (!file.get(i, result))
+            throw system_error(ENODATA, generic_category());
+        sink.put(result);
+    }
+    sink.close();
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <atomic>
+#include <system_error>
+#include "errno.h"
+using namespace std;
+
+#define RESULT_FILE_MAGIC 0x53455256u ///< Признак индексированного файла результатов ("VRES")
+#define RESULT_CELL_EMPTY 0   ///< Признак пустой ячейки
+#define RESULT_CELL_READY 1   ///< Признак заполненной ячейки
+#define RESULT_CELL_WRITING 2 ///< Признак ячейки, в которую идёт запись
+
+/**
+ * @class IndexedResultFile
+ * @brief Файл результатов с ячейкой для каждого вектора, отображённый в память
+ * @details Размер файла известен заранее по количеству векторов, поэтому он
+ * выделяется целиком при создании. Результат записывается в свою ячейку сразу
+ * после получения из любого потока, без восстановления порядка в памяти.
+ * Файл состоит из заголовка (uint32 признак, uint32 количество), массива
+ * double результатов и массива байтовых признаков готовности ячеек.
+ * Текстовый файл результатов получается отдельным шагом exportResults.
+ */
+class IndexedResultFile {
+private:
+    int fd = -1;              ///< Дескриптор файла
+    char* data = nullptr;     ///< Отображённое в память содержимое файла
+    size_t length = 0;        ///< Размер файла в байтах
+    uint32_t num_vect = 0;    ///< Количество ячеек
+    double* values = nullptr; ///< Ячейки результатов
+    uint8_t* ready = nullptr; ///< Признаки заполненных ячеек
+    atomic<uint32_t> filled{0}; ///< Количество заполненных ячеек
+
+    /**
+     * @brief Отображение открытого файла в память и разметка ячеек
+     * @throw system_error при ошибках отображения
+     */
+    void map();
+
+public:
+    /**
+     * @brief Создание файла
+     * @param[in] path Путь к файлу (создаётся или перезаписывается)
+     * @param[in] num_vect Количество векторов
+     * @throw system_error если файл не удаётся создать или выделить
+     */
+    IndexedResultFile(const string& path, uint32_t num_vect);
+
+    /**
+     * @brief Открытие существующего файла
+     * @param[in] path Путь к файлу
+     * @throw system_error если файл не удаётся открыть или он не является
+     * индексированным файлом результатов (EINVAL)
+     */
+    explicit IndexedResultFile(const string& path);
+
+    /**
+     * @brief Деструктор: освобождает отображение и закрывает файл
+     */
+    ~IndexedResultFile();
+
+    IndexedResultFile(const IndexedResultFile&) = delete;
+    IndexedResultFile& operator=(const IndexedResultFile&) = delete;
+
+    /**
+     * @brief Запись результата в ячейку
+     * @param[in] index Индекс вектора
+     * @param[in] result Результат вектора
+     * @details Может вызываться из разных потоков одновременно; ячейку
+     * занимает первая запись, повторные отбрасываются
+     */
+    void put(uint32_t index, double result);
+
+    /**
+     * @brief Чтение ячейки
+     * @param[in] index Индекс вектора
+     * @param[out] result Результат вектора
+     * @return false если ячейка ещё не заполнена
+     */
+    bool get(uint32_t index, double& result) const;
+
+    /**
+     * @brief Поиск первой незаполненной ячейки
+     * @return Индекс ячейки или count(), если заполнены все
+     */
+    uint32_t firstMissing() const;
+
+    /**
+     * @brief Сброс содержимого на диск и закрытие файла
+     * @throw system_error при ошибках записи
+     */
+    void close();
+
+    /**
+     * @brief Количество ячеек
+     * @return Количество векторов
+     */
+    uint32_t count() const {
+        return num_vect;
+    };
+
+    /**
+     * @brief Количество заполненных ячеек
+     * @return Количество записанных результатов
+     */
+    uint32_t written() const {
+        return filled.load(memory_order_acquire);
+    };
+};
+
+/**
+ * @brief Экспорт индексированного файла результатов в текстовый
+ * @param[in] indexedPath Путь к индексированному файлу
+ * @param[in] textPath Путь к текстовому файлу (создаётся или перезаписывается)
+ * @throw system_error при ошибках ввода-вывода, ENODATA если не все ячейки заполнены
+ */
+void exportResults(const string& indexedPath, const string& textPath);
@@ -0,0 +1,169 @@
+#include "result_sink.h"
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/**
+ * @brief Конструктор
+ * @param[in] path Имя файла результатов (создаётся или перезаписывается)
+ * @param[in] binary Двоичный формат файла
+ * @param[in] echo Вывод каждого результата на консоль
+ * @param[in] total Ожидаемое количество результатов для вывода прогресса
+ * @param[in] keep Длина сохраняемого начала файла (продолжение прерванной записи)
+ * @param[in] kept Количество результатов в сохраняемом начале файла
+ * @throw system_error если файл не удаётся открыть, EINVAL если он короче keep
+ * @details При продолжении всё, что записано после сохраняемого начала,
+ * отбрасывается, и запись продолжается с конца этого начала
+ */
+ResultSink::ResultSink(const string& path, bool binary, bool echo, uint64_t total, uint64_t keep, uint64_t kept)
+    : buf(RESULT_BUFFER_SIZE), binary(binary), echo(echo), total(total), count(kept),
+      stored(keep), reported(chrono::steady_clock::now())
+{
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | (keep == 0 ? O_TRUNC : 0) | O_CLOEXEC, 0644);
+    if (fd == -1)
+        throw system_error(errno, generic_category());
+    if (keep == 0)
+        return;
+    struct stat st;
+    int err = 0;
+    if (fstat(fd, &st) == -1)
+        err = errno;
+    else if ((uint64_t)st.st_size < keep)
+        err = EINVAL;
+    else if (ftruncate(fd, keep) == -1 || lseek(fd, keep, SEEK_SET) == -1)
+        err = errno;
+    if (err != 0) {
+        ::close(fd);
+        fd = -1;
+        throw system_error(err, generic_category());
+    }
+}
+
+/**
+ * @brief Деструктор
+ * @details Дописывает накопленные результаты без сообщения об ошибках
+ */
+ResultSink::~ResultSink()
+{
+    if (fd == -1)
+        return;
+    try {
+        flush();
+    } catch (...) {
+    }
+    ::close(fd);
+}
+
+/**
+ * @brief Запись данных в дескриптор целиком
+ * @param[in] out Дескриптор
+ * @param[in] data Указатель на данные
+ * @param[in] len Длина данных в байтах
+ * @throw system_error при ошибках записи
+ */
+void ResultSink::writeAll(int out, const char* data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = ::write(out, data, len);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            throw system_error(errno, generic_category());
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+/**
+ * @brief Запись результата
+ * @param[in] result Результат вектора
+ * @throw system_error при ошибках записи
+ */
+void ResultSink::put(double result)
+{
+    // Самое длинное кратчайшее представление double - 24 символа
+    if (buf.size() - used < 32)
+        flush();
+    char text[32];     ///< Текстовое представление результата
+    char* end = text;  ///< Конец текстового представления
+    if (!binary || echo) {
+        end = to_chars(text, text + sizeof(text) - 1, result).ptr;
+        *end++ = '\n';
+    }
+    if (binary) {
+        memcpy(buf.data() + used, &result, sizeof(result));
+        used += sizeof(result);
+    } else {
+        memcpy(buf.data() + used, text, end - text);
+        used += end - text;
+    }
+    if (echo) {
+        console += "Результат от сервера: ";
+        console.append(text, end);
+    }
+    if (++count % RESULT_PROGRESS_STEP == 0)
+        progress();
+}
+
+/**
+ * @brief Вывод прогресса, если с прошлого вывода прошёл период
+ */
+void ResultSink::progress()
+{
+    if (echo)
+        return;
+    auto now = chrono::steady_clock::now();
+    if (now - reported < chrono::milliseconds(RESULT_PROGRESS_INTERVAL))
+        return;
+    reported = now;
+    string line = "Получено результатов: " + to_string(count);
+    if (total != 0)
+        line += " из " + to_string(total);
+    line += '\n';
+    writeAll(STDERR_FILENO, line.data(), line.size());
+}
+
+/**
+ * @brief Запись накопленных результатов в файл и на консоль
+ * @throw system_error при ошибках записи
+ */
+void ResultSink::flush()
+{
+    size_t len = used;
+    used = 0;
+    writeAll(fd, buf.data(), len);
+    stored += len;
+    if (!console.empty()) {
+        writeAll(STDOUT_FILENO, console.data(), console.size());
+        console.clear();
+    }
+}
+
+/**
+ * @brief Запись накопленных результатов и сброс файла на диск
+ * @throw system_error при ошибках записи
+ */
+void ResultSink::sync()
+{
+    flush();
+    if (fdatasync(fd) == -1)
+        throw system_error(errno, generic_category());
+}
+
+/**
+ * @brief Завершение записи и закрытие файла
+ * @throw system_error при ошибках записи
+ */
+void ResultSink::close()
+{
+    if (fd == -1)
+        return;
+    flush();
+    int closing = fd;
+    fd = -1;
+    if (::close(closing) == -1)
+        throw system_error(errno, generic_category());
+}
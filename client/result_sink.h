@@ -0,0 +1,115 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <system_error>
+#include "errno.h"
+using namespace std;
+
+#define RESULT_BUFFER_SIZE 65536      ///< Размер буфера записи результатов
+#define RESULT_PROGRESS_INTERVAL 1000 ///< Период вывода прогресса в миллисекундах
+#define RESULT_PROGRESS_STEP 4096     ///< Количество результатов между проверками времени
+
+/**
+ * @class ResultSink
+ * @brief Буферизованная запись результатов в файл
+ * @details Результаты форматируются через to_chars (кратчайшее представление,
+ * которое читается обратно в то же значение) и накапливаются в буфере;
+ * запись в файл выполняется одним вызовом на заполненный буфер, а не на
+ * каждый результат. В двоичном формате в файл пишутся значения double
+ * подряд без разделителей. Вывод каждого результата на консоль включается
+ * явно; без него в stderr периодически выводится количество полученных результатов.
+ */
+class ResultSink {
+private:
+    int fd;                 ///< Дескриптор файла результатов
+    vector<char> buf;       ///< Буфер записи в файл
+    size_t used = 0;        ///< Количество занятых байт буфера
+    bool binary;            ///< Двоичный формат файла
+    bool echo;              ///< Вывод каждого результата на консоль
+    string console;         ///< Буфер вывода на консоль
+    uint64_t total;         ///< Ожидаемое количество результатов (0 - неизвестно)
+    uint64_t count = 0;     ///< Количество записанных результатов
+    uint64_t stored = 0;    ///< Количество байт, записанных в файл
+    chrono::steady_clock::time_point reported; ///< Время последнего вывода прогресса
+
+    /**
+     * @brief Запись данных в дескриптор целиком
+     * @param[in] out Дескриптор
+     * @param[in] data Указатель на данные
+     * @param[in] len Длина данных в байтах
+     * @throw system_error при ошибках записи
+     */
+    static void writeAll(int out, const char* data, size_t len);
+
+    /**
+     * @brief Вывод прогресса, если с прошлого вывода прошёл период
+     */
+    void progress();
+
+public:
+    /**
+     * @brief Конструктор
+     * @param[in] path Имя файла результатов (создаётся или перезаписывается)
+     * @param[in] binary Двоичный формат файла
+     * @param[in] echo Вывод каждого результата на консоль
+     * @param[in] total Ожидаемое количество результатов для вывода прогресса
+     * @param[in] keep Длина сохраняемого начала файла (продолжение прерванной записи)
+     * @param[in] kept Количество результатов в сохраняемом начале файла
+     * @throw system_error если файл не удаётся открыть, EINVAL если он короче keep
+     */
+    ResultSink(const string& path, bool binary = false, bool echo = false, uint64_t total = 0, uint64_t keep = 0, uint64_t kept = 0);
+
+    /**
+     * @brief Деструктор
+     * @details Дописывает накопленные результаты без сообщения об ошибках;
+     * для проверки записи следует вызвать close
+     */
+    ~ResultSink();
+
+    ResultSink(const ResultSink&) = delete;
+    ResultSink& operator=(const ResultSink&) = delete;
+
+    /**
+     * @brief Запись результата
+     * @param[in] result Результат вектора
+     * @throw system_error при ошибках записи
+     */
+    void put(double result);
+
+    /**
+     * @brief Запись накопленных результатов в файл и на консоль
+     * @throw system_error при ошибках записи
+     */
+    void flush();
+
+    /**
+     * @brief Запись накопленных результатов и сброс файла на диск
+     * @throw system_error при ошибках записи
+     */
+    void sync();
+
+    /**
+     * @brief Завершение записи и закрытие файла
+     * @throw system_error при ошибках записи
+     */
+    void close();
+
+    /**
+     * @brief Количество записанных результатов
+     * @return Количество результатов, переданных в put
+     */
+    uint64_t written() const {
+        return count;
+    };
+
+    /**
+     * @brief Длина файла с учётом ещё не записанных результатов
+     * @return Количество байт
+     */
+    uint64_t size() const {
+        return stored + used;
+    };
+};
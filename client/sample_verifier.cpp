@@ -0,0 +1,71 @@
+#include "sample_verifier.h"
+#include "xxhash.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+/**
+ * @brief Конструктор
+ * @param[in] fraction Доля проверяемых векторов (0-1)
+ * @param[in] tolerance Допустимое относительное расхождение
+ * @param[in] mode Режим локального суммирования
+ */
+SampleVerifier::SampleVerifier(double fraction, double tolerance, SumMode mode)
+    : threshold(fraction >= 1 ? ~0ull : uint64_t(ldexp(max(fraction, 0.0), 64))),
+      all(fraction >= 1), tolerance(tolerance), mode(mode)
+{
+}
+
+/**
+ * @brief Попадание вектора в выборку
+ * @param[in] index Индекс вектора во входном файле
+ * @return true если результат вектора проверяется
+ */
+bool SampleVerifier::sampled(uint32_t index) const
+{
+    return all || xxh64(&index, sizeof(index)) < threshold;
+}
+
+/**
+ * @brief Локальное вычисление части вектора выборки
+ * @param[in] index Индекс вектора во входном файле
+ * @param[in] x Элементы части (без требований к выравниванию)
+ * @param[in] n Количество элементов части
+ * @param[in] start Первая часть вектора (прежнее значение отбрасывается)
+ */
+void SampleVerifier::expect(uint32_t index, const void* x, size_t n, bool start)
+{
+    if (!sampled(index))
+        return;
+    LocalSum local(mode);
+    local.add(x, n);
+    lock_guard<mutex> lock(m);
+    NeumaierSum& sum = expected[index];
+    if (start)
+        sum = NeumaierSum();
+    sum.add(local.value());
+}
+
+/**
+ * @brief Сравнение результата сервера с локальным
+ * @param[in] index Индекс вектора во входном файле
+ * @param[in] result Результат сервера
+ */
+void SampleVerifier::check(uint32_t index, double result)
+{
+    double local; ///< Локальный результат
+    {
+        lock_guard<mutex> lock(m);
+        auto it = expected.find(index);
+        if (it == expected.end())
+            return;
+        local = it->second.value();
+        expected.erase(it);
+    }
+    checked.fetch_add(1, memory_order_relaxed);
+    if (fabs(result - local) <= tolerance * max(1.0, fabs(local)))
+        return;
+    if (mismatched.fetch_add(1, memory_order_relaxed) < VERIFY_REPORT_LIMIT)
+        cerr << "Результат вектора " << index << " не совпадает с локальным: сервер " << result
+             << ", локально " << local << endl;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "local_sum.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+using namespace std;
+
+#define VERIFY_REPORT_LIMIT 10 ///< Сколько расхождений выводится подробно
+
+/**
+ * @class SampleVerifier
+ * @brief Выборочная проверка результатов сервера локальным вычислением
+ * @details Вектор попадает в выборку по хешу своего индекса, поэтому
+ * выборка не зависит от режима отправки и одинакова при повторных
+ * попытках. Для векторов выборки разборщик вычисляет локальную сумму
+ * до отправки, а запись результатов сравнивает с ней ответ сервера.
+ * Расхождение больше tolerance * max(1, |локальная сумма|) считается
+ * ошибкой сервера. Ожидаемые значения хранятся, только пока ответ не
+ * получен, поэтому память ограничена векторами в полёте.
+ */
+class SampleVerifier {
+private:
+    uint64_t threshold;  ///< Порог хеша индекса для попадания в выборку
+    bool all;            ///< Проверяются все векторы
+    double tolerance;    ///< Допустимое относительное расхождение
+    SumMode mode;        ///< Режим локального суммирования
+    mutex m;             ///< Мьютекс для защиты ожидаемых значений
+    unordered_map<uint32_t, NeumaierSum> expected; ///< Локальные суммы векторов без ответа
+    atomic<uint64_t> checked{0};    ///< Проверено результатов
+    atomic<uint64_t> mismatched{0}; ///< Результатов с расхождением
+
+public:
+    /**
+     * @brief Конструктор
+     * @param[in] fraction Доля проверяемых векторов (0-1)
+     * @param[in] tolerance Допустимое относительное расхождение
+     * @param[in] mode Режим локального суммирования
+     */
+    SampleVerifier(double fraction, double tolerance, SumMode mode);
+
+    /**
+     * @brief Попадание вектора в выборку
+     * @param[in] index Индекс вектора во входном файле
+     * @return true если результат вектора проверяется
+     */
+    bool sampled(uint32_t index) const;
+
+    /**
+     * @brief Локальное вычисление части вектора выборки
+     * @param[in] index Индекс вектора во входном файле
+     * @param[in] x Элементы части (без требований к выравниванию)
+     * @param[in] n Количество элементов части
+     * @param[in] start Первая часть вектора (прежнее значение отбрасывается)
+     * @details Вызывается до отправки части, для векторов не из выборки
+     * ничего не делает
+     */
+    void expect(uint32_t index, const void* x, size_t n, bool start = true);
+
+    /**
+     * @brief Сравнение результата сервера с локальным
+     * @param[in] index Индекс вектора во входном файле
+     * @param[in] result Результат сервера
+     * @details Результат вектора без ожидаемого значения (не из выборки
+     * или уже проверенного) не сравнивается
+     */
+    void check(uint32_t index, double result);
+
+    /**
+     * @brief Количество проверенных результатов
+     * @return Проверено результатов
+     */
+    uint64_t checkedCount() const {
+        return checked.load(memory_order_relaxed);
+    }
+
+    /**
+     * @brief Количество расхождений
+     * @return Результатов, не совпавших с локальным вычислением
+     */
+    uint64_t mismatches() const {
+        return mismatched.load(memory_order_relaxed);
+    }
+};
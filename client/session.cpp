@@ -0,0 +1,131 @@
+#include "session.h"
+#include "metrics.h"
+#include <memory>
+#include <fstream>
+#include <cstring>
+#include <sys/time.h>
+
+/**
+ * @brief Создание сокета и установка соединения с сервером
+ * @param[in] p Указатель на параметры соединения
+ * @return Дескриптор подключённого сокета
+ * @throw system_error при ошибках сетевого взаимодействия
+ */
+int Session::connectTo(const Params* p){
+    // Создание сокета
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == -1) 
+        throw system_error(errno, generic_category()); 
+
+    // Настройка адреса сервера
+    unique_ptr <sockaddr_in> serv_addr(new sockaddr_in);
+    serv_addr->sin_family = AF_INET; ///< Семейство адресов IPv4
+    serv_addr->sin_port = htons(p->Port); ///< Порт сервера в сетевом порядке байт
+    serv_addr->sin_addr.s_addr = inet_addr(p->Address.c_str()); ///< IP-адрес сервера
+
+    // Тайм-аут ограничивает подключение, рукопожатие и каждую запись;
+    // истекший connect завершается с EINPROGRESS. Результаты ждутся до
+    // срока ответа на каждый вектор (SocketReader::setDeadline), который не
+    // продлевается каждым принятым байтом
+    if (p->Timeout > 0) {
+        timeval tv = {time_t(p->Timeout / 1000), suseconds_t(p->Timeout % 1000 * 1000)};
+        if (setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == -1
+            || setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) == -1) {
+            int err = errno;
+            close(s);
+            throw system_error(err, generic_category());
+        }
+    }
+
+    // Установка соединения с сервером
+    PhaseTimer timer(Phase::Connect);
+    if (connect(s, (sockaddr*) serv_addr.get(), sizeof(sockaddr_in)) == -1) {
+        int err = errno == EINPROGRESS ? ETIMEDOUT : errno;
+        close(s);
+        throw system_error(err, generic_category()); 
+    }
+    return s;
+}
+
+/**
+ * @brief Установка соединения и аутентификация
+ * @param[in] p Указатель на параметры соединения
+ * @param[in] login Логин пользователя
+ * @param[in] pass Пароль пользователя
+ * @throw system_error при ошибках сетевого взаимодействия,
+ * EACCES если сервер не подтвердил аутентификацию
+ */
+Session::Session(const Params* p, const string& login, const string& pass)
+    : s(connectTo(p)), writer(s), reader(s)
+{
+    PhaseTimer timer(Phase::Handshake);
+    try {
+        // Отправка логина на сервер
+        writer.write(login.c_str(), login.length());
+        writer.flush();
+
+        // Получение SALT (соли) от сервера
+        string message = reader.readToken(SALT_LENGTH); ///< Соль, полученная от сервера
+
+        // Отправка MD5 хеша (соль + пароль)
+        message = auth(message, pass); ///< Вычисление MD5 хеша
+        writer.write(message.c_str(), message.length());
+        writer.flush();
+
+        // Прием подтверждения аутентификации от сервера (ОК)
+        if (reader.readToken(strlen(AUTH_OK)) != AUTH_OK)
+            throw system_error(EACCES, generic_category());
+    } catch (...) {
+        close(s);
+        throw;
+    }
+}
+
+/**
+ * @brief Принятие уже аутентифицированного соединения
+ * @param[in] s Дескриптор подключённого сокета (сессия становится владельцем)
+ */
+Session::Session(int s) : s(s), writer(s), reader(s)
+{
+}
+
+/**
+ * @brief Деструктор: закрывает сокет
+ */
+Session::~Session()
+{
+    close(s);
+}
+
+/**
+ * @brief Аварийное прерывание обмена
+ */
+void Session::abort()
+{
+    shutdown(s, SHUT_RDWR);
+}
+
+/**
+ * @brief Проверка простаивающей сессии перед новым заданием
+ * @return false если сервер закрыл соединение или прислал неожиданные данные
+ */
+bool Session::alive()
+{
+    if (reader.buffered() != 0)
+        return false;
+    pollfd pfd = {s, POLLIN | POLLRDHUP, 0};
+    return poll(&pfd, 1, 0) == 0;
+}
+
+/**
+ * @brief Чтение учётных данных из файла
+ * @param[in] path Путь к файлу с логином и паролем
+ * @param[out] login Логин пользователя
+ * @param[out] pass Пароль пользователя
+ */
+void Session::readCredentials(const string& path, string& login, string& pass)
+{
+    ifstream fileData(path);
+    fileData >> login;
+    fileData >> pass;
+}
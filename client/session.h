@@ -0,0 +1,97 @@
+#pragma once
+#include "errno.h"
+#include "crypto.h"
+#include "interface.h"
+#include "socket_writer.h"
+#include "socket_reader.h"
+#include <system_error>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <poll.h>
+#include <string>
+using namespace std;
+
+#define SALT_LENGTH 16 ///< Длина соли от сервера (64-битное число в шестнадцатеричной записи)
+#define AUTH_OK "OK" ///< Подтверждение успешной аутентификации от сервера
+
+/**
+ * @class Session
+ * @brief Аутентифицированное TCP-соединение с сервером
+ * @details Конструктор устанавливает соединение и выполняет рукопожатие
+ * (логин, соль, MD5-хеш, подтверждение), деструктор закрывает сокет.
+ * После рукопожатия по сессии передаются задания: количество векторов,
+ * затем кадры векторов; результаты приходят в порядке отправки.
+ */
+class Session {
+private:
+    int s; ///< Дескриптор сокета
+
+    /**
+     * @brief Создание сокета и установка соединения с сервером
+     * @param[in] p Указатель на параметры соединения
+     * @return Дескриптор подключённого сокета
+     * @throw system_error при ошибках сетевого взаимодействия
+     */
+    static int connectTo(const Params* p);
+
+public:
+    SocketWriter writer; ///< Буферизованный вывод в сокет
+    SocketReader reader; ///< Буферизованный ввод из сокета
+
+    /**
+     * @brief Установка соединения и аутентификация
+     * @param[in] p Указатель на параметры соединения
+     * @param[in] login Логин пользователя
+     * @param[in] pass Пароль пользователя
+     * @throw system_error при ошибках сетевого взаимодействия,
+     * EACCES если сервер не подтвердил аутентификацию
+     */
+    Session(const Params* p, const string& login, const string& pass);
+
+    /**
+     * @brief Принятие уже аутентифицированного соединения
+     * @param[in] s Дескриптор подключённого сокета (сессия становится владельцем)
+     */
+    explicit Session(int s);
+
+    /**
+     * @brief Деструктор: закрывает сокет
+     */
+    ~Session();
+
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    /**
+     * @brief Аварийное прерывание обмена
+     * @details Разрывает соединение в обоих направлениях, чтобы потоки,
+     * заблокированные на чтении или записи, завершились с ошибкой
+     */
+    void abort();
+
+    /**
+     * @brief Проверка простаивающей сессии перед новым заданием
+     * @return false если сервер закрыл соединение или прислал неожиданные данные
+     * @details Между заданиями сервер ничего не присылает, поэтому любое
+     * событие на сокете означает, что сессию нельзя использовать повторно
+     */
+    bool alive();
+
+    /**
+     * @brief Дескриптор сокета сессии
+     * @return Дескриптор (остаётся во владении сессии)
+     */
+    int descriptor() const {
+        return s;
+    };
+
+    /**
+     * @brief Чтение учётных данных из файла
+     * @param[in] path Путь к файлу с логином и паролем
+     * @param[out] login Логин пользователя
+     * @param[out] pass Пароль пользователя
+     */
+    static void readCredentials(const string& path, string& login, string& pass);
+};
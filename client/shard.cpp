@@ -0,0 +1,437 @@
+#include "shard.h"
+#include <unistd.h>
+
+/**
+ * @brief Конструктор
+ * @param[in] workers Количество соединений
+ * @param[in] batches Количество пакетов в обращении
+ */
+ShardQueues::ShardQueues(size_t workers, size_t batches) : queues(workers)
+{
+    for (size_t i = 0; i < batches; i++) {
+        storage.emplace_back(new Batch);
+        freeList.push_back(storage.back().get());
+    }
+}
+
+/**
+ * @brief Получение свободного пакета для заполнения
+ * @return Пакет или nullptr, если очереди закрыты
+ */
+Batch* ShardQueues::acquire()
+{
+    unique_lock<mutex> lock(m);
+    cv.wait(lock, [this]{ return closed || !freeList.empty(); });
+    if (closed)
+        return nullptr;
+    Batch* batch = freeList.back();
+    freeList.pop_back();
+    return batch;
+}
+
+/**
+ * @brief Получение свободного пакета без ожидания
+ * @return Пакет или nullptr, если свободных пакетов нет или очереди закрыты
+ */
+Batch* ShardQueues::tryAcquire()
+{
+    lock_guard<mutex> lock(m);
+    if (closed || freeList.empty())
+        return nullptr;
+    Batch* batch = freeList.back();
+    freeList.pop_back();
+    return batch;
+}
+
+/**
+ * @brief Возврат обработанного пакета в набор свободных
+ * @param[in] batch Пакет
+ */
+void ShardQueues::release(Batch* batch)
+{
+    {
+        lock_guard<mutex> lock(m);
+        freeList.push_back(batch);
+    }
+    cv.notify_all();
+}
+
+/**
+ * @brief Постановка заполненного пакета в очередь
+ * @param[in] batch Пакет
+ */
+void ShardQueues::push(Batch* batch)
+{
+    {
+        lock_guard<mutex> lock(m);
+        queues[next].push_back(batch);
+        next = (next + 1) % queues.size();
+        notify();
+    }
+    cv.notify_all();
+}
+
+/**
+ * @brief Постановка копии опаздывающего пакета в очередь
+ * @param[in] batch Копия пакета
+ * @param[in] avoid Соединение, которому копию не отдавать
+ */
+void ShardQueues::pushHedge(Batch* batch, size_t avoid)
+{
+    {
+        lock_guard<mutex> lock(m);
+        hedges.emplace_back(batch, avoid);
+        notify();
+    }
+    cv.notify_all();
+}
+
+/**
+ * @brief Удержание соединений после окончания разбора
+ * @param[in] on Удерживать соединения
+ */
+void ShardQueues::hold(bool on)
+{
+    {
+        lock_guard<mutex> lock(m);
+        held = on;
+        notify();
+    }
+    cv.notify_all();
+}
+
+/**
+ * @brief Извлечение пакета из своей или чужой очереди (под мьютексом)
+ * @param[in] worker Номер соединения
+ * @return Пакет или nullptr, если все очереди пусты
+ */
+Batch* ShardQueues::take(size_t worker)
+{
+    // Копии опаздывающих пакетов - в первую очередь, но не тому
+    // соединению, которое задерживает исходный пакет
+    for (auto it = hedges.begin(); it != hedges.end(); ++it)
+        if (it->second != worker) {
+            Batch* batch = it->first;
+            hedges.erase(it);
+            return batch;
+        }
+    // Свой пакет берётся из начала очереди
+    if (!queues[worker].empty()) {
+        Batch* batch = queues[worker].front();
+        queues[worker].pop_front();
+        return batch;
+    }
+    // Перехват: последний пакет самой длинной чужой очереди
+    size_t victim = worker;
+    for (size_t i = 0; i < queues.size(); i++)
+        if (queues[i].size() > queues[victim].size())
+            victim = i;
+    if (victim == worker)
+        return nullptr;
+    Batch* batch = queues[victim].back();
+    queues[victim].pop_back();
+    return batch;
+}
+
+/**
+ * @brief Получение пакета для отправки
+ * @param[in] worker Номер соединения
+ * @return Пакет из своей очереди или перехваченный из чужой;
+ * nullptr если пакетов больше не будет
+ */
+Batch* ShardQueues::pop(size_t worker)
+{
+    unique_lock<mutex> lock(m);
+    for (;;) {
+        if (closed)
+            return nullptr;
+        Batch* batch = take(worker);
+        if (batch != nullptr || (finished && !held))
+            return batch;
+        cv.wait(lock);
+    }
+}
+
+/**
+ * @brief Получение пакета для отправки без ожидания
+ * @param[in] worker Номер соединения
+ * @return Пакет или nullptr, если сейчас пакетов нет
+ */
+Batch* ShardQueues::tryPop(size_t worker)
+{
+    lock_guard<mutex> lock(m);
+    if (closed)
+        return nullptr;
+    return take(worker);
+}
+
+/**
+ * @brief Отметка о том, что все пакеты поставлены в очереди
+ */
+void ShardQueues::finish()
+{
+    {
+        lock_guard<mutex> lock(m);
+        finished = true;
+        notify();
+    }
+    cv.notify_all();
+}
+
+/**
+ * @brief Аварийная остановка: будит все ожидающие потоки
+ */
+void ShardQueues::close()
+{
+    {
+        lock_guard<mutex> lock(m);
+        closed = true;
+        notify();
+    }
+    cv.notify_all();
+}
+
+/**
+ * @brief Уведомление через eventfd (под мьютексом)
+ */
+void ShardQueues::notify()
+{
+    if (notifyFd == -1)
+        return;
+    uint64_t one = 1;
+    ssize_t n = write(notifyFd, &one, sizeof(one));
+    (void) n; // переполнение счётчика eventfd означает, что уведомление уже ждёт
+}
+
+/**
+ * @brief Проверка, что пакетов для отправки больше не будет
+ * @return true если все пакеты разобраны или очереди закрыты
+ */
+bool ShardQueues::exhausted()
+{
+    lock_guard<mutex> lock(m);
+    if (closed)
+        return true;
+    if (!finished || held || !hedges.empty())
+        return false;
+    for (deque<Batch*>& queue : queues)
+        if (!queue.empty())
+            return false;
+    return true;
+}
+
+/**
+ * @brief Установка eventfd для уведомлений о новых пакетах
+ * @param[in] fd Дескриптор eventfd или -1 для отключения уведомлений
+ */
+void ShardQueues::setNotify(int fd)
+{
+    lock_guard<mutex> lock(m);
+    notifyFd = fd;
+}
+
+/**
+ * @brief Конструктор
+ * @param[out] sink Последовательная запись результатов или nullptr
+ * @param[out] file Индексированный файл результатов или nullptr
+ * @param[out] checkpoint Контрольная точка последовательной записи или nullptr
+ * @param[in] first Индекс первого результата, которого ещё нет в sink
+ * @param[out] cache Кэш, в который добавляются результаты кадров, или nullptr
+ * @param[in] verifier Выборочная проверка результатов или nullptr
+ */
+OrderedResults::OrderedResults(ResultSink* sink, IndexedResultFile* file, Checkpoint* checkpoint, uint32_t first, ResultCache* cache, SampleVerifier* verifier)
+    : next(first), sink(sink), file(file), checkpoint(checkpoint), cache(cache), verifier(verifier), saved(chrono::steady_clock::now())
+{
+}
+
+/**
+ * @brief Передача результата вектора
+ * @param[in] index Индекс вектора во входном файле
+ * @param[in] result Результат от сервера
+ * @throw system_error при ошибках записи в файл результатов
+ */
+void OrderedResults::put(uint32_t index, double result)
+{
+    if (verifier != nullptr)
+        verifier->check(index, result);
+    if (file != nullptr) {
+        file->put(index, result);
+        return;
+    }
+    lock_guard<mutex> lock(m);
+    // Повторный результат (ответ на продублированный пакет) отбрасывается
+    if (index < next)
+        return;
+    if (index != next) {
+        pending.emplace(index, result);
+        return;
+    }
+    for (;;) {
+        sink->put(result);
+        if (++next % CHECKPOINT_STEP == 0 && checkpoint != nullptr
+            && chrono::steady_clock::now() - saved >= chrono::milliseconds(CHECKPOINT_INTERVAL))
+            save();
+        auto it = pending.begin();
+        if (it == pending.end() || it->first != next)
+            return;
+        result = it->second;
+        pending.erase(it);
+    }
+}
+
+/**
+ * @brief Передача результата части разбитого вектора
+ * @param[in] index Индекс вектора во входном файле
+ * @param[in] partial Результат сервера для части вектора
+ * @param[in] parts Общее количество частей вектора
+ * @throw system_error при ошибках записи в файл результатов
+ */
+void OrderedResults::putPart(uint32_t index, double partial, uint32_t parts)
+{
+    double result; ///< Результат всего вектора
+    {
+        lock_guard<mutex> lock(m);
+        Partial& acc = partials[index];
+        acc.sum.add(partial);
+        if (++acc.received < parts)
+            return;
+        result = acc.sum.value();
+        partials.erase(index);
+    }
+    put(index, result);
+}
+
+/**
+ * @brief Количество записанных результатов
+ * @return Количество результатов, записанных подряд с начала
+ */
+uint32_t OrderedResults::written()
+{
+    if (file != nullptr)
+        return file->written();
+    lock_guard<mutex> lock(m);
+    return next;
+}
+
+/**
+ * @brief Передача результата кадра пакета
+ * @param[in] batch Пакет
+ * @param[in] frame Номер кадра в пакете
+ * @param[in] result Результат от сервера
+ * @throw system_error при ошибках записи в файл результатов
+ */
+void OrderedResults::putFrame(const Batch& batch, uint32_t frame, double result)
+{
+    if (batch.parts > 1) {
+        putPart(batch.first, result, batch.parts);
+        return;
+    }
+    if (cache == nullptr || batch.keys.empty()) {
+        put(batch.index(frame), result);
+        return;
+    }
+    // Результат сначала попадает в кэш: кадр, разобранный после снятия
+    // отметки о полёте, найдёт его там
+    const ResultCache::Key& key = batch.keys[frame];
+    cache->insert(key, result);
+    vector<uint32_t> repeats; ///< Векторы, ждавшие результата этого кадра
+    {
+        lock_guard<mutex> lock(wm);
+        auto it = waiting.find(key.hash);
+        if (it != waiting.end() && it->second.length == key.length) {
+            repeats.swap(it->second.indices);
+            waiting.erase(it);
+        }
+    }
+    put(batch.index(frame), result);
+    for (uint32_t index : repeats)
+        put(index, result);
+}
+
+/**
+ * @brief Ожидание результата такого же кадра, уже отправляемого серверу
+ * @param[in] key Ключ кэша кадра
+ * @param[in] index Индекс вектора
+ * @return true если такой кадр в полёте: вектор получит его результат и
+ * не отправляется; false если кадр отмечен как отправляемый
+ * @details Кадр с тем же хешем, но другой длины не считается повтором и
+ * отправляется без отметки
+ */
+bool OrderedResults::awaitRepeat(const ResultCache::Key& key, uint32_t index)
+{
+    lock_guard<mutex> lock(wm);
+    auto [it, added] = waiting.try_emplace(key.hash);
+    if (added) {
+        it->second.length = key.length;
+        return false;
+    }
+    if (it->second.length != key.length)
+        return false;
+    it->second.indices.push_back(index);
+    repeatCount++;
+    return true;
+}
+
+/**
+ * @brief Количество повторов кадров в полёте
+ * @return Количество векторов, результат которых взят у такого же
+ * отправленного кадра
+ */
+uint64_t OrderedResults::repeats()
+{
+    lock_guard<mutex> lock(wm);
+    return repeatCount;
+}
+
+/**
+ * @brief Сброс записанных результатов на диск и сохранение точки
+ * @throw system_error при ошибках записи
+ * @details Вызывается при захваченном мьютексе
+ */
+void OrderedResults::save()
+{
+    sink->sync();
+    checkpoint->save(next, sink->size());
+    saved = chrono::steady_clock::now();
+}
+
+/**
+ * @brief Подготовка к повторной отправке после разрыва соединения
+ * @return Индекс первого вектора без результата
+ * @details Результаты, ожидающие предыдущих, части разбитых векторов
+ * и повторы кадров в полёте отбрасываются: они будут получены заново
+ */
+uint32_t OrderedResults::resume()
+{
+    {
+        lock_guard<mutex> lock(wm);
+        waiting.clear();
+    }
+    lock_guard<mutex> lock(m);
+    pending.clear();
+    partials.clear();
+    return file != nullptr ? file->firstMissing() : next;
+}
+
+/**
+ * @brief Сохранение контрольной точки вне очереди (перед выходом с ошибкой)
+ * @throw system_error при ошибках записи
+ */
+void OrderedResults::checkpointNow()
+{
+    lock_guard<mutex> lock(m);
+    if (checkpoint != nullptr)
+        save();
+}
+
+/**
+ * @brief Завершение записи и закрытие файла результатов
+ * @throw system_error при ошибках записи
+ */
+void OrderedResults::close()
+{
+    if (file != nullptr)
+        file->close();
+    else
+        sink->close();
+}
@@ -0,0 +1,336 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include "summation.h"
+#include "result_sink.h"
+#include "result_file.h"
+#include "checkpoint.h"
+#include "result_cache.h"
+#include "sample_verifier.h"
+#include <chrono>
+using namespace std;
+
+#define SHARD_BATCHES_PER_CONNECTION 4 ///< Желаемое количество пакетов на одно соединение
+#define SHARD_BATCH_BYTES (8 << 20) ///< Объём кадров, после которого пакет закрывается досрочно
+#define SHARD_QUEUED_BATCHES 3 ///< Количество пакетов в работе на одно соединение
+
+/**
+ * @struct Batch
+ * @brief Пакет последовательных векторов задания
+ * @details Кадры векторов хранятся в готовом для отправки виде (размер и
+ * элементы подряд), поэтому пакет можно передать любому соединению.
+ * По каждому соединению пакет уходит отдельным заданием протокола:
+ * количество векторов пакета, затем его кадры. Вектор, разбитый на части,
+ * передаётся пакетами из одного кадра-части с общим индексом first.
+ * С кэшем результатов векторы, найденные в кэше или повторяющие кадр в
+ * полёте, в пакет не попадают, поэтому индексы векторов пакета хранятся
+ * явно вместе с ключами кадров.
+ */
+struct Batch {
+    uint32_t first = 0;   ///< Индекс первого вектора пакета во входном файле
+    uint32_t count = 0;   ///< Количество векторов в пакете
+    uint32_t parts = 1;   ///< Количество частей вектора first (больше 1 - пакет с частью большого вектора)
+    vector<char> frames;  ///< Кадры векторов в формате протокола
+    vector<size_t> ends;  ///< Смещения концов кадров в frames
+    vector<uint32_t> indices; ///< Индексы векторов кадров (пусто - подряд с first)
+    vector<ResultCache::Key> keys; ///< Ключи кэша кадров (пусто - без кэша)
+
+    /**
+     * @brief Подготовка пакета к заполнению
+     * @param[in] first Индекс первого вектора пакета
+     * @param[in] parts Количество частей вектора (1 - целые векторы)
+     */
+    void reset(uint32_t first, uint32_t parts) {
+        this->first = first;
+        this->parts = parts;
+        count = 0;
+        frames.clear();
+        ends.clear();
+        indices.clear();
+        keys.clear();
+    }
+
+    /**
+     * @brief Индекс вектора кадра во входном файле
+     * @param[in] frame Номер кадра в пакете
+     * @return Индекс вектора
+     */
+    uint32_t index(uint32_t frame) const {
+        return indices.empty() ? first + frame : indices[frame];
+    }
+};
+
+/**
+ * @class ShardQueues
+ * @brief Очереди пакетов соединений с перехватом работы (work stealing)
+ * @details Разборщик раскладывает готовые пакеты по очередям соединений по
+ * кругу. Соединение берёт пакеты из начала своей очереди, а освободившись,
+ * забирает пакет из конца самой длинной чужой очереди, поэтому медленное
+ * соединение не задерживает остальные. Пакеты берутся из фиксированного
+ * набора и возвращаются в него после получения результатов, что ограничивает
+ * потребление памяти. Копии опаздывающих пакетов (дублирование запросов)
+ * ставятся в отдельную очередь, которая разбирается раньше остальных
+ * всеми соединениями, кроме того, что задерживает исходный пакет.
+ */
+class ShardQueues {
+private:
+    vector<deque<Batch*>> queues;        ///< Очереди пакетов по соединениям
+    deque<pair<Batch*, size_t>> hedges;  ///< Копии опаздывающих пакетов и соединения исходных пакетов
+    vector<unique_ptr<Batch>> storage;   ///< Все пакеты (владение)
+    vector<Batch*> freeList;             ///< Свободные пакеты
+    mutex m;                             ///< Мьютекс для защиты очередей
+    condition_variable cv;               ///< Ожидание пакета или свободного места
+    size_t next = 0;                     ///< Очередь для следующего пакета
+    bool finished = false;               ///< Разборщик передал все пакеты
+    bool closed = false;                 ///< Признак аварийной остановки
+    bool held = false;                   ///< Соединения ждут копий пакетов и после finish
+    int notifyFd = -1;                   ///< eventfd для уведомлений о пакетах (-1 - нет)
+
+    /**
+     * @brief Уведомление через eventfd (под мьютексом)
+     */
+    void notify();
+
+    /**
+     * @brief Извлечение пакета из своей или чужой очереди (под мьютексом)
+     * @param[in] worker Номер соединения
+     * @return Пакет или nullptr, если все очереди пусты
+     */
+    Batch* take(size_t worker);
+
+public:
+    /**
+     * @brief Конструктор
+     * @param[in] workers Количество соединений
+     * @param[in] batches Количество пакетов в обращении
+     */
+    ShardQueues(size_t workers, size_t batches);
+
+    /**
+     * @brief Получение свободного пакета для заполнения
+     * @return Пакет или nullptr, если очереди закрыты
+     */
+    Batch* acquire();
+
+    /**
+     * @brief Получение свободного пакета без ожидания
+     * @return Пакет или nullptr, если свободных пакетов нет или очереди закрыты
+     */
+    Batch* tryAcquire();
+
+    /**
+     * @brief Возврат обработанного пакета в набор свободных
+     * @param[in] batch Пакет
+     */
+    void release(Batch* batch);
+
+    /**
+     * @brief Постановка заполненного пакета в очередь
+     * @param[in] batch Пакет
+     */
+    void push(Batch* batch);
+
+    /**
+     * @brief Постановка копии опаздывающего пакета в очередь
+     * @param[in] batch Копия пакета
+     * @param[in] avoid Соединение, которому копию не отдавать
+     */
+    void pushHedge(Batch* batch, size_t avoid);
+
+    /**
+     * @brief Удержание соединений после окончания разбора
+     * @param[in] on true - pop не завершает работу после finish, пока
+     * удержание не снято (могут появиться копии пакетов)
+     */
+    void hold(bool on);
+
+    /**
+     * @brief Получение пакета для отправки
+     * @param[in] worker Номер соединения
+     * @return Пакет из своей очереди или перехваченный из чужой;
+     * nullptr если пакетов больше не будет
+     */
+    Batch* pop(size_t worker);
+
+    /**
+     * @brief Получение пакета для отправки без ожидания
+     * @param[in] worker Номер соединения
+     * @return Пакет или nullptr, если сейчас пакетов нет
+     */
+    Batch* tryPop(size_t worker);
+
+    /**
+     * @brief Отметка о том, что все пакеты поставлены в очереди
+     */
+    void finish();
+
+    /**
+     * @brief Проверка, что пакетов для отправки больше не будет
+     * @return true если все пакеты разобраны или очереди закрыты
+     */
+    bool exhausted();
+
+    /**
+     * @brief Установка eventfd для уведомлений о новых пакетах
+     * @param[in] fd Дескриптор eventfd или -1 для отключения уведомлений
+     * @details Нужна циклу событий, который не может ждать на условной
+     * переменной; после отключения уведомления в дескриптор не пишутся
+     */
+    void setNotify(int fd);
+
+    /**
+     * @brief Аварийная остановка: будит все ожидающие потоки
+     */
+    void close();
+};
+
+/**
+ * @class OrderedResults
+ * @brief Запись результатов в порядке векторов входного файла
+ * @details Результаты от разных соединений приходят вперемешку. При записи
+ * в поток результат записывается, как только записаны все предыдущие,
+ * остальные ждут в памяти. При записи в индексированный файл результат сразу
+ * попадает в свою ячейку, и порядок восстанавливать не нужно.
+ * Последовательная запись периодически сбрасывается на диск с сохранением
+ * контрольной точки; индексированный файл сам служит контрольной точкой.
+ * С кэшем векторы, повторяющие кадр, который уже отправлен и ещё не получил
+ * результат, ждут его результата вместо отправки.
+ */
+class OrderedResults {
+private:
+    /**
+     * @struct Partial
+     * @brief Накопление результатов частей разбитого вектора
+     */
+    struct Partial {
+        NeumaierSum sum;       ///< Компенсированная сумма частичных результатов
+        uint32_t received = 0; ///< Количество полученных частей
+    };
+
+    /**
+     * @struct Waiting
+     * @brief Повторы кадра, отправленного серверу и ещё не получившего результат
+     */
+    struct Waiting {
+        uint64_t length;          ///< Длина кадра в байтах
+        vector<uint32_t> indices; ///< Индексы векторов-повторов
+    };
+
+    mutex m;                     ///< Мьютекс для защиты состояния
+    map<uint32_t, double> pending; ///< Результаты, ожидающие предыдущих
+    map<uint32_t, Partial> partials; ///< Незавершённые результаты разбитых векторов
+    uint32_t next = 0;           ///< Индекс следующего записываемого результата
+    ResultSink* sink;            ///< Последовательная запись результатов или nullptr
+    IndexedResultFile* file;     ///< Индексированный файл результатов или nullptr
+    Checkpoint* checkpoint;      ///< Контрольная точка последовательной записи или nullptr
+    ResultCache* cache;          ///< Кэш результатов или nullptr
+    SampleVerifier* verifier;    ///< Выборочная проверка результатов или nullptr
+    chrono::steady_clock::time_point saved; ///< Время последнего сохранения точки
+    mutex wm;                    ///< Мьютекс для защиты кадров в полёте
+    unordered_map<uint64_t, Waiting> waiting; ///< Кадры в полёте по хешу ключа кэша
+    uint64_t repeatCount = 0;    ///< Векторов, получивших результат повторяемого кадра
+
+    /**
+     * @brief Сброс записанных результатов на диск и сохранение точки
+     * @throw system_error при ошибках записи
+     * @details Вызывается при захваченном мьютексе
+     */
+    void save();
+
+public:
+    /**
+     * @brief Конструктор
+     * @param[out] sink Последовательная запись результатов или nullptr
+     * @param[out] file Индексированный файл результатов или nullptr
+     * @param[out] checkpoint Контрольная точка последовательной записи или nullptr
+     * @param[in] first Индекс первого результата, которого ещё нет в sink
+     * @param[out] cache Кэш, в который добавляются результаты кадров, или nullptr
+     * @param[in] verifier Выборочная проверка результатов или nullptr
+     * @details Задаётся ровно один из получателей результатов
+     */
+    OrderedResults(ResultSink* sink, IndexedResultFile* file = nullptr, Checkpoint* checkpoint = nullptr, uint32_t first = 0, ResultCache* cache = nullptr, SampleVerifier* verifier = nullptr);
+
+    /**
+     * @brief Передача результата вектора
+     * @param[in] index Индекс вектора во входном файле
+     * @param[in] result Результат от сервера
+     * @throw system_error при ошибках записи в файл результатов
+     * @details Повторный результат вектора отбрасывается. Результат вектора
+     * из выборки проверки сравнивается с локальным вычислением
+     */
+    void put(uint32_t index, double result);
+
+    /**
+     * @brief Передача результата части разбитого вектора
+     * @param[in] index Индекс вектора во входном файле
+     * @param[in] partial Результат сервера для части вектора
+     * @param[in] parts Общее количество частей вектора
+     * @throw system_error при ошибках записи в файл результатов
+     * @details Сервер возвращает сумму элементов, поэтому результат вектора -
+     * сумма результатов частей; она накапливается компенсированным
+     * суммированием и передаётся в put после прихода последней части
+     */
+    void putPart(uint32_t index, double partial, uint32_t parts);
+
+    /**
+     * @brief Передача результата кадра пакета
+     * @param[in] batch Пакет
+     * @param[in] frame Номер кадра в пакете
+     * @param[in] result Результат от сервера
+     * @throw system_error при ошибках записи в файл результатов
+     * @details Результат части разбитого вектора передаётся в putPart,
+     * целого - в put и, если у кадра есть ключ, в кэш и векторам,
+     * ждущим результата такого же кадра
+     */
+    void putFrame(const Batch& batch, uint32_t frame, double result);
+
+    /**
+     * @brief Ожидание результата такого же кадра, уже отправляемого серверу
+     * @param[in] key Ключ кэша кадра
+     * @param[in] index Индекс вектора
+     * @return true если такой кадр в полёте: вектор получит его результат и
+     * не отправляется; false если кадр отмечен как отправляемый
+     */
+    bool awaitRepeat(const ResultCache::Key& key, uint32_t index);
+
+    /**
+     * @brief Количество повторов кадров в полёте
+     * @return Количество векторов, результат которых взят у такого же
+     * отправленного кадра
+     */
+    uint64_t repeats();
+
+    /**
+     * @brief Количество записанных результатов
+     * @return Количество результатов, записанных подряд с начала
+     * (для индексированного файла - количество заполненных ячеек)
+     */
+    uint32_t written();
+
+    /**
+     * @brief Подготовка к повторной отправке после разрыва соединения
+     * @return Индекс первого вектора без результата
+     * @details Результаты, ожидающие предыдущих, части разбитых векторов
+     * и повторы кадров в полёте отбрасываются: они будут получены заново
+     */
+    uint32_t resume();
+
+    /**
+     * @brief Сохранение контрольной точки вне очереди (перед выходом с ошибкой)
+     * @throw system_error при ошибках записи
+     */
+    void checkpointNow();
+
+    /**
+     * @brief Завершение записи и закрытие файла результатов
+     * @throw system_error при ошибках записи
+     */
+    void close();
+};
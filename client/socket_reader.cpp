@@ -0,0 +1,112 @@
+#include "socket_reader.h"
+#include "metrics.h"
+#include <cstring>
+#include <algorithm>
+#include <climits>
+#include <poll.h>
+
+/**
+ * @brief Конструктор
+ * @param[in] s Дескриптор сокета
+ * @param[in] capacity Размер буфера в байтах
+ */
+SocketReader::SocketReader(int s, size_t capacity) : s(s), buf(max(capacity, sizeof(double)))
+{
+}
+
+/**
+ * @brief Приём очередной порции данных из сокета
+ * @throw system_error при ошибке или закрытии соединения сервером
+ * @details Непрочитанный остаток переносится в начало буфера, после чего
+ * свободное место заполняется одним вызовом recv. Истекший тайм-аут
+ * сокета (SO_RCVTIMEO) или срок ожидания сообщается как ETIMEDOUT
+ */
+void SocketReader::fill()
+{
+    if (head > 0) {
+        memmove(buf.data(), buf.data() + head, tail - head);
+        tail -= head;
+        head = 0;
+    }
+    PhaseTimer timer(Phase::Wait);
+    // Данные ждутся не дольше срока; recv после готовности сокета не блокируется
+    while (deadline != chrono::steady_clock::time_point::max()) {
+        auto left = chrono::ceil<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+        if (left <= 0)
+            throw system_error(ETIMEDOUT, generic_category());
+        pollfd pfd = {s, POLLIN, 0};
+        int ready = poll(&pfd, 1, min<long long>(left, INT_MAX));
+        if (ready > 0)
+            break;
+        if (ready == -1 && errno != EINTR)
+            throw system_error(errno, generic_category());
+    }
+    Metrics* metrics = Metrics::active();
+    for (;;) {
+        ssize_t received = recv(s, buf.data() + tail, buf.size() - tail, 0);
+        if (metrics != nullptr)
+            metrics->received(max<ssize_t>(received, 0));
+        if (received > 0) {
+            tail += received;
+            return;
+        }
+        if (received == 0)
+            throw system_error(ECONNRESET, generic_category());
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            throw system_error(ETIMEDOUT, generic_category());
+        if (errno != EINTR)
+            throw system_error(errno, generic_category());
+    }
+}
+
+/**
+ * @brief Чтение ровно len байт
+ * @param[out] dst Буфер назначения
+ * @param[in] len Количество байт
+ * @throw system_error при ошибке или закрытии соединения сервером
+ */
+void SocketReader::readExact(void* dst, size_t len)
+{
+    char* out = static_cast<char*>(dst);
+    while (len > 0) {
+        if (head == tail)
+            fill();
+        size_t n = min(len, tail - head);
+        memcpy(out, buf.data() + head, n);
+        head += n;
+        out += n;
+        len -= n;
+    }
+}
+
+/**
+ * @brief Чтение текстового сообщения рукопожатия фиксированной длины
+ * @param[in] len Длина сообщения в байтах
+ * @return Принятое сообщение
+ * @throw system_error при ошибке или закрытии соединения сервером
+ */
+string SocketReader::readToken(size_t len)
+{
+    string token(len, '\0');
+    readExact(&token[0], len);
+    return token;
+}
+
+/**
+ * @brief Чтение нескольких результатов за один системный вызов
+ * @param[out] out Массив для результатов
+ * @param[in] max Максимальное количество результатов
+ * @return Количество прочитанных результатов (не менее одного при max > 0)
+ * @throw system_error при ошибке или закрытии соединения сервером
+ */
+size_t SocketReader::readResults(double* out, size_t max)
+{
+    if (max == 0)
+        return 0;
+    while (tail - head < sizeof(double))
+        fill();
+    size_t count = min(max, (tail - head) / sizeof(double));
+    memcpy(out, buf.data() + head, count * sizeof(double));
+    head += count * sizeof(double);
+    return count;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <system_error>
+#include <sys/socket.h>
+#include "errno.h"
+using namespace std;
+
+#define READER_BUFFER_SIZE 65536 ///< Размер буфера чтения из сокета по умолчанию
+
+/**
+ * @class SocketReader
+ * @brief Буферизованное чтение сообщений протокола из сокета
+ * @details Читает данные из сокета крупными порциями и разбивает их на
+ * сообщения фиксированной длины: элементы рукопожатия и 8-байтовые
+ * результаты. Сообщения, разрезанные или склеенные TCP, собираются корректно.
+ * Ожидание данных может ограничиваться сроком (setDeadline), который, в
+ * отличие от тайм-аута сокета, не продлевается каждым принятым байтом.
+ */
+class SocketReader {
+private:
+    int s;              ///< Дескриптор сокета
+    vector<char> buf;   ///< Буфер принятых данных
+    size_t head = 0;    ///< Позиция первого непрочитанного байта
+    size_t tail = 0;    ///< Позиция конца принятых данных
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::time_point::max(); ///< Срок ожидания данных
+
+    /**
+     * @brief Приём очередной порции данных из сокета
+     * @throw system_error при ошибке или закрытии соединения сервером
+     */
+    void fill();
+
+public:
+    /**
+     * @brief Конструктор
+     * @param[in] s Дескриптор сокета
+     * @param[in] capacity Размер буфера в байтах
+     */
+    explicit SocketReader(int s, size_t capacity = READER_BUFFER_SIZE);
+
+    /**
+     * @brief Чтение ровно len байт
+     * @param[out] dst Буфер назначения
+     * @param[in] len Количество байт
+     * @throw system_error при ошибке или закрытии соединения сервером
+     */
+    void readExact(void* dst, size_t len);
+
+    /**
+     * @brief Чтение текстового сообщения рукопожатия фиксированной длины
+     * @param[in] len Длина сообщения в байтах
+     * @return Принятое сообщение
+     * @throw system_error при ошибке или закрытии соединения сервером
+     */
+    string readToken(size_t len);
+
+    /**
+     * @brief Чтение нескольких результатов за один системный вызов
+     * @param[out] out Массив для результатов
+     * @param[in] max Максимальное количество результатов
+     * @return Количество прочитанных результатов (не менее одного при max > 0)
+     * @throw system_error при ошибке или закрытии соединения сервером
+     * @details Возвращает все целые результаты, уже находящиеся в буфере;
+     * обращается к сокету только если буфер не содержит ни одного результата
+     */
+    size_t readResults(double* out, size_t max);
+
+    /**
+     * @brief Установка срока ожидания данных из сокета
+     * @param[in] until Время, после которого ожидание завершается ETIMEDOUT
+     * (time_point::max() - без срока)
+     */
+    void setDeadline(chrono::steady_clock::time_point until) {
+        deadline = until;
+    }
+
+    /**
+     * @brief Количество принятых, но ещё не прочитанных байт
+     * @return Размер непрочитанных данных в буфере
+     */
+    size_t buffered() const {
+        return tail - head;
+    };
+};
@@ -0,0 +1,141 @@
+#include "socket_writer.h"
+#include "metrics.h"
+#include <algorithm>
+#include <cstring>
+#include <sys/sendfile.h>
+
+/**
+ * @brief Конструктор
+ * @param[in] s Дескриптор сокета
+ * @param[in] capacity Размер буфера в байтах
+ */
+SocketWriter::SocketWriter(int s, size_t capacity) : s(s), buf(capacity == 0 ? 1 : capacity)
+{
+}
+
+/**
+ * @brief Запись произвольных данных
+ * @param[in] data Указатель на данные
+ * @param[in] len Длина данных в байтах
+ * @throw system_error при ошибках сетевого взаимодействия
+ */
+void SocketWriter::write(const void* data, size_t len)
+{
+    if (used + len <= buf.size()) {
+        memcpy(buf.data() + used, data, len);
+        used += len;
+        return;
+    }
+    // Данные не помещаются: содержимое буфера и новые данные уходят одним вызовом
+    iovec iov[2];
+    iov[0].iov_base = buf.data();
+    iov[0].iov_len = used;
+    iov[1].iov_base = const_cast<void*>(data);
+    iov[1].iov_len = len;
+    used = 0;
+    sendAll(iov, 2);
+}
+
+/**
+ * @brief Запись кадра вектора: размер и элементы
+ * @param[in] size Количество элементов
+ * @param[in] data Указатель на элементы вектора
+ * @throw system_error при ошибках сетевого взаимодействия
+ */
+void SocketWriter::writeFrame(uint32_t size, const double* data)
+{
+    write(&size, sizeof(size));
+    write(data, size * sizeof(double));
+}
+
+/**
+ * @brief Отправка диапазона файла без копирования в пространство пользователя
+ * @param[in] fd Дескриптор файла
+ * @param[in] offset Смещение начала диапазона
+ * @param[in] len Длина диапазона в байтах
+ * @throw system_error при ошибках чтения файла или сетевого взаимодействия
+ */
+void SocketWriter::sendFile(int fd, size_t offset, size_t len)
+{
+    flush();
+    PhaseTimer timer(Phase::Send);
+    Metrics* metrics = Metrics::active();
+    off_t off = offset;
+    while (len > 0) {
+        ssize_t sent = sendfile(s, fd, &off, len);
+        if (metrics != nullptr)
+            metrics->sent(max<ssize_t>(sent, 0));
+        if (sent == -1) {
+            if (errno == EINTR)
+                continue;
+            // Истёк тайм-аут сокета (SO_SNDTIMEO): сервер не принимает данные
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                throw system_error(ETIMEDOUT, generic_category());
+            throw system_error(errno, generic_category());
+        }
+        if (sent == 0)
+            throw system_error(EINVAL, generic_category());
+        len -= sent;
+    }
+}
+
+/**
+ * @brief Отправка всех накопленных данных
+ * @throw system_error при ошибках сетевого взаимодействия
+ */
+void SocketWriter::flush()
+{
+    if (used == 0)
+        return;
+    iovec iov;
+    iov.iov_base = buf.data();
+    iov.iov_len = used;
+    used = 0;
+    sendAll(&iov, 1);
+}
+
+/**
+ * @brief Отправка набора фрагментов целиком
+ * @param[in] iov Массив фрагментов (изменяется при частичной записи)
+ * @param[in] count Количество фрагментов
+ * @throw system_error при ошибках сетевого взаимодействия
+ * @details MSG_NOSIGNAL заменяет SIGPIPE при разрыве соединения на ошибку EPIPE
+ */
+void SocketWriter::sendAll(iovec* iov, size_t count)
+{
+    PhaseTimer timer(Phase::Send);
+    Metrics* metrics = Metrics::active();
+    while (count > 0) {
+        // Пропуск полностью отправленных фрагментов
+        if (iov->iov_len == 0) {
+            iov++;
+            count--;
+            continue;
+        }
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t sent = sendmsg(s, &msg, MSG_NOSIGNAL);
+        if (metrics != nullptr)
+            metrics->sent(max<ssize_t>(sent, 0));
+        if (sent == -1) {
+            if (errno == EINTR)
+                continue;
+            // Истёк тайм-аут сокета (SO_SNDTIMEO): сервер не принимает данные
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                throw system_error(ETIMEDOUT, generic_category());
+            throw system_error(errno, generic_category());
+        }
+        // Сдвиг фрагментов на количество отправленных байт
+        size_t rest = sent;
+        while (rest > 0 && rest >= iov->iov_len) {
+            rest -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (rest > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + rest;
+            iov->iov_len -= rest;
+        }
+    }
+}
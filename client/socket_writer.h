@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <system_error>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "errno.h"
+using namespace std;
+
+#define WRITER_BUFFER_SIZE 65536 ///< Размер буфера записи в сокет по умолчанию
+
+/**
+ * @class SocketWriter
+ * @brief Буферизованная запись кадров протокола в сокет
+ * @details Накапливает заголовки и небольшие векторы в буфере и отправляет их
+ * крупными порциями. Данные, не помещающиеся в буфер, отправляются вместе с
+ * содержимым буфера одним вызовом sendmsg (scatter-gather) без копирования.
+ * Частичная запись обрабатывается повторными вызовами до полной отправки.
+ */
+class SocketWriter {
+private:
+    int s;              ///< Дескриптор сокета
+    vector<char> buf;   ///< Буфер накопления данных
+    size_t used = 0;    ///< Количество занятых байт буфера
+
+    /**
+     * @brief Отправка набора фрагментов целиком
+     * @param[in] iov Массив фрагментов (изменяется при частичной записи)
+     * @param[in] count Количество фрагментов
+     * @throw system_error при ошибках сетевого взаимодействия
+     */
+    void sendAll(iovec* iov, size_t count);
+
+public:
+    /**
+     * @brief Конструктор
+     * @param[in] s Дескриптор сокета
+     * @param[in] capacity Размер буфера в байтах
+     */
+    explicit SocketWriter(int s, size_t capacity = WRITER_BUFFER_SIZE);
+
+    /**
+     * @brief Запись произвольных данных
+     * @param[in] data Указатель на данные
+     * @param[in] len Длина данных в байтах
+     * @throw system_error при ошибках сетевого взаимодействия
+     * @details Данные копируются в буфер, если помещаются; иначе буфер и данные
+     * отправляются одним системным вызовом
+     */
+    void write(const void* data, size_t len);
+
+    /**
+     * @brief Запись кадра вектора: размер и элементы
+     * @param[in] size Количество элементов
+     * @param[in] data Указатель на элементы вектора
+     * @throw system_error при ошибках сетевого взаимодействия
+     */
+    void writeFrame(uint32_t size, const double* data);
+
+    /**
+     * @brief Отправка диапазона файла без копирования в пространство пользователя
+     * @param[in] fd Дескриптор файла
+     * @param[in] offset Смещение начала диапазона
+     * @param[in] len Длина диапазона в байтах
+     * @throw system_error при ошибках чтения файла или сетевого взаимодействия
+     * @details Перед передачей файла отправляет накопленные в буфере данные
+     */
+    void sendFile(int fd, size_t offset, size_t len);
+
+    /**
+     * @brief Отправка всех накопленных данных
+     * @throw system_error при ошибках сетевого взаимодействия
+     */
+    void flush();
+
+    /**
+     * @brief Количество данных, ожидающих отправки
+     * @return Размер содержимого буфера в байтах
+     */
+    size_t pending() const {
+        return used;
+    };
+};
@@ -0,0 +1,130 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <utility>
+using namespace std;
+
+/**
+ * @class SpscRing
+ * @brief Ограниченная кольцевая очередь без блокировок для одного производителя и одного потребителя
+ * @tparam T Тип элемента (перемещается в очередь и из неё)
+ * @details Позиции записи и чтения - атомарные счётчики на разных строках
+ * кэша, поэтому передача элемента не требует мьютекса. Заполненная очередь
+ * останавливает производителя (обратное давление), пустая - потребителя;
+ * ожидание выполняется через atomic::wait на счётчике событий, без активного опроса.
+ */
+template <typename T>
+class SpscRing {
+private:
+    vector<T> slots;                        ///< Ячейки очереди (размер - степень двойки)
+    size_t mask;                            ///< Маска индекса ячейки
+    alignas(64) atomic<size_t> head{0};     ///< Позиция чтения (изменяет потребитель)
+    alignas(64) atomic<size_t> tail{0};     ///< Позиция записи (изменяет производитель)
+    alignas(64) atomic<uint32_t> events{0}; ///< Счётчик событий для пробуждения ожидающих
+    atomic<bool> closed{false};             ///< Признак закрытия очереди
+
+    /**
+     * @brief Уведомление ожидающей стороны об изменении состояния
+     */
+    void signal() {
+        events.fetch_add(1, memory_order_release);
+        events.notify_all();
+    }
+
+    /**
+     * @brief Округление вместимости вверх до степени двойки
+     * @param[in] capacity Требуемая вместимость
+     * @return Вместимость очереди
+     */
+    static size_t roundUp(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity)
+            size <<= 1;
+        return size;
+    }
+
+public:
+    /**
+     * @brief Конструктор
+     * @param[in] capacity Вместимость очереди (округляется вверх до степени двойки)
+     */
+    explicit SpscRing(size_t capacity) : slots(roundUp(capacity)), mask(slots.size() - 1) {
+    }
+
+    /**
+     * @brief Попытка поместить элемент без ожидания
+     * @param[in,out] item Элемент (перемещается в очередь при успехе)
+     * @return false если очередь заполнена или закрыта
+     */
+    bool tryPush(T& item) {
+        if (closed.load(memory_order_acquire))
+            return false;
+        size_t t = tail.load(memory_order_relaxed);
+        if (t - head.load(memory_order_acquire) == slots.size())
+            return false;
+        slots[t & mask] = std::move(item);
+        tail.store(t + 1, memory_order_release);
+        signal();
+        return true;
+    }
+
+    /**
+     * @brief Поместить элемент, ожидая свободную ячейку
+     * @param[in,out] item Элемент (перемещается в очередь при успехе)
+     * @return false если очередь закрыта
+     */
+    bool push(T& item) {
+        for (;;) {
+            uint32_t seen = events.load(memory_order_acquire);
+            if (tryPush(item))
+                return true;
+            if (closed.load(memory_order_acquire))
+                return false;
+            events.wait(seen, memory_order_acquire);
+        }
+    }
+
+    /**
+     * @brief Попытка извлечь элемент без ожидания
+     * @param[out] item Извлечённый элемент
+     * @return false если очередь пуста
+     */
+    bool tryPop(T& item) {
+        size_t h = head.load(memory_order_relaxed);
+        if (h == tail.load(memory_order_acquire))
+            return false;
+        item = std::move(slots[h & mask]);
+        head.store(h + 1, memory_order_release);
+        signal();
+        return true;
+    }
+
+    /**
+     * @brief Извлечь элемент, ожидая его появления
+     * @param[out] item Извлечённый элемент
+     * @return false если очередь пуста и закрыта
+     */
+    bool pop(T& item) {
+        for (;;) {
+            uint32_t seen = events.load(memory_order_acquire);
+            if (tryPop(item))
+                return true;
+            if (closed.load(memory_order_acquire))
+                return tryPop(item);
+            events.wait(seen, memory_order_acquire);
+        }
+    }
+
+    /**
+     * @brief Закрыть очередь
+     * @details Производитель больше не может добавлять элементы; потребитель
+     * дочитывает оставшиеся. Вызывается производителем по окончании данных
+     * или любой стороной при ошибке.
+     */
+    void close() {
+        closed.store(true, memory_order_release);
+        signal();
+    }
+};
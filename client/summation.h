@@ -0,0 +1,37 @@
+#pragma once
+#include <cmath>
+using namespace std;
+
+/**
+ * @struct NeumaierSum
+ * @brief Компенсированное суммирование (алгоритм Ноймайера, улучшенный Кэхэн)
+ * @details Хранит сумму и поправку с потерянными младшими разрядами, поэтому
+ * погрешность не растёт с количеством слагаемых и не зависит от их порядка
+ * так сильно, как при обычном суммировании. В отличие от алгоритма Кэхэна
+ * корректно обрабатывает слагаемые, большие текущей суммы.
+ */
+struct NeumaierSum {
+    double sum = 0;          ///< Накопленная сумма
+    double compensation = 0; ///< Накопленная поправка
+
+    /**
+     * @brief Добавление слагаемого
+     * @param[in] x Слагаемое
+     */
+    void add(double x) {
+        double t = sum + x;
+        if (fabs(sum) >= fabs(x))
+            compensation += (sum - t) + x;
+        else
+            compensation += (x - t) + sum;
+        sum = t;
+    }
+
+    /**
+     * @brief Итоговое значение суммы с учётом поправки
+     * @return Сумма слагаемых
+     */
+    double value() const {
+        return sum + compensation;
+    }
+};
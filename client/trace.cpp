@@ -0,0 +1,157 @@
+#include "trace.h"
+#include <cstdio>
+#include <fstream>
+
+Tracer* Tracer::instance = nullptr;
+
+/**
+ * @brief Имена видов интервалов в трассе
+ */
+static const char* const TRACE_NAMES[size_t(TraceKind::Count)] = {"parse", "enqueue", "send", "result", "write"};
+
+/**
+ * @brief Имя текущего потока, заданное до создания его кольца
+ */
+static thread_local string localName;
+
+/**
+ * @struct LocalRing
+ * @brief Кольцо текущего потока, освобождаемое при его завершении
+ */
+struct LocalRing {
+    Tracer* tracer = nullptr;  ///< Трассировка, выдавшая кольцо
+    TraceRing* ring = nullptr; ///< Кольцо потока
+
+    /**
+     * @brief Деструктор: возврат кольца трассировке
+     */
+    ~LocalRing() {
+        if (ring != nullptr)
+            tracer->release(ring);
+    }
+};
+
+/**
+ * @brief Кольцо текущего потока
+ */
+static thread_local LocalRing localRing;
+
+/**
+ * @brief Конструктор: трасса начинает отсчёт времени
+ */
+Tracer::Tracer() : started(chrono::steady_clock::now())
+{
+}
+
+/**
+ * @brief Включение трассировки процесса
+ */
+void Tracer::enable()
+{
+    static Tracer tracer; ///< Трассировка процесса
+    instance = &tracer;
+}
+
+/**
+ * @brief Имя текущего потока в трассе
+ * @param[in] name Имя потока
+ */
+void Tracer::threadName(const string& name)
+{
+    localName = name;
+    if (localRing.ring != nullptr)
+        localRing.ring->name = name;
+}
+
+/**
+ * @brief Кольцо текущего потока (создаётся при первом вызове)
+ * @return Кольцо потока
+ * @details После TRACE_RING_LIMIT колец поток получает кольцо, которое
+ * освободилось раньше других, если такое есть
+ */
+TraceRing* Tracer::ring()
+{
+    if (localRing.ring == nullptr) {
+        lock_guard<mutex> lock(m);
+        if (rings.size() >= TRACE_RING_LIMIT && !spare.empty()) {
+            TraceRing* reused = spare.front();
+            spare.pop_front();
+            recycled += reused->reset(localName.empty() ? "thread " + to_string(reused->tid) : localName);
+            localRing.ring = reused;
+        } else {
+            uint32_t tid = rings.size() + 1;
+            rings.push_back(make_unique<TraceRing>(tid, localName.empty() ? "thread " + to_string(tid) : localName));
+            localRing.ring = rings.back().get();
+        }
+        localRing.tracer = this;
+    }
+    return localRing.ring;
+}
+
+/**
+ * @brief Освобождение кольца завершившегося потока
+ * @param[in] ring Кольцо потока
+ * @details События кольца остаются в трассе, пока кольцо не понадобится
+ * новому потоку
+ */
+void Tracer::release(TraceRing* ring)
+{
+    lock_guard<mutex> lock(m);
+    spare.push_back(ring);
+}
+
+/**
+ * @brief Количество колец
+ * @return Колец, выделенных за всё время трассировки
+ */
+size_t Tracer::ringCount()
+{
+    lock_guard<mutex> lock(m);
+    return rings.size();
+}
+
+/**
+ * @brief Запись трассы в файл в формате Chrome trace event (JSON)
+ * @param[in] path Путь к файлу
+ * @throw system_error при ошибках записи
+ * @details Интервалы записываются событиями "X" (начало и длительность в
+ * микросекундах) с индексом первого вектора и количеством векторов в
+ * args, имена потоков - событиями метаданных "M". Количество
+ * перезаписанных в кольцах событий и событий колец, переданных новым
+ * потокам, выводится в otherData.dropped
+ */
+void Tracer::save(const string& path)
+{
+    ofstream out(path, ios::trunc);
+    if (!out.is_open())
+        throw system_error(errno, generic_category());
+    lock_guard<mutex> lock(m);
+    uint64_t dropped = recycled; ///< Перезаписанных и отброшенных событий
+    char line[256];
+    out << "{\"traceEvents\":[\n";
+    bool first = true;
+    for (const unique_ptr<TraceRing>& ring : rings) {
+        snprintf(line, sizeof(line), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"",
+                 first ? "" : ",\n", ring->tid);
+        out << line;
+        for (char c : ring->name)
+            if (c != '"' && c != '\\')
+                out << c;
+        out << "\"}}";
+        first = false;
+        uint64_t written = ring->written();
+        uint64_t begin = written > TRACE_RING_EVENTS ? written - TRACE_RING_EVENTS : 0;
+        dropped += begin;
+        for (uint64_t n = begin; n < written; n++) {
+            const TraceEvent& e = ring->at(n);
+            snprintf(line, sizeof(line),
+                     ",\n{\"name\":\"%s\",\"cat\":\"vector\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"index\":%u,\"count\":%u}}",
+                     TRACE_NAMES[size_t(e.kind)], ring->tid, e.start / 1e3, e.duration / 1e3, e.index, e.count);
+            out << line;
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped\":" << dropped << "}}\n";
+    out.close();
+    if (out.fail())
+        throw system_error(EIO, generic_category());
+}
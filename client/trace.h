@@ -0,0 +1,258 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <system_error>
+#include "errno.h"
+using namespace std;
+
+#define TRACE_RING_EVENTS (1 << 16) ///< Событий в кольце потока (степень двойки; старые перезаписываются)
+#define TRACE_RING_LIMIT 32 ///< Колец, после которых кольца завершившихся потоков отдаются новым
+
+/**
+ * @enum TraceKind
+ * @brief Виды интервалов трассировки векторов
+ */
+enum class TraceKind : uint8_t {
+    Parse,   ///< Разбор вектора из входного файла
+    Enqueue, ///< Передача разобранного вектора или пакета в очередь на отправку
+    Send,    ///< Ожидание места в окне и запись вектора в сокет
+    Result,  ///< Ожидание и приём результатов (до первого байта и чтение)
+    Write,   ///< Запись результатов
+    Count    ///< Количество видов
+};
+
+/**
+ * @struct TraceEvent
+ * @brief Интервал трассировки
+ */
+struct TraceEvent {
+    uint64_t start;     ///< Начало в наносекундах от включения трассировки
+    uint64_t duration;  ///< Длительность в наносекундах
+    uint32_t index;     ///< Индекс первого вектора во входном файле
+    uint32_t count;     ///< Количество векторов
+    TraceKind kind;     ///< Вид интервала
+};
+
+/**
+ * @class TraceRing
+ * @brief Кольцо событий одного потока
+ * @details Пишет в кольцо только поток-владелец, без блокировок; при
+ * переполнении перезаписываются самые старые события. Читается кольцо
+ * после завершения потоков задания
+ */
+class TraceRing {
+private:
+    vector<TraceEvent> events;   ///< События (кольцо)
+    atomic<uint64_t> head{0};    ///< Количество записанных событий за всё время
+
+public:
+    string name;   ///< Имя потока
+    uint32_t tid;  ///< Номер потока в трассе
+
+    /**
+     * @brief Конструктор
+     * @param[in] tid Номер потока в трассе
+     * @param[in] name Имя потока
+     */
+    TraceRing(uint32_t tid, const string& name) : events(TRACE_RING_EVENTS), name(name), tid(tid) {}
+
+    /**
+     * @brief Запись события
+     * @param[in] event Событие
+     */
+    void push(const TraceEvent& event) {
+        uint64_t h = head.load(memory_order_relaxed);
+        events[h & (TRACE_RING_EVENTS - 1)] = event;
+        head.store(h + 1, memory_order_release);
+    }
+
+    /**
+     * @brief Количество записанных событий
+     * @return Событий за всё время, включая перезаписанные
+     */
+    uint64_t written() const {
+        return head.load(memory_order_acquire);
+    }
+
+    /**
+     * @brief Событие по порядковому номеру
+     * @param[in] n Номер события (из последних TRACE_RING_EVENTS)
+     * @return Событие
+     */
+    const TraceEvent& at(uint64_t n) const {
+        return events[n & (TRACE_RING_EVENTS - 1)];
+    }
+
+    /**
+     * @brief Передача кольца новому потоку
+     * @param[in] name Имя нового потока
+     * @return Количество событий прежнего потока, которые отбрасываются
+     */
+    uint64_t reset(const string& name) {
+        this->name = name;
+        return head.exchange(0, memory_order_acq_rel);
+    }
+};
+
+/**
+ * @class Tracer
+ * @brief Трассировка векторов по потокам в формате Chrome trace event
+ * @details Экземпляр создаётся один раз на процесс вызовом enable(); пока
+ * трассировка не включена, active() возвращает nullptr и интервалы не
+ * записываются. Каждый поток получает своё кольцо при первом событии
+ * (под мьютексом, один раз), дальше события пишутся без блокировок.
+ * Кольцо завершившегося потока остаётся в трассе, но когда колец уже
+ * TRACE_RING_LIMIT, новый поток получает кольцо, освободившееся раньше
+ * других, а события прежнего владельца учитываются как отброшенные.
+ * Поэтому в режиме службы, где каждое задание запускает новые потоки,
+ * память трассировки ограничена TRACE_RING_LIMIT кольцами (или числом
+ * одновременно работающих потоков, если их больше), а в трассе при
+ * выходе остаются потоки последних заданий.
+ * Трасса сохраняется после завершения задания и открывается в
+ * chrome://tracing или Perfetto: по потокам видно, где конвейер простаивал
+ * и кто - клиент или сервер - задержал векторы.
+ */
+class Tracer {
+private:
+    static Tracer* instance; ///< Трассировка процесса или nullptr
+
+    chrono::steady_clock::time_point started; ///< Время включения трассировки
+    mutex m;                                  ///< Мьютекс для защиты списка колец
+    vector<unique_ptr<TraceRing>> rings;      ///< Кольца потоков
+    deque<TraceRing*> spare;                  ///< Кольца завершившихся потоков в порядке завершения
+    uint64_t recycled = 0;                    ///< Событий, отброшенных при передаче колец новым потокам
+
+    Tracer();
+
+    /**
+     * @brief Кольцо текущего потока (создаётся при первом вызове)
+     * @return Кольцо потока
+     */
+    TraceRing* ring();
+
+public:
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    /**
+     * @brief Включение трассировки процесса
+     * @details Вызывается до запуска потоков; повторный вызов ничего не меняет
+     */
+    static void enable();
+
+    /**
+     * @brief Трассировка процесса
+     * @return Трассировка или nullptr, если она не включена
+     */
+    static Tracer* active() {
+        return instance;
+    }
+
+    /**
+     * @brief Выключение трассировки процесса
+     * @details Новые интервалы не записываются; записанные сохраняются до
+     * повторного включения
+     */
+    static void disable() {
+        instance = nullptr;
+    }
+
+    /**
+     * @brief Освобождение кольца завершившегося потока
+     * @param[in] ring Кольцо потока
+     * @details Вызывается при завершении потока
+     */
+    void release(TraceRing* ring);
+
+    /**
+     * @brief Количество колец
+     * @return Колец, выделенных за всё время трассировки
+     */
+    size_t ringCount();
+
+    /**
+     * @brief Имя текущего потока в трассе
+     * @param[in] name Имя потока
+     */
+    static void threadName(const string& name);
+
+    /**
+     * @brief Текущее время трассы
+     * @return Наносекунды от включения трассировки
+     */
+    uint64_t now() const {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - started).count();
+    }
+
+    /**
+     * @brief Запись интервала текущего потока
+     * @param[in] kind Вид интервала
+     * @param[in] start Начало интервала (now())
+     * @param[in] index Индекс первого вектора
+     * @param[in] count Количество векторов
+     */
+    void record(TraceKind kind, uint64_t start, uint32_t index, uint32_t count) {
+        ring()->push({start, now() - start, index, count, kind});
+    }
+
+    /**
+     * @brief Запись трассы в файл в формате Chrome trace event (JSON)
+     * @param[in] path Путь к файлу
+     * @throw system_error при ошибках записи
+     */
+    void save(const string& path);
+};
+
+/**
+ * @class TraceSpan
+ * @brief Интервал трассировки от создания до уничтожения объекта
+ * @details Если трассировка не включена, часы не читаются
+ */
+class TraceSpan {
+private:
+    Tracer* tracer;    ///< Трассировка или nullptr
+    TraceKind kind;    ///< Вид интервала
+    uint32_t index;    ///< Индекс первого вектора
+    uint32_t count;    ///< Количество векторов
+    uint64_t start = 0; ///< Начало интервала
+
+public:
+    /**
+     * @brief Конструктор: начало интервала
+     * @param[in] kind Вид интервала
+     * @param[in] index Индекс первого вектора
+     * @param[in] count Количество векторов
+     */
+    TraceSpan(TraceKind kind, uint32_t index, uint32_t count = 1)
+        : tracer(Tracer::active()), kind(kind), index(index), count(count) {
+        if (tracer != nullptr)
+            start = tracer->now();
+    }
+
+    /**
+     * @brief Деструктор: запись интервала
+     */
+    ~TraceSpan() {
+        if (tracer != nullptr && count > 0)
+            tracer->record(kind, start, index, count);
+    }
+
+    /**
+     * @brief Уточнение векторов интервала, известных только к его концу
+     * @param[in] index Индекс первого вектора
+     * @param[in] count Количество векторов (0 - интервал не записывается)
+     */
+    void range(uint32_t index, uint32_t count) {
+        this->index = index;
+        this->count = count;
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+};
@@ -0,0 +1,252 @@
+#include "window.h"
+#include "metrics.h"
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief Конструктор
+ * @param[in] limit Размер окна (в адаптивном режиме - наибольший; 0 трактуется как 1)
+ * @param[in] adaptive Адаптивный режим
+ * @param[in] timeout Срок ответа на вектор в миллисекундах (0 - без срока)
+ */
+WindowController::WindowController(uint32_t limit, bool adaptive, uint32_t timeout)
+    : adaptive(adaptive), measured(Metrics::active() != nullptr), timeout(timeout), maxLimit(max<uint32_t>(1, limit)),
+      current(adaptive ? min<uint32_t>(WINDOW_INITIAL, maxLimit) : maxLimit)
+{
+}
+
+/**
+ * @brief Отметка об отправке вектора
+ * @param[in] now Время отправки
+ */
+void WindowController::onSend(Clock::time_point now)
+{
+    if (!adaptive && !measured && timeout == 0)
+        return;
+    if (sent.empty() && roundResults == 0)
+        roundStart = now;
+    sent.push_back(now);
+    unflushed++;
+}
+
+/**
+ * @brief Отметка о сбросе в сокет кадров отправленных векторов
+ * @param[in] now Время завершения сброса
+ */
+void WindowController::onFlush(Clock::time_point now)
+{
+    for (auto it = sent.end() - unflushed; it != sent.end(); ++it)
+        *it = now;
+    unflushed = 0;
+}
+
+/**
+ * @brief Отметка о получении результатов
+ * @param[in] count Количество результатов
+ * @param[in] now Время получения
+ * @details Все результаты одного чтения получают одно время прихода
+ */
+void WindowController::onReceive(uint32_t count, Clock::time_point now)
+{
+    if (!adaptive && !measured && timeout == 0)
+        return;
+    for (uint32_t i = 0; i < count && !sent.empty(); i++) {
+        chrono::duration<double, milli> rtt = now - sent.front();
+        if (measured)
+            Metrics::active()->addRtt(now - sent.front());
+        if (probing && sent.front() >= probeStart) {
+            if (probeSamples++ == 0 || rtt.count() < probeRtt)
+                probeRtt = rtt.count();
+        }
+        // Результат пришёл до отметки сброса: буфер ушёл в сокет раньше,
+        // при переполнении, и остаётся время занятия места в окне
+        if (sent.size() <= unflushed)
+            unflushed--;
+        sent.pop_front();
+        if (baseRtt == 0 || rtt.count() < baseRtt)
+            baseRtt = rtt.count();
+        roundRtt += rtt.count();
+        roundResults++;
+    }
+    if (!adaptive)
+        return;
+    if (probing) {
+        // Замер окончен: задержка без очереди становится новой наименьшей
+        if (probeSamples < WINDOW_ROUND_MIN)
+            return;
+        baseRtt = probeRtt;
+        current = saved;
+        probing = false;
+        roundStart = now;
+        roundResults = 0;
+        roundRtt = 0;
+        return;
+    }
+    if (roundResults >= max<uint32_t>(current, WINDOW_ROUND_MIN))
+        endRound(now);
+}
+
+/**
+ * @brief Срок ответа на самый старый вектор без ответа
+ * @param[in] now Текущее время
+ * @return Время отправки вектора плюс тайм-аут; now плюс тайм-аут, если
+ * кадр вектора ещё не сброшен в сокет; time_point::max() без тайм-аута
+ * или без векторов в полёте
+ */
+WindowController::Clock::time_point WindowController::deadline(Clock::time_point now) const
+{
+    if (timeout == 0 || sent.empty())
+        return Clock::time_point::max();
+    // Кадр ещё пишется отправителем: срок отсчитывается от текущего момента
+    if (sent.size() <= unflushed)
+        return now + chrono::milliseconds(timeout);
+    return sent.front() + chrono::milliseconds(timeout);
+}
+
+/**
+ * @brief Завершение раунда и пересчёт окна
+ * @param[in] now Время получения последнего результата раунда
+ */
+void WindowController::endRound(Clock::time_point now)
+{
+    chrono::duration<double, milli> elapsed = now - roundStart;
+    double rate = roundResults / max(elapsed.count(), 1e-3); ///< Скорость раунда
+    double rtt = roundRtt / roundResults;                    ///< Средняя задержка раунда
+    roundStart = now;
+    roundResults = 0;
+    roundRtt = 0;
+
+    rates.push_back(rate);
+    if (rates.size() > WINDOW_RATE_ROUNDS)
+        rates.pop_front();
+    if (startup) {
+        // Разгон: окно удваивается, пока скорость заметно растёт
+        if (rate >= bestRate * WINDOW_GROWTH) {
+            bestRate = rate;
+            plateau = 0;
+            current = min<uint64_t>(uint64_t(current) * 2, maxLimit);
+            return;
+        }
+        if (++plateau < WINDOW_PLATEAU_ROUNDS)
+            return;
+        startup = false;
+    }
+
+    double bandwidth = *max_element(rates.begin(), rates.end()); ///< Наибольшая скорость
+    double target = WINDOW_GAIN * bandwidth * baseRtt;           ///< Окно без простоя и без лишней очереди
+    bool rise = rtt > WINDOW_RTT_RISE * max(baseRtt, current / bandwidth); ///< Задержка выросла
+    if (rise) {
+        // Задержка выросла сверх объяснимой собственной очередью: сеть или
+        // сервер перегружены, окно уменьшается, скорость оценивается заново,
+        // а наименьшая задержка сразу замеряется повторно
+        target = current / 2.0;
+        rates.clear();
+        rates.push_back(rate);
+    }
+    current = uint32_t(min<double>(max(1.0, ceil(target)), maxLimit));
+    if (++steadyRounds % WINDOW_PROBE_ROUNDS == 0 || rise) {
+        probing = true;
+        saved = current;
+        current = min<uint32_t>(current, WINDOW_ROUND_MIN);
+        probeStart = now;
+        probeSamples = 0;
+    }
+}
+
+/**
+ * @brief Конструктор окна
+ * @param[in] limit Максимальное количество векторов в полёте (0 трактуется как 1)
+ * @param[in] adaptive Подбирать размер окна не больше limit по задержке и скорости
+ * @param[in] timeout Срок ответа на вектор в миллисекундах (0 - без срока)
+ */
+InFlightWindow::InFlightWindow(uint32_t limit, bool adaptive, uint32_t timeout) : control(limit, adaptive, timeout)
+{
+}
+
+/**
+ * @brief Занять место в окне
+ * @return false если окно было закрыто
+ */
+bool InFlightWindow::acquire()
+{
+    unique_lock<mutex> lock(m);
+    cv.wait(lock, [this]{ return closed || inFlight < control.limit(); });
+    if (closed)
+        return false;
+    control.onSend();
+    if (inFlight++ == 0)
+        busy.notify_all();
+    return true;
+}
+
+/**
+ * @brief Попытка занять место в окне без ожидания
+ * @return true если место занято, false если окно заполнено или закрыто
+ */
+bool InFlightWindow::tryAcquire()
+{
+    lock_guard<mutex> lock(m);
+    if (closed || inFlight >= control.limit())
+        return false;
+    control.onSend();
+    if (inFlight++ == 0)
+        busy.notify_all();
+    return true;
+}
+
+/**
+ * @brief Освободить места в окне после получения результатов
+ * @param[in] count Количество полученных результатов
+ */
+void InFlightWindow::release(uint32_t count)
+{
+    {
+        lock_guard<mutex> lock(m);
+        inFlight -= min(count, inFlight);
+        control.onReceive(count);
+    }
+    cv.notify_one();
+}
+
+/**
+ * @brief Отметка о сбросе в сокет кадров векторов, занявших места в окне
+ */
+void InFlightWindow::flushed()
+{
+    lock_guard<mutex> lock(m);
+    control.onFlush();
+}
+
+/**
+ * @brief Срок ответа на самый старый вектор в полёте
+ * @return Время, до которого должен прийти его результат
+ */
+chrono::steady_clock::time_point InFlightWindow::deadline()
+{
+    lock_guard<mutex> lock(m);
+    return control.deadline();
+}
+
+/**
+ * @brief Ожидание хотя бы одного вектора в полёте
+ * @return false если окно было закрыто
+ */
+bool InFlightWindow::waitInFlight()
+{
+    unique_lock<mutex> lock(m);
+    busy.wait(lock, [this]{ return closed || inFlight > 0; });
+    return !closed;
+}
+
+/**
+ * @brief Закрыть окно и разбудить все ожидающие потоки
+ */
+void InFlightWindow::close()
+{
+    {
+        lock_guard<mutex> lock(m);
+        closed = true;
+    }
+    cv.notify_all();
+    busy.notify_all();
+}
@@ -0,0 +1,191 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+using namespace std;
+
+#define WINDOW_INITIAL 4          ///< Начальный размер адаптивного окна
+#define WINDOW_ROUND_MIN 4        ///< Наименьшее количество результатов в раунде замера
+#define WINDOW_GROWTH 1.25        ///< Рост скорости за раунд, при котором окно ещё удваивается
+#define WINDOW_PLATEAU_ROUNDS 3   ///< Раундов без роста скорости до выхода из разгона
+#define WINDOW_RATE_ROUNDS 10     ///< Раундов, по которым берётся наибольшая скорость
+#define WINDOW_GAIN 2.0           ///< Запас окна над произведением скорости на задержку
+#define WINDOW_RTT_RISE 4.0       ///< Рост задержки над ожидаемой, при котором окно уменьшается
+#define WINDOW_PROBE_ROUNDS 64    ///< Раундов между замерами наименьшей задержки
+
+/**
+ * @class WindowController
+ * @brief Подбор размера окна по измеренной задержке и скорости
+ * @details В фиксированном режиме окно равно заданному пределу. В
+ * адаптивном режиме время от отправки каждого вектора до его результата
+ * (результаты приходят в порядке отправки; временем отправки считается
+ * сброс в сокет буфера, в который записан кадр) и скорость получения
+ * результатов измеряются раундами: раунд длится, пока не придёт столько
+ * результатов, сколько помещается в окно. Сначала окно удваивается каждый
+ * раунд, пока скорость растёт (разгон). Когда скорость перестаёт расти,
+ * окно устанавливается в WINDOW_GAIN произведений наибольшей скорости
+ * последних раундов на наименьшую задержку - столько векторов нужно, чтобы
+ * канал и сервер не простаивали, без лишней очереди. Если задержка раунда
+ * превышает ожидаемую для такого окна в WINDOW_RTT_RISE раз, окно
+ * уменьшается вдвое, а оценка скорости начинается заново. Раз в
+ * WINDOW_PROBE_ROUNDS раундов окно на время сокращается до WINDOW_ROUND_MIN,
+ * чтобы измерить задержку без очереди: так оценка следует за изменением
+ * сети. Если включены метрики, время каждого вектора учитывается в
+ * гистограмме в любом режиме. С тайм-аутом ответа время отправки векторов
+ * хранится и в фиксированном режиме: срок ответа - время отправки самого
+ * старого вектора без ответа плюс тайм-аут. Класс не потокобезопасен.
+ */
+class WindowController {
+private:
+    using Clock = chrono::steady_clock;
+
+    bool adaptive;                ///< Адаптивный режим
+    bool measured;                ///< Метрики включены: время векторов учитывается
+    uint32_t timeout;             ///< Срок ответа на вектор в миллисекундах (0 - без срока)
+    uint32_t maxLimit;            ///< Наибольший размер окна
+    uint32_t current;             ///< Текущий размер окна
+    deque<Clock::time_point> sent; ///< Время отправки векторов без ответа
+    uint32_t unflushed = 0;       ///< Последних векторов sent, кадры которых ещё не сброшены в сокет
+    double baseRtt = 0;           ///< Наименьшая задержка в миллисекундах (0 - ещё нет замеров)
+    Clock::time_point roundStart; ///< Начало раунда
+    uint32_t roundResults = 0;    ///< Результатов в раунде
+    double roundRtt = 0;          ///< Сумма задержек раунда в миллисекундах
+    bool startup = true;          ///< Разгон
+    uint32_t plateau = 0;         ///< Раундов разгона без роста скорости
+    double bestRate = 0;          ///< Наибольшая скорость разгона (результатов в миллисекунду)
+    deque<double> rates;          ///< Скорости последних раундов
+    uint32_t steadyRounds = 0;    ///< Раундов после разгона
+    bool probing = false;         ///< Идёт замер наименьшей задержки
+    uint32_t saved = 0;           ///< Размер окна до замера
+    Clock::time_point probeStart; ///< Начало замера
+    double probeRtt = 0;          ///< Наименьшая задержка замера в миллисекундах
+    uint32_t probeSamples = 0;    ///< Векторов, отправленных после начала замера
+
+    /**
+     * @brief Завершение раунда и пересчёт окна
+     * @param[in] now Время получения последнего результата раунда
+     */
+    void endRound(Clock::time_point now);
+
+public:
+    /**
+     * @brief Конструктор
+     * @param[in] limit Размер окна (в адаптивном режиме - наибольший; 0 трактуется как 1)
+     * @param[in] adaptive Адаптивный режим
+     * @param[in] timeout Срок ответа на вектор в миллисекундах (0 - без срока)
+     */
+    explicit WindowController(uint32_t limit = 1, bool adaptive = false, uint32_t timeout = 0);
+
+    /**
+     * @brief Текущий размер окна
+     * @return Наибольшее количество векторов без ответа
+     */
+    uint32_t limit() const {
+        return current;
+    }
+
+    /**
+     * @brief Отметка об отправке вектора
+     * @param[in] now Время отправки
+     */
+    void onSend(chrono::steady_clock::time_point now = chrono::steady_clock::now());
+
+    /**
+     * @brief Отметка о сбросе в сокет кадров отправленных векторов
+     * @param[in] now Время завершения сброса
+     * @details Векторы, отмеченные после предыдущего сброса, получают время
+     * отправки now: место в окне занимается до записи кадра, и ожидание
+     * записи и сброса не входит в задержку
+     */
+    void onFlush(chrono::steady_clock::time_point now = chrono::steady_clock::now());
+
+    /**
+     * @brief Отметка о получении результатов
+     * @param[in] count Количество результатов
+     * @param[in] now Время получения
+     */
+    void onReceive(uint32_t count, chrono::steady_clock::time_point now = chrono::steady_clock::now());
+
+    /**
+     * @brief Срок ответа на самый старый вектор без ответа
+     * @param[in] now Текущее время
+     * @return Время отправки вектора плюс тайм-аут; now плюс тайм-аут, если
+     * кадр вектора ещё не сброшен в сокет; time_point::max() без тайм-аута
+     * или без векторов в полёте
+     */
+    chrono::steady_clock::time_point deadline(chrono::steady_clock::time_point now = chrono::steady_clock::now()) const;
+};
+
+/**
+ * @class InFlightWindow
+ * @brief Окно векторов, отправленных на сервер, но ещё не получивших результат
+ * @details Отправитель занимает место в окне перед передачей вектора,
+ * приёмник освобождает его после получения результата. Размер окна 1
+ * соответствует строгому режиму "запрос-ответ". Размер окна задаёт
+ * WindowController, в том числе адаптивно.
+ */
+class InFlightWindow {
+private:
+    mutex m;                ///< Мьютекс для защиты счётчиков
+    condition_variable cv;  ///< Условная переменная ожидания свободного места
+    condition_variable busy; ///< Условная переменная ожидания вектора в полёте
+    WindowController control; ///< Размер окна
+    uint32_t inFlight = 0;  ///< Текущее количество векторов в полёте
+    bool closed = false;    ///< Признак аварийного закрытия окна
+
+public:
+    /**
+     * @brief Конструктор окна
+     * @param[in] limit Максимальное количество векторов в полёте (0 трактуется как 1)
+     * @param[in] adaptive Подбирать размер окна не больше limit по задержке и скорости
+     * @param[in] timeout Срок ответа на вектор в миллисекундах (0 - без срока)
+     */
+    explicit InFlightWindow(uint32_t limit, bool adaptive = false, uint32_t timeout = 0);
+
+    /**
+     * @brief Занять место в окне
+     * @details Блокирует поток, пока окно заполнено
+     * @return false если окно было закрыто
+     */
+    bool acquire();
+
+    /**
+     * @brief Попытка занять место в окне без ожидания
+     * @return true если место занято, false если окно заполнено или закрыто
+     */
+    bool tryAcquire();
+
+    /**
+     * @brief Освободить места в окне после получения результатов
+     * @param[in] count Количество полученных результатов
+     */
+    void release(uint32_t count = 1);
+
+    /**
+     * @brief Отметка о сбросе в сокет кадров векторов, занявших места в окне
+     */
+    void flushed();
+
+    /**
+     * @brief Срок ответа на самый старый вектор в полёте
+     * @return Время, до которого должен прийти его результат
+     * (time_point::max() без тайм-аута или без векторов в полёте)
+     */
+    chrono::steady_clock::time_point deadline();
+
+    /**
+     * @brief Ожидание хотя бы одного вектора в полёте
+     * @return false если окно было закрыто
+     * @details Приёмник ждёт здесь перед чтением из сокета, чтобы тайм-аут
+     * сокета отсчитывался только тогда, когда сервер должен ответить
+     */
+    bool waitInFlight();
+
+    /**
+     * @brief Закрыть окно и разбудить все ожидающие потоки
+     * @details Используется при ошибке на одной из сторон обмена
+     */
+    void close();
+};
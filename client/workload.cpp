@@ -0,0 +1,469 @@
+#include "workload.h"
+#include "local_sum.h"
+#include "spsc_ring.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <thread>
+
+/**
+ * @brief Шаг splitmix64
+ * @param[in,out] x Состояние
+ * @return Перемешанное значение
+ */
+static uint64_t splitmix(uint64_t& x)
+{
+    uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief Циклический сдвиг влево
+ * @param[in] x Значение
+ * @param[in] k Сдвиг
+ * @return Сдвинутое значение
+ */
+static inline uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+/**
+ * @brief Конструктор
+ * @param[in] seed Начальное значение (раскладывается в состояние через splitmix64)
+ */
+Random::Random(uint64_t seed)
+{
+    for (uint64_t& v : s)
+        v = splitmix(seed);
+}
+
+/**
+ * @brief Очередное число
+ * @return Равномерно распределённое 64-битное число
+ */
+uint64_t Random::operator()()
+{
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+/**
+ * @brief Разбиение описания распределения на вид и параметры
+ * @param[in] spec Описание вида KIND:P1:P2...
+ * @param[out] kind Вид распределения
+ * @return Параметры
+ * @throw system_error EINVAL если параметр не число
+ */
+static vector<double> fields(const string& spec, string& kind)
+{
+    size_t pos = spec.find(':');
+    kind = spec.substr(0, pos);
+    vector<double> params;
+    while (pos != string::npos) {
+        size_t next = spec.find(':', pos + 1);
+        string field = spec.substr(pos + 1, next == string::npos ? string::npos : next - pos - 1);
+        char* end = nullptr;
+        double v = strtod(field.c_str(), &end);
+        if (field.empty() || *end != '\0' || !isfinite(v))
+            throw system_error(EINVAL, generic_category());
+        params.push_back(v);
+        pos = next;
+    }
+    return params;
+}
+
+/**
+ * @brief Проверка размера вектора из описания
+ * @param[in] v Значение параметра
+ * @return Размер
+ * @throw system_error EINVAL если размер не целый или вне 1..2^32-1
+ */
+static uint32_t sizeField(double v)
+{
+    if (v < 1 || v > 4294967295.0 || v != floor(v))
+        throw system_error(EINVAL, generic_category());
+    return uint32_t(v);
+}
+
+/**
+ * @brief Разбор описания распределения
+ * @param[in] spec fixed:N, uniform:MIN:MAX, zipf:S:MAX или pareto:ALPHA:MIN:MAX
+ * @return Распределение
+ * @throw system_error EINVAL при неверном описании
+ */
+SizeDistribution SizeDistribution::parse(const string& spec)
+{
+    string kind;
+    vector<double> p = fields(spec, kind);
+    SizeDistribution d;
+    if (kind == "fixed" && p.size() == 1) {
+        d.kind = SizeKind::Fixed;
+        d.min = d.max = sizeField(p[0]);
+    } else if (kind == "uniform" && p.size() == 2) {
+        d.kind = SizeKind::Uniform;
+        d.min = sizeField(p[0]);
+        d.max = sizeField(p[1]);
+    } else if (kind == "zipf" && p.size() == 2 && p[0] > 0) {
+        d.kind = SizeKind::Zipf;
+        d.shape = p[0];
+        d.min = 1;
+        d.max = sizeField(p[1]);
+    } else if (kind == "pareto" && p.size() == 3 && p[0] > 0) {
+        d.kind = SizeKind::Pareto;
+        d.shape = p[0];
+        d.min = sizeField(p[1]);
+        d.max = sizeField(p[2]);
+    } else {
+        throw system_error(EINVAL, generic_category());
+    }
+    if (d.min > d.max)
+        throw system_error(EINVAL, generic_category());
+    return d;
+}
+
+/**
+ * @brief Случайный размер
+ * @param[in,out] random Генератор
+ * @return Размер вектора от min до max
+ * @details Zipf и Pareto строятся обращением непрерывной функции
+ * распределения на [min, max + 1) с округлением вниз: один вызов
+ * генератора без таблиц, что для Zipf совпадает с дискретным законом
+ * с точностью до поправок на малых размерах.
+ */
+uint32_t SizeDistribution::operator()(Random& random) const
+{
+    double u = random.uniform();
+    double lo = min, hi = double(max) + 1, x;
+    switch (kind) {
+    case SizeKind::Fixed:
+        return min;
+    case SizeKind::Uniform:
+        x = lo + u * (hi - lo);
+        break;
+    case SizeKind::Zipf:
+        if (fabs(shape - 1) < 1e-12) {
+            x = lo * pow(hi / lo, u);
+        } else {
+            double e = 1 - shape;
+            x = pow(pow(lo, e) + u * (pow(hi, e) - pow(lo, e)), 1 / e);
+        }
+        break;
+    default:
+        x = lo / pow(1 - u * (1 - pow(lo / hi, shape)), 1 / shape);
+        break;
+    }
+    return uint32_t(std::clamp(floor(x), lo, double(max)));
+}
+
+/**
+ * @brief Разбор описания распределения
+ * @param[in] spec uniform:A:B, normal:MEAN:SD или int:A:B
+ * @return Распределение
+ * @throw system_error EINVAL при неверном описании
+ */
+ValueDistribution ValueDistribution::parse(const string& spec)
+{
+    string kind;
+    vector<double> p = fields(spec, kind);
+    if (p.size() != 2)
+        throw system_error(EINVAL, generic_category());
+    ValueDistribution d;
+    d.a = p[0];
+    d.b = p[1];
+    if (kind == "uniform" && d.a < d.b)
+        d.kind = ValueKind::Uniform;
+    else if (kind == "normal" && d.b >= 0)
+        d.kind = ValueKind::Normal;
+    else if (kind == "int" && d.a <= d.b && d.a == floor(d.a) && d.b == floor(d.b))
+        d.kind = ValueKind::Integer;
+    else
+        throw system_error(EINVAL, generic_category());
+    return d;
+}
+
+/**
+ * @brief Случайный элемент
+ * @param[in,out] random Генератор
+ * @return Элемент вектора
+ * @details Нормальное распределение - преобразование Бокса-Мюллера без
+ * сохранения второго значения, чтобы элементы зависели только от генератора
+ */
+double ValueDistribution::operator()(Random& random) const
+{
+    switch (kind) {
+    case ValueKind::Normal: {
+        double r = sqrt(-2 * log(1 - random.uniform()));
+        return a + b * r * cos(2 * M_PI * random.uniform());
+    }
+    case ValueKind::Integer:
+        return a + floor(random.uniform() * (b - a + 1));
+    default:
+        return a + random.uniform() * (b - a);
+    }
+}
+
+/**
+ * @brief Конструктор
+ * @param[in] count Количество векторов
+ * @param[in] sizes Распределение размеров
+ * @param[in] values Распределение элементов
+ * @param[in] duplicates Доля векторов-повторов (0-1)
+ * @param[in] seed Начальное значение
+ * @throw system_error EINVAL если доля повторов вне 0-1
+ */
+Workload::Workload(uint32_t count, const SizeDistribution& sizes, const ValueDistribution& values, double duplicates, uint64_t seed)
+    : num_vect(count), sizes(sizes), values(values), duplicates(duplicates), seed(seed)
+{
+    if (!(duplicates >= 0 && duplicates <= 1))
+        throw system_error(EINVAL, generic_category());
+}
+
+/**
+ * @brief Генератор вектора
+ * @param[in] index Индекс вектора
+ * @param[in] stream Поток чисел вектора (0 - размер и повтор, 1 - элементы)
+ * @return Генератор
+ */
+Random Workload::random(uint32_t index, uint32_t stream) const
+{
+    uint64_t key = seed;
+    return Random(splitmix(key) ^ ((uint64_t(index) << 1 | stream) * 0xd1342543de82ef95ull));
+}
+
+/**
+ * @brief Исходный вектор
+ * @param[in] index Индекс вектора
+ * @param[out] size Размер вектора
+ * @return Индекс вектора, копией которого является данный (сам индекс, если не повтор)
+ * @details Повтор может указывать на другой повтор; цепочка проходится до
+ * вектора, сгенерированного заново, и каждый шаг уменьшает индекс
+ */
+uint32_t Workload::source(uint32_t index, uint32_t& size) const
+{
+    for (;;) {
+        Random r = random(index, 0);
+        if (index > 0 && r.uniform() < duplicates) {
+            uint32_t window = min<uint32_t>(index, WORKLOAD_DUPLICATE_WINDOW);
+            index -= 1 + uint32_t(r() % window);
+            continue;
+        }
+        size = sizes(r);
+        return index;
+    }
+}
+
+/**
+ * @brief Элементы вектора
+ * @param[in] index Индекс вектора
+ * @param[out] out Элементы
+ */
+void Workload::elements(uint32_t index, vector<double>& out) const
+{
+    uint32_t size;
+    uint32_t src = source(index, size);
+    Random r = random(src, 1);
+    out.resize(size);
+    for (double& v : out)
+        v = values(r);
+}
+
+/**
+ * @brief Заполнение блока векторов
+ * @param[in] first Индекс первого вектора блока
+ * @param[in] last Индекс после последнего вектора блока
+ * @param[in] binary Двоичный формат протокола вместо текстового
+ * @param[in] binaryResult Ожидаемые результаты - значения double подряд
+ * @param[out] data Кадры векторов
+ * @param[out] results Ожидаемые результаты векторов
+ * @param[in,out] elements Временный буфер элементов
+ */
+void Workload::fillBlock(uint32_t first, uint32_t last, bool binary, bool binaryResult, string& data, string& results, vector<double>& elements) const
+{
+    char text[32]; ///< Буфер текстового представления числа
+    for (uint32_t i = first; i < last; i++) {
+        this->elements(i, elements);
+        uint32_t size = elements.size();
+        if (binary) {
+            data.append(reinterpret_cast<const char*>(&size), sizeof(size));
+            data.append(reinterpret_cast<const char*>(elements.data()), size * sizeof(double));
+        } else {
+            data.append(text, to_chars(text, text + sizeof(text), size).ptr);
+            for (double v : elements) {
+                data.push_back(' ');
+                data.append(text, to_chars(text, text + sizeof(text), v).ptr);
+            }
+            data.push_back('\n');
+        }
+
+        LocalSum sum; ///< Ожидаемый результат
+        sum.add(elements.data(), size);
+        double value = sum.value();
+        if (binaryResult) {
+            results.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        } else {
+            results.append(text, to_chars(text, text + sizeof(text), value).ptr);
+            results.push_back('\n');
+        }
+    }
+}
+
+/**
+ * @struct WorkloadBlock
+ * @brief Блок последовательных векторов, заполненный потоком генерации
+ */
+struct WorkloadBlock {
+    string data;    ///< Кадры векторов
+    string results; ///< Ожидаемые результаты
+};
+
+/**
+ * @struct WorkloadLane
+ * @brief Поток генерации и его очереди блоков
+ * @details Заполненные блоки идут писателю, опустошённые возвращаются
+ * обратно, поэтому буферы блоков выделяются один раз
+ */
+struct WorkloadLane {
+    SpscRing<WorkloadBlock> full{WORKLOAD_QUEUED_BLOCKS}; ///< Заполненные блоки
+    SpscRing<WorkloadBlock> spare{WORKLOAD_QUEUED_BLOCKS}; ///< Свободные блоки
+    exception_ptr error;                                  ///< Ошибка потока
+    thread worker;                                        ///< Поток генерации
+};
+
+/**
+ * @brief Запись блока в файл
+ * @param[in,out] out Файл
+ * @param[in] bytes Данные
+ * @throw system_error EIO при ошибке записи
+ */
+static void writeAll(ofstream& out, const string& bytes)
+{
+    out.write(bytes.data(), bytes.size());
+    if (out.fail())
+        throw system_error(EIO, generic_category());
+}
+
+/**
+ * @brief Запись входного файла и файла ожидаемых результатов
+ * @param[in] input Путь входного файла
+ * @param[in] expected Путь файла ожидаемых результатов
+ * @param[in] binary Двоичный формат протокола вместо текстового
+ * @param[in] binaryResult Ожидаемые результаты - значения double подряд
+ * @param[in] threads Количество потоков генерации
+ * @return Размер входного файла в байтах
+ * @throw system_error при ошибках записи
+ * @details Блок b заполняет поток b % threads, писатель забирает блоки по
+ * порядку номеров, так что содержимое файлов не зависит от threads
+ */
+uint64_t Workload::generate(const string& input, const string& expected, bool binary, bool binaryResult, unsigned threads) const
+{
+    ofstream data(input, ios::binary | ios::trunc);
+    if (!data.is_open())
+        throw system_error(errno, generic_category());
+    ofstream results(expected, ios::binary | ios::trunc);
+    if (!results.is_open())
+        throw system_error(errno, generic_category());
+
+    string header;
+    if (binary) {
+        header.assign(reinterpret_cast<const char*>(&num_vect), sizeof(num_vect));
+    } else {
+        header = to_string(num_vect);
+        header.push_back('\n');
+    }
+    writeAll(data, header);
+    uint64_t written = header.size();
+
+    // Размер блока по среднему размеру первых векторов
+    uint32_t sample = min<uint32_t>(num_vect, WORKLOAD_SIZE_SAMPLE);
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < sample; i++) {
+        uint32_t size;
+        source(i, size);
+        total += size;
+    }
+    uint64_t mean = sample ? max<uint64_t>(1, total / sample) : 1;
+    uint32_t per_block = max<uint64_t>(1, WORKLOAD_BLOCK_ELEMENTS / mean);
+    uint64_t num_blocks = (uint64_t(num_vect) + per_block - 1) / per_block;
+
+    threads = max(1u, threads);
+    vector<unique_ptr<WorkloadLane>> lanes;
+    for (unsigned w = 0; w < threads; w++) {
+        lanes.push_back(make_unique<WorkloadLane>());
+        for (int k = 0; k < WORKLOAD_QUEUED_BLOCKS; k++) {
+            WorkloadBlock block;
+            lanes[w]->spare.tryPush(block);
+        }
+    }
+    for (unsigned w = 0; w < threads; w++) {
+        WorkloadLane* lane = lanes[w].get();
+        lane->worker = thread([this, lane, w, threads, per_block, num_blocks, binary, binaryResult] {
+            try {
+                vector<double> elements;
+                WorkloadBlock block;
+                for (uint64_t b = w; b < num_blocks; b += threads) {
+                    if (!lane->spare.pop(block))
+                        break;
+                    uint32_t first = b * per_block;
+                    uint32_t last = min<uint64_t>(num_vect, first + uint64_t(per_block));
+                    fillBlock(first, last, binary, binaryResult, block.data, block.results, elements);
+                    if (!lane->full.push(block))
+                        break;
+                }
+            } catch (...) {
+                lane->error = current_exception();
+            }
+            lane->full.close();
+        });
+    }
+
+    exception_ptr error;
+    try {
+        WorkloadBlock block;
+        for (uint64_t b = 0; b < num_blocks; b++) {
+            WorkloadLane& lane = *lanes[b % threads];
+            if (!lane.full.pop(block)) {
+                lane.worker.join();
+                if (lane.error)
+                    rethrow_exception(lane.error);
+                throw system_error(EPIPE, generic_category());
+            }
+            writeAll(data, block.data);
+            writeAll(results, block.results);
+            written += block.data.size();
+            block.data.clear();
+            block.results.clear();
+            lane.spare.push(block);
+        }
+    } catch (...) {
+        error = current_exception();
+    }
+    // Закрытие обеих очередей будит поток, ждущий писателя при ошибке
+    for (auto& lane : lanes) {
+        lane->spare.close();
+        lane->full.close();
+        if (lane->worker.joinable())
+            lane->worker.join();
+    }
+    if (error)
+        rethrow_exception(error);
+
+    data.close();
+    results.close();
+    if (data.fail() || results.fail())
+        throw system_error(EIO, generic_category());
+    return written;
+}
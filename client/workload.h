@@ -0,0 +1,224 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <system_error>
+#include "errno.h"
+using namespace std;
+
+#define WORKLOAD_BLOCK_ELEMENTS (1 << 18)   ///< Желаемое количество элементов в блоке генерации
+#define WORKLOAD_DUPLICATE_WINDOW (1 << 16) ///< Повтор выбирается среди стольких предыдущих векторов
+#define WORKLOAD_QUEUED_BLOCKS 2            ///< Количество блоков в работе на поток генерации
+#define WORKLOAD_SIZE_SAMPLE 1024           ///< Векторов для оценки среднего размера
+
+/**
+ * @class Random
+ * @brief Быстрый генератор псевдослучайных чисел xoshiro256**
+ * @details Состояние - 32 байта, поэтому генератор дёшево создаётся для
+ * каждого вектора заново. Удовлетворяет требованиям UniformRandomBitGenerator
+ */
+class Random {
+private:
+    uint64_t s[4]; ///< Состояние генератора
+
+public:
+    using result_type = uint64_t;
+
+    /**
+     * @brief Конструктор
+     * @param[in] seed Начальное значение (раскладывается в состояние через splitmix64)
+     */
+    explicit Random(uint64_t seed);
+
+    /**
+     * @brief Наименьшее значение
+     * @return 0
+     */
+    static constexpr uint64_t min() {
+        return 0;
+    }
+
+    /**
+     * @brief Наибольшее значение
+     * @return 2^64 - 1
+     */
+    static constexpr uint64_t max() {
+        return ~0ull;
+    }
+
+    /**
+     * @brief Очередное число
+     * @return Равномерно распределённое 64-битное число
+     */
+    uint64_t operator()();
+
+    /**
+     * @brief Очередное вещественное число
+     * @return Равномерно распределённое число из [0, 1)
+     */
+    double uniform() {
+        return ((*this)() >> 11) * 0x1p-53;
+    }
+};
+
+/**
+ * @enum SizeKind
+ * @brief Вид распределения размеров векторов
+ */
+enum class SizeKind {
+    Fixed,   ///< Постоянный размер
+    Uniform, ///< Равномерно от min до max
+    Zipf,    ///< Степенной закон P(k) ~ k^-shape на 1..max (много коротких, редкие длинные)
+    Pareto   ///< Распределение Парето с индексом shape от min, обрезанное на max (тяжёлый хвост)
+};
+
+/**
+ * @struct SizeDistribution
+ * @brief Распределение размеров векторов
+ */
+struct SizeDistribution {
+    SizeKind kind = SizeKind::Fixed; ///< Вид распределения
+    uint32_t min = 1;                ///< Наименьший размер
+    uint32_t max = 1;                ///< Наибольший размер
+    double shape = 1;                ///< Показатель степени (Zipf, Pareto)
+
+    /**
+     * @brief Разбор описания распределения
+     * @param[in] spec fixed:N, uniform:MIN:MAX, zipf:S:MAX или pareto:ALPHA:MIN:MAX
+     * @return Распределение
+     * @throw system_error EINVAL при неверном описании
+     */
+    static SizeDistribution parse(const string& spec);
+
+    /**
+     * @brief Случайный размер
+     * @param[in,out] random Генератор
+     * @return Размер вектора от min до max
+     */
+    uint32_t operator()(Random& random) const;
+};
+
+/**
+ * @enum ValueKind
+ * @brief Вид распределения элементов векторов
+ */
+enum class ValueKind {
+    Uniform, ///< Равномерно на [a, b)
+    Normal,  ///< Нормальное со средним a и отклонением b
+    Integer  ///< Целые числа от a до b (суммы точные)
+};
+
+/**
+ * @struct ValueDistribution
+ * @brief Распределение элементов векторов
+ */
+struct ValueDistribution {
+    ValueKind kind = ValueKind::Uniform; ///< Вид распределения
+    double a = -1000;                    ///< Нижняя граница или среднее
+    double b = 1000;                     ///< Верхняя граница или отклонение
+
+    /**
+     * @brief Разбор описания распределения
+     * @param[in] spec uniform:A:B, normal:MEAN:SD или int:A:B
+     * @return Распределение
+     * @throw system_error EINVAL при неверном описании
+     */
+    static ValueDistribution parse(const string& spec);
+
+    /**
+     * @brief Случайный элемент
+     * @param[in,out] random Генератор
+     * @return Элемент вектора
+     */
+    double operator()(Random& random) const;
+};
+
+/**
+ * @class Workload
+ * @brief Синтетическое задание для нагрузочных испытаний
+ * @details Каждый вектор определяется только начальным значением и своим
+ * индексом: размер, признак повтора и элементы берутся из генераторов,
+ * созданных для этого индекса. Поэтому файлы не зависят от количества
+ * потоков, а повтор (копия одного из WORKLOAD_DUPLICATE_WINDOW предыдущих
+ * векторов, как для проверки кэша результатов) воспроизводится без
+ * хранения прежних векторов. Генерация идёт блоками последовательных
+ * векторов: потоки заполняют блоки параллельно, а запись ведётся по
+ * порядку, так что память ограничена несколькими блоками на поток
+ * независимо от размера файла.
+ */
+class Workload {
+private:
+    uint32_t num_vect;        ///< Количество векторов
+    SizeDistribution sizes;   ///< Распределение размеров
+    ValueDistribution values; ///< Распределение элементов
+    double duplicates;        ///< Доля векторов-повторов
+    uint64_t seed;            ///< Начальное значение
+
+    /**
+     * @brief Генератор вектора
+     * @param[in] index Индекс вектора
+     * @param[in] stream Поток чисел вектора (0 - размер и повтор, 1 - элементы)
+     * @return Генератор
+     */
+    Random random(uint32_t index, uint32_t stream) const;
+
+    /**
+     * @brief Заполнение блока векторов
+     * @param[in] first Индекс первого вектора блока
+     * @param[in] last Индекс после последнего вектора блока
+     * @param[in] binary Двоичный формат протокола вместо текстового
+     * @param[in] binaryResult Ожидаемые результаты - значения double подряд
+     * @param[out] data Кадры векторов
+     * @param[out] results Ожидаемые результаты векторов
+     * @param[in,out] elements Временный буфер элементов
+     */
+    void fillBlock(uint32_t first, uint32_t last, bool binary, bool binaryResult, string& data, string& results, vector<double>& elements) const;
+
+public:
+    /**
+     * @brief Конструктор
+     * @param[in] count Количество векторов
+     * @param[in] sizes Распределение размеров
+     * @param[in] values Распределение элементов
+     * @param[in] duplicates Доля векторов-повторов (0-1)
+     * @param[in] seed Начальное значение
+     * @throw system_error EINVAL если доля повторов вне 0-1
+     */
+    Workload(uint32_t count, const SizeDistribution& sizes, const ValueDistribution& values, double duplicates, uint64_t seed);
+
+    /**
+     * @brief Количество векторов
+     * @return Количество векторов задания
+     */
+    uint32_t count() const {
+        return num_vect;
+    }
+
+    /**
+     * @brief Исходный вектор
+     * @param[in] index Индекс вектора
+     * @param[out] size Размер вектора
+     * @return Индекс вектора, копией которого является данный (сам индекс, если не повтор)
+     */
+    uint32_t source(uint32_t index, uint32_t& size) const;
+
+    /**
+     * @brief Элементы вектора
+     * @param[in] index Индекс вектора
+     * @param[out] out Элементы
+     */
+    void elements(uint32_t index, vector<double>& out) const;
+
+    /**
+     * @brief Запись входного файла и файла ожидаемых результатов
+     * @param[in] input Путь входного файла
+     * @param[in] expected Путь файла ожидаемых результатов
+     * @param[in] binary Двоичный формат протокола вместо текстового
+     * @param[in] binaryResult Ожидаемые результаты - значения double подряд
+     * @param[in] threads Количество потоков генерации
+     * @return Размер входного файла в байтах
+     * @throw system_error при ошибках записи
+     */
+    uint64_t generate(const string& input, const string& expected, bool binary, bool binaryResult, unsigned threads) const;
+};
@@ -0,0 +1,126 @@
+#include "xxhash.h"
+#include <cstring>
+
+static const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL; ///< Простые множители алгоритма
+static const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+/**
+ * @brief Циклический сдвиг влево
+ * @param[in] x Значение
+ * @param[in] r Величина сдвига
+ * @return Сдвинутое значение
+ */
+static inline uint64_t rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+/**
+ * @brief Чтение 64-битного слова без требований к выравниванию
+ * @param[in] p Указатель на данные
+ * @return Слово (порядок байт машины)
+ */
+static inline uint64_t read64(const unsigned char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/**
+ * @brief Чтение 32-битного слова без требований к выравниванию
+ * @param[in] p Указатель на данные
+ * @return Слово (порядок байт машины)
+ */
+static inline uint32_t read32(const unsigned char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/**
+ * @brief Добавление слова в накопитель
+ * @param[in] acc Накопитель
+ * @param[in] input Слово данных
+ * @return Новое значение накопителя
+ */
+static inline uint64_t round64(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME2;
+    acc = rotl(acc, 31);
+    return acc * PRIME1;
+}
+
+/**
+ * @brief Слияние накопителя с хешем
+ * @param[in] h Хеш
+ * @param[in] acc Накопитель
+ * @return Новое значение хеша
+ */
+static inline uint64_t merge(uint64_t h, uint64_t acc)
+{
+    h ^= round64(0, acc);
+    return h * PRIME1 + PRIME4;
+}
+
+/**
+ * @brief Хеш XXH64 (xxHash, 64 бита)
+ * @param[in] data Данные
+ * @param[in] len Длина данных в байтах
+ * @param[in] seed Начальное значение
+ * @return Значение хеша, совпадающее с эталонной реализацией xxHash
+ */
+uint64_t xxh64(const void* data, size_t len, uint64_t seed)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data); ///< Текущая позиция
+    const unsigned char* end = p + len;                                 ///< Конец данных
+    uint64_t h; ///< Хеш
+
+    if (len >= 32) {
+        uint64_t v1 = seed + PRIME1 + PRIME2; ///< Накопители четырёх полос
+        uint64_t v2 = seed + PRIME2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = round64(v1, read64(p));
+            v2 = round64(v2, read64(p + 8));
+            v3 = round64(v3, read64(p + 16));
+            v4 = round64(v4, read64(p + 24));
+        }
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = merge(h, v1);
+        h = merge(h, v2);
+        h = merge(h, v3);
+        h = merge(h, v4);
+    } else {
+        h = seed + PRIME5;
+    }
+    h += len;
+
+    // Остаток короче полосы: слова по 8 и 4 байта, затем отдельные байты
+    for (; p + 8 <= end; p += 8) {
+        h ^= round64(0, read64(p));
+        h = rotl(h, 27) * PRIME1 + PRIME4;
+    }
+    if (p + 4 <= end) {
+        h ^= uint64_t(read32(p)) * PRIME1;
+        h = rotl(h, 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= *p * PRIME5;
+        h = rotl(h, 11) * PRIME1;
+    }
+
+    // Перемешивание, чтобы каждый бит входа влиял на все биты результата
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+}
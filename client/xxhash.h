@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+using namespace std;
+
+/**
+ * @brief Хеш XXH64 (xxHash, 64 бита)
+ * @param[in] data Данные
+ * @param[in] len Длина данных в байтах
+ * @param[in] seed Начальное значение
+ * @return Значение хеша, совпадающее с эталонной реализацией xxHash
+ * @details Некриптографический хеш: обрабатывает данные полосами по 32 байта
+ * в четырёх независимых накопителях, поэтому скорость близка к скорости
+ * чтения памяти. Используется для ключей кэша результатов.
+ */
+uint64_t xxh64(const void* data, size_t len, uint64_t seed = 0);